@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+#include "buffer/access_trace.h"
+
+namespace scudb {
+
+static const char TRACE_MAGIC[8] = {'S', 'C', 'U', 'T', 'R', 'A', 'C', 'E'};
+static const uint32_t TRACE_VERSION = 2;
+
+static inline uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// 给每个线程分配一个小编号,比std::thread::id更紧凑
+static uint16_t TraceThreadId() {
+    static std::atomic<uint16_t> next_id(0);
+    static thread_local uint16_t id = next_id++;
+    return id;
+}
+
+TraceRecorder::TraceRecorder(const std::string &path, size_t buffer_records)
+    : capacity_(buffer_records == 0 ? 1 : buffer_records), start_ns_(NowNs()),
+      pending_(false), dropped_(0), gap_(0), stop_(false) {
+    file_ = fopen(path.c_str(), "wb");
+    if (file_ == nullptr)
+        return;
+    TraceFileHeader header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(TraceRecord);
+    fwrite(&header, sizeof(header), 1, file_);
+    active_.reserve(capacity_);
+    writing_.reserve(capacity_);
+    writer_ = std::thread(&TraceRecorder::WriterLoop, this);
+}
+
+TraceRecorder::~TraceRecorder() {
+    if (file_ == nullptr)
+        return;
+    Flush();
+    {
+        std::lock_guard<std::mutex> lck(latch_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    writer_.join();
+    fclose(file_);
+}
+
+void TraceRecorder::Record(TraceOp op, page_id_t page_id, uint8_t flags) {
+    if (file_ == nullptr)
+        return;
+    TraceRecord record;
+    record.timestamp_ns = NowNs() - start_ns_;
+    record.page_id = page_id;
+    record.thread_id = TraceThreadId();
+    record.op = static_cast<uint8_t>(op);
+    record.flags = flags;
+    std::unique_lock<std::mutex> lck(latch_);
+    //调用者可能持有缓冲池的latch_,不能等待写盘:后台线程还在写上一个缓冲区时丢弃记录
+    if (active_.size() >= capacity_ && pending_) {
+        dropped_++;
+        gap_++;
+        return;
+    }
+    RecordGap(record.timestamp_ns);
+    active_.push_back(record);
+    if (active_.size() < capacity_ || pending_)
+        return;
+    //缓冲区已满且后台线程空闲:交换后交给后台线程写盘
+    active_.swap(writing_);
+    pending_ = true;
+    lck.unlock();
+    cv_.notify_all();
+}
+
+/*
+ * Mark the records dropped since the last GAP record, if any. A count that
+ * doesn't fit in page_id takes several GAP records. Called with latch_ held
+ */
+void TraceRecorder::RecordGap(uint64_t timestamp_ns) {
+    while (gap_ > 0) {
+        uint64_t count = std::min<uint64_t>(gap_, INT32_MAX);
+        TraceRecord gap;
+        gap.timestamp_ns = timestamp_ns;
+        gap.page_id = static_cast<page_id_t>(count);
+        gap.thread_id = TraceThreadId();
+        gap.op = static_cast<uint8_t>(TraceOp::GAP);
+        gap.flags = 0;
+        active_.push_back(gap);
+        gap_ -= count;
+    }
+}
+
+uint64_t TraceRecorder::Dropped() {
+    std::lock_guard<std::mutex> lck(latch_);
+    return dropped_;
+}
+
+void TraceRecorder::Flush() {
+    if (file_ == nullptr)
+        return;
+    std::unique_lock<std::mutex> lck(latch_);
+    cv_.wait(lck, [this] { return !pending_; });
+    RecordGap(NowNs() - start_ns_);
+    if (!active_.empty()) {
+        active_.swap(writing_);
+        pending_ = true;
+        cv_.notify_all();
+        cv_.wait(lck, [this] { return !pending_; });
+    }
+    fflush(file_);
+}
+
+void TraceRecorder::WriterLoop() {
+    std::unique_lock<std::mutex> lck(latch_);
+    for (;;) {
+        cv_.wait(lck, [this] { return pending_ || stop_; });
+        if (!pending_)
+            return;
+        //写盘时不持有latch_,记录线程可以继续写active_
+        lck.unlock();
+        fwrite(writing_.data(), sizeof(TraceRecord), writing_.size(), file_);
+        lck.lock();
+        writing_.clear();
+        pending_ = false;
+        cv_.notify_all();
+    }
+}
+
+TraceReader::TraceReader(const std::string &path) {
+    file_ = fopen(path.c_str(), "rb");
+    if (file_ == nullptr)
+        return;
+    TraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, file_) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version < 1 || header.version > TRACE_VERSION ||
+        header.record_size != sizeof(TraceRecord)) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+TraceReader::~TraceReader() {
+    if (file_ != nullptr)
+        fclose(file_);
+}
+
+bool TraceReader::Next(TraceRecord &record) {
+    return file_ != nullptr && fread(&record, sizeof(record), 1, file_) == 1;
+}
+
+bool TraceReader::ReadAll(const std::string &path, std::vector<TraceRecord> &records) {
+    TraceReader reader(path);
+    if (!reader.IsOpen())
+        return false;
+    records.clear();
+    TraceRecord record;
+    while (reader.Next(record))
+        records.push_back(record);
+    return true;
+}
+
+}  // namespace scudb
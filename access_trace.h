@@ -0,0 +1,105 @@
+/**
+ * access_trace.h
+ *
+ * Functionality: Compact binary trace of buffer pool accesses. The buffer
+ * pool appends one fixed-size record per FetchPage/UnpinPage/NewPage/
+ * DeletePage into an in-memory buffer; full buffers are handed to a
+ * background writer thread, so recording costs a copy of 16 bytes on the
+ * caller's path. The caller never waits for the disk: a record that finds
+ * its buffer full while the writer is still busy with the other one is
+ * dropped and counted (Dropped). The next record written after drops is a
+ * GAP record whose page_id holds the number of records dropped there, so a
+ * replay knows where the trace is incomplete. TraceReader reads the file
+ * back for offline replay (see trace_simulator.cpp).
+ *
+ * File layout: TraceFileHeader followed by TraceRecords in the order the
+ * buffer pool issued them. Version 1 traces have no GAP records.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/config.h"
+
+namespace scudb {
+
+// GAP: records were dropped here, page_id is their number (not a page id)
+enum class TraceOp : uint8_t { FETCH = 0, UNPIN, NEW, DELETE, GAP };
+
+struct TraceRecord {
+    uint64_t timestamp_ns; // steady clock, relative to the start of tracing
+    page_id_t page_id;
+    uint16_t thread_id;    // small per-process thread number
+    uint8_t op;            // TraceOp
+    uint8_t flags;         // TRACE_FLAG_*
+};
+static_assert(sizeof(TraceRecord) == 16, "trace records must stay 16 bytes");
+
+const uint8_t TRACE_FLAG_DIRTY = 1; // UnpinPage(is_dirty = true)
+const uint8_t TRACE_FLAG_HIT = 2;   // FetchPage found the page in the pool
+
+struct TraceFileHeader {
+    char magic[8]; // "SCUTRACE"
+    uint32_t version;
+    uint32_t record_size;
+};
+
+class TraceRecorder {
+public:
+    // buffer_records: number of records per in-memory buffer
+    explicit TraceRecorder(const std::string &path, size_t buffer_records = 65536);
+    ~TraceRecorder();
+
+    bool IsOpen() const { return file_ != nullptr; }
+
+    void Record(TraceOp op, page_id_t page_id, uint8_t flags = 0);
+
+    // records dropped because both buffers were full
+    uint64_t Dropped();
+
+    // write out everything recorded so far
+    void Flush();
+
+private:
+    void WriterLoop();
+    void RecordGap(uint64_t timestamp_ns);
+
+    FILE *file_;
+    size_t capacity_;
+    uint64_t start_ns_;
+    std::vector<TraceRecord> active_;  // 当前写入的缓冲区
+    std::vector<TraceRecord> writing_; // 后台线程正在写盘的缓冲区
+    bool pending_;                     // writing_中有待写入的数据
+    uint64_t dropped_;
+    uint64_t gap_;                     // 上一个GAP记录之后丢弃的记录数
+    bool stop_;
+    std::mutex latch_;
+    std::condition_variable cv_;
+    std::thread writer_;
+};
+
+class TraceReader {
+public:
+    explicit TraceReader(const std::string &path);
+    ~TraceReader();
+
+    bool IsOpen() const { return file_ != nullptr; }
+
+    // read the next record, false at end of file
+    bool Next(TraceRecord &record);
+
+    // read the whole trace
+    static bool ReadAll(const std::string &path, std::vector<TraceRecord> &records);
+
+private:
+    FILE *file_;
+};
+
+}  // namespace scudb
@@ -0,0 +1,432 @@
+/**
+ * b_plus_tree.cpp
+ */
+#include <algorithm>
+
+#include "common/rid.h"
+#include "index/b_plus_tree.h"
+
+namespace scudb {
+
+#define BPLUSTREE_TYPE BPlusTree<KeyType, ValueType, KeyComparator>
+#define INDEX_TEMPLATE_ARGUMENTS template <typename KeyType, typename ValueType, typename KeyComparator>
+
+template <typename Node> static inline Node *As(Page *page) {
+  return reinterpret_cast<Node *>(page->GetData());
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+BPLUSTREE_TYPE::BPlusTree(BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
+                          group_id_t group, page_id_t root_page_id, int leaf_max_size,
+                          int internal_max_size)
+    : buffer_pool_manager_(buffer_pool_manager), comparator_(comparator), group_(group),
+      root_page_id_(root_page_id), optimistic_inserts_(0), pessimistic_inserts_(0),
+      leaf_splits_(0), internal_splits_(0), root_splits_(0) {
+  // 叶子至少放2个条目,内部节点至少3个孩子,分裂后两边都不为空
+  leaf_max_size_ = leaf_max_size <= 0 ? LeafPage::Capacity()
+                                      : std::min(std::max(leaf_max_size, 2), LeafPage::Capacity());
+  internal_max_size_ = internal_max_size <= 0
+                           ? InternalPage::Capacity()
+                           : std::min(std::max(internal_max_size, 3), InternalPage::Capacity());
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::IsEmpty() { return GetRootPageId() == INVALID_PAGE_ID; }
+
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t BPLUSTREE_TYPE::GetRootPageId() {
+  root_latch_.RLock();
+  page_id_t root = root_page_id_;
+  root_latch_.RUnlock();
+  return root;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::FetchNode(page_id_t page_id) {
+  return buffer_pool_manager_->FetchPage(page_id, group_);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::Release(Page *page, bool exclusive, bool dirty) {
+  page_id_t page_id = page->GetPageId();
+  if (exclusive)
+    page->WUnlatch();
+  else
+    page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, dirty);
+}
+
+/*
+ * Crab down with read latches: latch the child, then release the parent.
+ * With exclusive_leaf the last level is write-latched instead; the parent
+ * of the leaf knows it is one (level 1), so no latch is ever upgraded
+ * below the root. A root leaf is relatched in write mode: a page never
+ * changes type, and the root can't change while root_latch_ is held
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::FindLeaf(const KeyType *key, bool exclusive_leaf) {
+  root_latch_.RLock();
+  if (root_page_id_ == INVALID_PAGE_ID) {
+    root_latch_.RUnlock();
+    return nullptr;
+  }
+  Page *page = FetchNode(root_page_id_);
+  if (page == nullptr) {
+    root_latch_.RUnlock();
+    return nullptr;
+  }
+  page->RLatch();
+  if (exclusive_leaf && As<BPlusTreePage>(page)->IsLeaf()) {
+    page->RUnlatch();
+    page->WLatch();
+  }
+  root_latch_.RUnlock();
+  while (!As<BPlusTreePage>(page)->IsLeaf()) {
+    auto node = As<InternalPage>(page);
+    page_id_t child_id = key == nullptr ? node->ValueAt(0) : node->Lookup(*key, comparator_);
+    bool exclusive = exclusive_leaf && node->GetLevel() == 1;
+    Page *child = FetchNode(child_id);
+    if (child == nullptr) {
+      Release(page, false, false);
+      return nullptr;
+    }
+    if (exclusive)
+      child->WLatch();
+    else
+      child->RLatch();
+    Release(page, false, false);
+    page = child;
+  }
+  return page;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> &result) {
+  Page *page = FindLeaf(&key, false);
+  if (page == nullptr)
+    return false;
+  ValueType value;
+  bool found = As<LeafPage>(page)->Lookup(key, value, comparator_);
+  if (found)
+    result.push_back(value);
+  Release(page, false, false);
+  return found;
+}
+
+/*
+ * Optimistic first: only the leaf is write-latched. A leaf without room
+ * restarts the insert pessimistic
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value) {
+  Page *page = FindLeaf(&key, true);
+  if (page != nullptr) {
+    auto leaf = As<LeafPage>(page);
+    int index = leaf->KeyIndex(key, comparator_);
+    if (index < leaf->GetSize() && comparator_(leaf->KeyAt(index), key) == 0) {
+      Release(page, true, false);
+      return false;
+    }
+    if (leaf->IsSafe()) {
+      leaf->InsertAt(index, key, value);
+      Release(page, true, true);
+      optimistic_inserts_++;
+      return true;
+    }
+    Release(page, true, false);
+  }
+  return InsertPessimistic(key, value);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) {
+  page_id_t page_id;
+  Page *page = buffer_pool_manager_->NewPage(page_id, group_);
+  if (page == nullptr)
+    return false;
+  auto leaf = As<LeafPage>(page);
+  leaf->Init(page_id, leaf_max_size_);
+  leaf->InsertAt(0, key, value);
+  root_page_id_ = page_id;
+  buffer_pool_manager_->UnpinPage(page_id, true);
+  return true;
+}
+
+/*
+ * Write-latch crabbing from the root. path holds the latched nodes a split
+ * can still reach: every node below path[0] is full, and path[0] is either
+ * safe or the root, in which case root_latch_ is still held
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::InsertPessimistic(const KeyType &key, const ValueType &value) {
+  root_latch_.WLock();
+  bool root_locked = true;
+  if (root_page_id_ == INVALID_PAGE_ID) {
+    bool ok = StartNewTree(key, value);
+    root_latch_.WUnlock();
+    return ok;
+  }
+  std::vector<Page *> path;
+  std::vector<Page *> fresh;
+  auto finish = [&](bool dirty, bool ok) {
+    for (Page *page : path)
+      Release(page, true, dirty);
+    for (Page *page : fresh)
+      Release(page, true, dirty);
+    if (root_locked)
+      root_latch_.WUnlock();
+    return ok;
+  };
+  page_id_t page_id = root_page_id_;
+  while (true) {
+    Page *page = FetchNode(page_id);
+    if (page == nullptr)
+      return finish(false, false);
+    page->WLatch();
+    //节点还有空位时分裂不会越过它,释放所有祖先
+    if (As<BPlusTreePage>(page)->IsSafe()) {
+      for (Page *ancestor : path)
+        Release(ancestor, true, false);
+      path.clear();
+      if (root_locked) {
+        root_latch_.WUnlock();
+        root_locked = false;
+      }
+    }
+    path.push_back(page);
+    if (As<BPlusTreePage>(page)->IsLeaf())
+      break;
+    page_id = As<InternalPage>(page)->Lookup(key, comparator_);
+  }
+  pessimistic_inserts_++;
+  auto leaf = As<LeafPage>(path.back());
+  int index = leaf->KeyIndex(key, comparator_);
+  if (index < leaf->GetSize() && comparator_(leaf->KeyAt(index), key) == 0)
+    return finish(false, false);
+  if (leaf->IsSafe()) {
+    leaf->InsertAt(index, key, value);
+    return finish(true, true);
+  }
+
+  //先取得分裂需要的全部新页面,取不到时树保持原样
+  bool root_split = !As<BPlusTreePage>(path[0])->IsSafe();
+  size_t needed = root_split ? path.size() + 1 : path.size() - 1;
+  for (size_t i = 0; i < needed; i++) {
+    page_id_t new_page_id;
+    Page *page = buffer_pool_manager_->NewPage(new_page_id, group_);
+    if (page == nullptr) {
+      for (Page *unused : fresh) {
+        page_id_t unused_id = unused->GetPageId();
+        unused->WUnlatch();
+        buffer_pool_manager_->UnpinPage(unused_id, false);
+        buffer_pool_manager_->DeletePage(unused_id, group_);
+      }
+      fresh.clear();
+      return finish(false, false);
+    }
+    page->WLatch();
+    fresh.push_back(page);
+  }
+
+  //自下而上分裂,每层把新节点的分隔键插入上一层
+  size_t next = 0;
+  Page *sibling = fresh[next++];
+  SplitLeaf(path.back(), sibling, key, value);
+  leaf_splits_++;
+  KeyType separator = As<LeafPage>(sibling)->KeyAt(0);
+  for (int i = static_cast<int>(path.size()) - 1;; i--) {
+    if (i == 0) {
+      Page *root = fresh[next++];
+      auto node = As<InternalPage>(root);
+      node->Init(root->GetPageId(), internal_max_size_, As<BPlusTreePage>(path[0])->GetLevel() + 1);
+      node->PopulateNewRoot(path[0]->GetPageId(), separator, sibling->GetPageId());
+      root_page_id_ = root->GetPageId();
+      root_splits_++;
+      break;
+    }
+    auto parent = As<InternalPage>(path[i - 1]);
+    int child_index = parent->ChildIndex(key, comparator_);
+    if (parent->IsSafe()) {
+      parent->InsertAfter(child_index, separator, sibling->GetPageId());
+      break;
+    }
+    Page *parent_sibling = fresh[next++];
+    SplitInternal(path[i - 1], parent_sibling, child_index, separator, sibling->GetPageId());
+    internal_splits_++;
+    separator = As<InternalPage>(parent_sibling)->KeyAt(0);
+    sibling = parent_sibling;
+  }
+  return finish(true, true);
+}
+
+/*
+ * Move the upper half of leaf, with (key, value) in place, into sibling
+ * and link sibling right after it
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SplitLeaf(Page *leaf, Page *sibling, const KeyType &key, const ValueType &value) {
+  auto left = As<LeafPage>(leaf);
+  auto right = As<LeafPage>(sibling);
+  std::vector<MappingType> items;
+  items.reserve(left->GetSize() + 1);
+  for (int i = 0; i < left->GetSize(); i++)
+    items.push_back(left->GetItem(i));
+  items.insert(items.begin() + left->KeyIndex(key, comparator_), MappingType(key, value));
+  int left_size = items.size() / 2;
+  right->Init(sibling->GetPageId(), leaf_max_size_);
+  right->Assign(items.data() + left_size, items.size() - left_size);
+  right->SetNextPageId(left->GetNextPageId());
+  left->Assign(items.data(), left_size);
+  left->SetNextPageId(sibling->GetPageId());
+}
+
+/*
+ * Same for an internal node, with (key, child) going right after entry
+ * index. The first key of sibling is the separator for the parent
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SplitInternal(Page *node, Page *sibling, int index, const KeyType &key,
+                                   page_id_t child) {
+  auto left = As<InternalPage>(node);
+  auto right = As<InternalPage>(sibling);
+  std::vector<typename InternalPage::MappingType> items;
+  items.reserve(left->GetSize() + 1);
+  for (int i = 0; i < left->GetSize(); i++)
+    items.push_back(left->GetItem(i));
+  items.insert(items.begin() + index + 1, typename InternalPage::MappingType(key, child));
+  int left_size = items.size() / 2;
+  right->Init(sibling->GetPageId(), internal_max_size_, left->GetLevel());
+  right->Assign(items.data() + left_size, items.size() - left_size);
+  left->Assign(items.data(), left_size);
+}
+
+/*
+ * Nodes are never merged, so a remove only needs the leaf
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::Remove(const KeyType &key) {
+  Page *page = FindLeaf(&key, true);
+  if (page == nullptr)
+    return false;
+  auto leaf = As<LeafPage>(page);
+  int index = leaf->KeyIndex(key, comparator_);
+  bool found = index < leaf->GetSize() && comparator_(leaf->KeyAt(index), key) == 0;
+  if (found)
+    leaf->RemoveAt(index);
+  Release(page, true, found);
+  return found;
+}
+
+/*
+ * Leaves first, then each internal level over the (first key, page) of the
+ * level below, until one node is left. Entries are spread evenly over the
+ * nodes of a level. The pages aren't reachable until root_page_id_ is set,
+ * so they are written without latches
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::BulkLoad(const std::vector<MappingType> &items, double fill_factor) {
+  for (size_t i = 1; i < items.size(); i++)
+    if (comparator_(items[i - 1].first, items[i].first) >= 0)
+      return false;
+  root_latch_.WLock();
+  if (root_page_id_ != INVALID_PAGE_ID || items.empty()) {
+    root_latch_.WUnlock();
+    return items.empty();
+  }
+  std::vector<page_id_t> created;
+  auto fail = [&] {
+    for (page_id_t page_id : created)
+      buffer_pool_manager_->DeletePage(page_id, group_);
+    root_latch_.WUnlock();
+    return false;
+  };
+  // 按层分配:count个条目平均分到ceil(count / per_node)个节点
+  auto spread = [](size_t count, size_t node, size_t nodes) {
+    return count / nodes + (node < count % nodes ? 1 : 0);
+  };
+
+  std::vector<typename InternalPage::MappingType> level;
+  size_t per_leaf = std::max<size_t>(1, std::min<size_t>(leaf_max_size_ * fill_factor, leaf_max_size_));
+  size_t leaves = (items.size() + per_leaf - 1) / per_leaf;
+  Page *prev = nullptr;
+  size_t pos = 0;
+  for (size_t l = 0; l < leaves; l++) {
+    page_id_t page_id;
+    Page *page = buffer_pool_manager_->NewPage(page_id, group_);
+    if (page == nullptr) {
+      if (prev != nullptr)
+        buffer_pool_manager_->UnpinPage(prev->GetPageId(), true);
+      return fail();
+    }
+    created.push_back(page_id);
+    size_t count = spread(items.size(), l, leaves);
+    auto leaf = As<LeafPage>(page);
+    leaf->Init(page_id, leaf_max_size_);
+    leaf->Assign(&items[pos], count);
+    level.emplace_back(items[pos].first, page_id);
+    if (prev != nullptr) {
+      As<LeafPage>(prev)->SetNextPageId(page_id);
+      buffer_pool_manager_->UnpinPage(prev->GetPageId(), true);
+    }
+    prev = page;
+    pos += count;
+  }
+  buffer_pool_manager_->UnpinPage(prev->GetPageId(), true);
+
+  size_t per_node = std::max<size_t>(2, std::min<size_t>(internal_max_size_ * fill_factor, internal_max_size_));
+  for (int height = 1; level.size() > 1; height++) {
+    std::vector<typename InternalPage::MappingType> parents;
+    size_t nodes = (level.size() + per_node - 1) / per_node;
+    pos = 0;
+    for (size_t n = 0; n < nodes; n++) {
+      page_id_t page_id;
+      Page *page = buffer_pool_manager_->NewPage(page_id, group_);
+      if (page == nullptr)
+        return fail();
+      created.push_back(page_id);
+      size_t count = spread(level.size(), n, nodes);
+      auto node = As<InternalPage>(page);
+      node->Init(page_id, internal_max_size_, height);
+      node->Assign(&level[pos], count);
+      parents.emplace_back(level[pos].first, page_id);
+      buffer_pool_manager_->UnpinPage(page_id, true);
+      pos += count;
+    }
+    level.swap(parents);
+  }
+  root_page_id_ = level[0].second;
+  root_latch_.WUnlock();
+  return true;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+typename BPLUSTREE_TYPE::Iterator BPLUSTREE_TYPE::Begin() {
+  Page *page = FindLeaf(nullptr, false);
+  if (page == nullptr)
+    return Iterator(!IsEmpty());
+  return Iterator(buffer_pool_manager_, group_, page, 0);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+typename BPLUSTREE_TYPE::Iterator BPLUSTREE_TYPE::Begin(const KeyType &key) {
+  Page *page = FindLeaf(&key, false);
+  if (page == nullptr)
+    return Iterator(!IsEmpty());
+  int index = As<LeafPage>(page)->KeyIndex(key, comparator_);
+  return Iterator(buffer_pool_manager_, group_, page, index);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+BPlusTreeStats BPLUSTREE_TYPE::GetStats() const {
+  BPlusTreeStats stats;
+  stats.optimistic_inserts = optimistic_inserts_.load();
+  stats.pessimistic_inserts = pessimistic_inserts_.load();
+  stats.leaf_splits = leaf_splits_.load();
+  stats.internal_splits = internal_splits_.load();
+  stats.root_splits = root_splits_.load();
+  return stats;
+}
+
+template class BPlusTree<int64_t, RID, IntegerComparator<int64_t>>;
+
+} // namespace scudb
@@ -0,0 +1,114 @@
+/**
+ * b_plus_tree.h
+ *
+ * Functionality: A concurrent B+tree with unique keys whose nodes are
+ * buffer pool pages (see b_plus_tree_page.h), fetched and created through
+ * BufferPoolManager in the frame group of the index.
+ *
+ * Latching follows Bayer and Schkolnick. Lookups crab down with read
+ * latches, holding at most two at a time. Inserts and removes first go
+ * optimistic: read latches down to the leaf's parent and a write latch on
+ * the leaf only. If the leaf can take the entry in place, that is all.
+ * Only when the insert would split the leaf does it restart pessimistic:
+ * write latches all the way down, releasing the ancestors as soon as a node
+ * is safe (has room for one more entry), so only the nodes a split can
+ * reach stay latched. root_latch_ guards root_page_id_; pessimistic
+ * descents hold it exclusive until they pass a safe node.
+ *
+ * Splits take every page they need before changing anything, so running
+ * out of frames fails the insert with the tree untouched. Removes never
+ * merge nodes: a leaf may become empty and stays linked, which keeps
+ * removes on the optimistic path and lets iterators follow next-leaf
+ * pointers without latch coupling (see index_iterator.h).
+ *
+ * BulkLoad builds a tree from sorted input bottom-up, one full level at a
+ * time, without descending from the root for every key.
+ *
+ * Index pages are not logged; an index is rebuilt from its table after a
+ * crash.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/rwmutex.h"
+#include "index/b_plus_tree_page.h"
+#include "index/index_iterator.h"
+
+namespace scudb {
+
+struct BPlusTreeStats {
+  size_t optimistic_inserts = 0; // inserts done with only the leaf write-latched
+  size_t pessimistic_inserts = 0; // inserts that restarted to split
+  size_t leaf_splits = 0;
+  size_t internal_splits = 0;
+  size_t root_splits = 0;
+};
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+class BPlusTree {
+  using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>;
+  using InternalPage = BPlusTreeInternalPage<KeyType, KeyComparator>;
+
+public:
+  using MappingType = std::pair<KeyType, ValueType>;
+  using Iterator = IndexIterator<KeyType, ValueType, KeyComparator>;
+
+  // pages come from group of bpm. A max size of 0 fills the page; smaller
+  // ones give deeper trees for testing
+  explicit BPlusTree(BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
+                     group_id_t group = 0, page_id_t root_page_id = INVALID_PAGE_ID,
+                     int leaf_max_size = 0, int internal_max_size = 0);
+
+  bool IsEmpty();
+  page_id_t GetRootPageId();
+
+  // point lookup; appends the value of key to result
+  bool GetValue(const KeyType &key, std::vector<ValueType> &result);
+
+  // false if key is present already or no frame is available
+  bool Insert(const KeyType &key, const ValueType &value);
+
+  bool Remove(const KeyType &key);
+
+  // build an empty tree from items, which must be sorted by strictly
+  // increasing key. Nodes are filled to fill_factor of their max size
+  bool BulkLoad(const std::vector<MappingType> &items, double fill_factor = 1.0);
+
+  // scan from the first key, or from the first key >= key. A scan that
+  // can't read a page ends early with Failed() set
+  Iterator Begin();
+  Iterator Begin(const KeyType &key);
+
+  BPlusTreeStats GetStats() const;
+
+private:
+  Page *FetchNode(page_id_t page_id);
+  void Release(Page *page, bool exclusive, bool dirty);
+  // read-latched descent to the leaf for key (the leftmost one for nullptr).
+  // With exclusive_leaf the leaf is write-latched instead
+  Page *FindLeaf(const KeyType *key, bool exclusive_leaf);
+  bool InsertPessimistic(const KeyType &key, const ValueType &value);
+  bool StartNewTree(const KeyType &key, const ValueType &value);
+  void SplitLeaf(Page *leaf, Page *sibling, const KeyType &key, const ValueType &value);
+  void SplitInternal(Page *node, Page *sibling, int index, const KeyType &key, page_id_t child);
+
+  BufferPoolManager *buffer_pool_manager_;
+  KeyComparator comparator_;
+  group_id_t group_;
+  int leaf_max_size_;
+  int internal_max_size_;
+  RWMutex root_latch_;
+  page_id_t root_page_id_;
+
+  std::atomic<size_t> optimistic_inserts_;
+  std::atomic<size_t> pessimistic_inserts_;
+  std::atomic<size_t> leaf_splits_;
+  std::atomic<size_t> internal_splits_;
+  std::atomic<size_t> root_splits_;
+};
+
+} // namespace scudb
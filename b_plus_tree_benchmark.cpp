@@ -0,0 +1,275 @@
+/**
+ * b_plus_tree_benchmark.cpp
+ *
+ * Scalability benchmark of BPlusTree over a BufferPoolManager on an
+ * emulated device (MemoryDiskManager), built as a standalone binary against
+ * the buffer, disk and index sources.
+ *
+ * For 1, 2, 4, ... up to --threads threads (all cores by default) it
+ * reports, as CSV (metric,workload,threads,value):
+ *  - bulk_mops: BulkLoad of --keys sorted keys (single threaded)
+ *  - lookup_mops: random point lookups on the loaded tree
+ *  - insert_mops: inserts of disjoint random keys into an empty tree, and
+ *    pessimistic_pct, the share of them that restarted to split
+ *  - mixed_mops: 90% lookups, 10% inserts on the loaded tree
+ *  - scan_mkeys: keys per second of range scans of --scan-length keys
+ *  - search_ns: one search in a full leaf's key array, with std::lower_bound,
+ *    with the branch-free comparator search and with the SIMD integer
+ *    search (key_search.h; the workload names the instruction set used)
+ *
+ * --pool-frames sizes the buffer pool (the default holds the whole tree);
+ * a smaller pool makes the workloads I/O-bound on the --device profile
+ * (ram, nvme, ssd or hdd).
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/rid.h"
+#include "disk/memory_disk_manager.h"
+#include "index/b_plus_tree.h"
+
+using namespace std;
+using namespace scudb;
+
+namespace {
+
+typedef BPlusTree<int64_t, RID, IntegerComparator<int64_t>> Tree;
+
+struct Options {
+  size_t keys = 1000000;
+  size_t maxThreads = max(1u, thread::hardware_concurrency());
+  size_t opsPerThread = 200000;
+  size_t poolFrames = 0;
+  size_t scanLength = 1000;
+  string device = "ram";
+};
+
+inline double Now() {
+  return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Report(const char *metric, const char *workload, size_t threads, double value) {
+  printf("%s,%s,%zu,%.3f\n", metric, workload, threads, value);
+}
+
+// 1, 2, 4, ... 以及最大线程数本身
+vector<size_t> ThreadCounts(size_t max_threads) {
+  vector<size_t> counts;
+  for (size_t t = 1; t < max_threads; t *= 2)
+    counts.push_back(t);
+  counts.push_back(max_threads);
+  return counts;
+}
+
+// 已载入的键为偶数,奇数留给插入
+inline int64_t LoadedKey(size_t i) { return static_cast<int64_t>(i) * 2; }
+
+/*
+ * Run body(thread, rng) on threads threads at once and return the elapsed
+ * seconds
+ */
+template <typename Body> double RunThreads(size_t threads, Body body) {
+  vector<thread> workers;
+  atomic<size_t> ready(0);
+  atomic<bool> go(false);
+  double start = 0;
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      mt19937_64 rng(t + 1);
+      ready++;
+      while (!go.load())
+        this_thread::yield();
+      body(t, rng);
+    });
+  }
+  while (ready.load() < threads)
+    this_thread::yield();
+  start = Now();
+  go = true;
+  for (auto &w : workers)
+    w.join();
+  return Now() - start;
+}
+
+Tree *LoadTree(BufferPoolManager *bpm, const Options &opt, group_id_t group) {
+  vector<Tree::MappingType> items(opt.keys);
+  for (size_t i = 0; i < opt.keys; i++)
+    items[i] = Tree::MappingType(LoadedKey(i), RID(static_cast<page_id_t>(i), 0));
+  Tree *tree = new Tree(bpm, IntegerComparator<int64_t>(), group);
+  double t0 = Now();
+  if (!tree->BulkLoad(items)) {
+    fprintf(stderr, "bulk load failed, try a bigger --pool-frames\n");
+    exit(1);
+  }
+  Report("bulk_mops", "bulk_load", 1, opt.keys / (Now() - t0) / 1e6);
+  return tree;
+}
+
+void BenchLookup(Tree *tree, const Options &opt, size_t threads) {
+  atomic<size_t> misses(0);
+  double secs = RunThreads(threads, [&](size_t, mt19937_64 &rng) {
+    vector<RID> result;
+    for (size_t i = 0; i < opt.opsPerThread; i++) {
+      result.clear();
+      if (!tree->GetValue(LoadedKey(rng() % opt.keys), result))
+        misses++;
+    }
+  });
+  if (misses.load() > 0)
+    fprintf(stderr, "lookup: %zu keys not found\n", misses.load());
+  Report("lookup_mops", "lookup", threads, threads * opt.opsPerThread / secs / 1e6);
+}
+
+/*
+ * Thread t inserts the keys t, t + threads, ... in random order into an
+ * empty tree
+ */
+void BenchInsert(BufferPoolManager *bpm, const Options &opt, size_t threads, group_id_t group) {
+  Tree tree(bpm, IntegerComparator<int64_t>(), group);
+  size_t per_thread = min(opt.opsPerThread, opt.keys / threads);
+  double secs = RunThreads(threads, [&](size_t t, mt19937_64 &rng) {
+    vector<int64_t> keys(per_thread);
+    for (size_t i = 0; i < per_thread; i++)
+      keys[i] = static_cast<int64_t>(i * threads + t);
+    shuffle(keys.begin(), keys.end(), rng);
+    for (int64_t key : keys)
+      tree.Insert(key, RID(static_cast<page_id_t>(key), 0));
+  });
+  BPlusTreeStats stats = tree.GetStats();
+  size_t inserts = stats.optimistic_inserts + stats.pessimistic_inserts;
+  Report("insert_mops", "insert", threads, threads * per_thread / secs / 1e6);
+  Report("pessimistic_pct", "insert", threads,
+         inserts == 0 ? 0 : 100.0 * stats.pessimistic_inserts / inserts);
+}
+
+void BenchMixed(Tree *tree, const Options &opt, size_t threads, atomic<int64_t> &next_odd) {
+  double secs = RunThreads(threads, [&](size_t, mt19937_64 &rng) {
+    vector<RID> result;
+    for (size_t i = 0; i < opt.opsPerThread; i++) {
+      if (rng() % 10 == 0) {
+        int64_t key = next_odd.fetch_add(2);
+        tree->Insert(key, RID(static_cast<page_id_t>(key), 0));
+      } else {
+        result.clear();
+        tree->GetValue(LoadedKey(rng() % opt.keys), result);
+      }
+    }
+  });
+  Report("mixed_mops", "mixed", threads, threads * opt.opsPerThread / secs / 1e6);
+}
+
+void BenchScan(Tree *tree, const Options &opt, size_t threads) {
+  size_t scans = max<size_t>(1, opt.opsPerThread / opt.scanLength);
+  atomic<size_t> scanned(0);
+  double secs = RunThreads(threads, [&](size_t, mt19937_64 &rng) {
+    size_t n = 0;
+    for (size_t s = 0; s < scans; s++) {
+      size_t len = 0;
+      for (auto it = tree->Begin(LoadedKey(rng() % opt.keys)); !it.isEnd() && len < opt.scanLength;
+           ++it)
+        len++;
+      n += len;
+    }
+    scanned += n;
+  });
+  Report("scan_mkeys", "scan", threads, scanned.load() / secs / 1e6);
+}
+
+/*
+ * ns per search over the keys of a full leaf, out of cache lines already
+ * loaded: the part of a lookup that key_search.h speeds up
+ */
+void BenchKeySearch() {
+  typedef IntegerComparator<int64_t> Comparator;
+  size_t n = BPlusTreeLeafPage<int64_t, RID, Comparator>::Capacity();
+  vector<int64_t> keys(n);
+  for (size_t i = 0; i < n; i++)
+    keys[i] = LoadedKey(i);
+  const size_t searches = 2000000;
+  vector<int64_t> probes(4096);
+  mt19937_64 rng(9);
+  for (auto &probe : probes)
+    probe = rng() % (2 * n);
+  volatile size_t sink = 0;
+  auto bench = [&](const char *name, auto search) {
+    double t0 = Now();
+    for (size_t i = 0; i < searches; i++)
+      sink = sink + search(probes[i % probes.size()]);
+    Report("search_ns", name, 1, (Now() - t0) / searches * 1e9);
+  };
+  bench("std_lower_bound", [&](int64_t key) {
+    return lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+  });
+  bench("branch_free", [&](int64_t key) {
+    auto less = [](const int64_t &lhs, const int64_t &rhs) { return lhs < rhs ? -1 : (rhs < lhs ? 1 : 0); };
+    return KeySearch<int64_t, decltype(less)>::LowerBound(keys.data(), n, key, less);
+  });
+  string simd = string("simd_") + KeySearchIsa();
+  bench(simd.c_str(), [&](int64_t key) { return CountLess(keys.data(), n, key); });
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    const char *val = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--keys")
+      opt.keys = strtoull(val, nullptr, 10), i++;
+    else if (arg == "--threads")
+      opt.maxThreads = strtoull(val, nullptr, 10), i++;
+    else if (arg == "--ops")
+      opt.opsPerThread = strtoull(val, nullptr, 10), i++;
+    else if (arg == "--pool-frames")
+      opt.poolFrames = strtoull(val, nullptr, 10), i++;
+    else if (arg == "--scan-length")
+      opt.scanLength = strtoull(val, nullptr, 10), i++;
+    else if (arg == "--device")
+      opt.device = val, i++;
+    else {
+      fprintf(stderr,
+              "usage: %s [--keys N] [--threads N] [--ops N] [--pool-frames N] "
+              "[--scan-length N] [--device ram|nvme|ssd|hdd]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (opt.keys == 0 || opt.maxThreads == 0 || opt.scanLength == 0) {
+    fprintf(stderr, "--keys, --threads and --scan-length must be positive\n");
+    return 2;
+  }
+  // 默认让整棵树(载入的键、混合负载的插入和插入测试的空树)都能常驻
+  if (opt.poolFrames == 0) {
+    size_t leaf_entries = BPlusTreeLeafPage<int64_t, RID, IntegerComparator<int64_t>>::Capacity();
+    opt.poolFrames = 4 * (opt.keys + opt.maxThreads * opt.opsPerThread) / leaf_entries + 1024;
+  }
+
+  MemoryDiskManager disk_manager(DeviceProfile::ByName(opt.device));
+  BufferPoolManager bpm(opt.poolFrames, &disk_manager);
+
+  printf("metric,workload,threads,value\n");
+  Tree *tree = LoadTree(&bpm, opt, 1);
+  vector<size_t> counts = ThreadCounts(opt.maxThreads);
+  for (size_t threads : counts)
+    BenchLookup(tree, opt, threads);
+  for (size_t threads : counts)
+    BenchScan(tree, opt, threads);
+  group_id_t group = 2;
+  for (size_t threads : counts)
+    BenchInsert(&bpm, opt, threads, group++);
+  atomic<int64_t> next_odd(1);
+  for (size_t threads : counts)
+    BenchMixed(tree, opt, threads, next_odd);
+  delete tree;
+  BenchKeySearch();
+  return 0;
+}
@@ -0,0 +1,211 @@
+/**
+ * b_plus_tree_page.h
+ *
+ * Functionality: Node layouts of BPlusTree, laid over the data of a buffer
+ * pool Page (reinterpret_cast of Page::GetData()).
+ *
+ * Header (24 bytes):
+ * ----------------------------------------------------------------------
+ * | PageType (4) | LSN (4) | Size (4) | MaxSize (4) | Level (4) | PageId (4) |
+ * ----------------------------------------------------------------------
+ * The LSN sits where Page::GetLSN expects it. Level is 0 for leaves and
+ * grows towards the root. Nodes keep no parent pointer: a split finds the
+ * parent on the latched path of the descent, so a split never has to visit
+ * and rewrite the children it moves.
+ *
+ * Leaf: header, next leaf page id, then the keys in key order followed by
+ * their values. Internal: header, then the keys followed by the child page
+ * ids; key 0 is not used for search, child i holds the keys in
+ * [key i, key i+1). Keys and values are kept in separate arrays, not as
+ * pairs, so a search scans densely packed keys (see key_search.h). Both
+ * arrays are sized for the capacity of the page, whatever the max size.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "common/config.h"
+#include "index/key_search.h"
+
+namespace scudb {
+
+enum class IndexPageType : int32_t { INVALID_INDEX_PAGE = 0, LEAF_PAGE, INTERNAL_PAGE };
+
+class BPlusTreePage {
+public:
+  bool IsLeaf() const { return page_type_ == IndexPageType::LEAF_PAGE; }
+  int GetSize() const { return size_; }
+  int GetMaxSize() const { return max_size_; }
+  int GetLevel() const { return level_; }
+  page_id_t GetPageId() const { return page_id_; }
+  // one more entry fits without a split
+  bool IsSafe() const { return size_ < max_size_; }
+
+  // offset of an array of capacity keys, followed by an array of T, from
+  // the start of the arrays
+  template <typename KeyType, typename T> static constexpr size_t SecondArrayOffset(int capacity) {
+    return (capacity * sizeof(KeyType) + alignof(T) - 1) / alignof(T) * alignof(T);
+  }
+
+protected:
+  void InitHeader(IndexPageType type, page_id_t page_id, int max_size, int level) {
+    page_type_ = type;
+    lsn_ = INVALID_LSN;
+    size_ = 0;
+    max_size_ = max_size;
+    level_ = level;
+    page_id_ = page_id;
+  }
+
+  IndexPageType page_type_;
+  lsn_t lsn_;
+  int size_;
+  int max_size_;
+  int level_;
+  page_id_t page_id_;
+};
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+class BPlusTreeLeafPage : public BPlusTreePage {
+public:
+  using MappingType = std::pair<KeyType, ValueType>;
+
+  // entries that fit in a page
+  static int Capacity() {
+    int capacity = (PAGE_SIZE - sizeof(BPlusTreeLeafPage)) / (sizeof(KeyType) + sizeof(ValueType));
+    //对齐填充可能多占几个字节
+    while (sizeof(BPlusTreeLeafPage) + SecondArrayOffset<KeyType, ValueType>(capacity) +
+               capacity * sizeof(ValueType) > PAGE_SIZE)
+      capacity--;
+    return capacity;
+  }
+
+  void Init(page_id_t page_id, int max_size) {
+    InitHeader(IndexPageType::LEAF_PAGE, page_id, max_size, 0);
+    next_page_id_ = INVALID_PAGE_ID;
+  }
+
+  page_id_t GetNextPageId() const { return next_page_id_; }
+  void SetNextPageId(page_id_t next) { next_page_id_ = next; }
+  const KeyType &KeyAt(int index) const { return Keys()[index]; }
+  MappingType GetItem(int index) const { return MappingType(Keys()[index], Values()[index]); }
+
+  // first index whose key is >= key (size_ if none)
+  int KeyIndex(const KeyType &key, const KeyComparator &comparator) const {
+    return KeySearch<KeyType, KeyComparator>::LowerBound(Keys(), size_, key, comparator);
+  }
+
+  bool Lookup(const KeyType &key, ValueType &value, const KeyComparator &comparator) const {
+    int index = KeyIndex(key, comparator);
+    if (index == size_ || comparator(Keys()[index], key) != 0)
+      return false;
+    value = Values()[index];
+    return true;
+  }
+
+  // insert at index, which KeyIndex returned; the caller checked IsSafe
+  void InsertAt(int index, const KeyType &key, const ValueType &value) {
+    std::move_backward(Keys() + index, Keys() + size_, Keys() + size_ + 1);
+    std::move_backward(Values() + index, Values() + size_, Values() + size_ + 1);
+    Keys()[index] = key;
+    Values()[index] = value;
+    size_++;
+  }
+
+  void RemoveAt(int index) {
+    std::move(Keys() + index + 1, Keys() + size_, Keys() + index);
+    std::move(Values() + index + 1, Values() + size_, Values() + index);
+    size_--;
+  }
+
+  // replace the entries with items [0, n)
+  void Assign(const MappingType *items, int n) {
+    for (int i = 0; i < n; i++) {
+      Keys()[i] = items[i].first;
+      Values()[i] = items[i].second;
+    }
+    size_ = n;
+  }
+
+private:
+  KeyType *Keys() const { return reinterpret_cast<KeyType *>(const_cast<char *>(data_)); }
+  ValueType *Values() const {
+    return reinterpret_cast<ValueType *>(const_cast<char *>(data_) +
+                                         SecondArrayOffset<KeyType, ValueType>(Capacity()));
+  }
+
+  page_id_t next_page_id_;
+  alignas(KeyType) char data_[0];
+};
+
+template <typename KeyType, typename KeyComparator>
+class BPlusTreeInternalPage : public BPlusTreePage {
+public:
+  using MappingType = std::pair<KeyType, page_id_t>;
+
+  static int Capacity() {
+    int capacity = (PAGE_SIZE - sizeof(BPlusTreeInternalPage)) / (sizeof(KeyType) + sizeof(page_id_t));
+    while (sizeof(BPlusTreeInternalPage) + SecondArrayOffset<KeyType, page_id_t>(capacity) +
+               capacity * sizeof(page_id_t) > PAGE_SIZE)
+      capacity--;
+    return capacity;
+  }
+
+  void Init(page_id_t page_id, int max_size, int level) {
+    InitHeader(IndexPageType::INTERNAL_PAGE, page_id, max_size, level);
+  }
+
+  const KeyType &KeyAt(int index) const { return Keys()[index]; }
+  page_id_t ValueAt(int index) const { return Children()[index]; }
+  MappingType GetItem(int index) const { return MappingType(Keys()[index], Children()[index]); }
+
+  // index of the child whose range holds key: the number of keys 1.. that
+  // are <= key
+  int ChildIndex(const KeyType &key, const KeyComparator &comparator) const {
+    return KeySearch<KeyType, KeyComparator>::UpperBound(Keys() + 1, size_ - 1, key, comparator);
+  }
+
+  page_id_t Lookup(const KeyType &key, const KeyComparator &comparator) const {
+    return Children()[ChildIndex(key, comparator)];
+  }
+
+  // a new root over two children
+  void PopulateNewRoot(page_id_t left, const KeyType &key, page_id_t right) {
+    Children()[0] = left;
+    Keys()[1] = key;
+    Children()[1] = right;
+    size_ = 2;
+  }
+
+  // insert (key, child) right after the entry at index; the caller checked
+  // IsSafe
+  void InsertAfter(int index, const KeyType &key, page_id_t child) {
+    std::move_backward(Keys() + index + 1, Keys() + size_, Keys() + size_ + 1);
+    std::move_backward(Children() + index + 1, Children() + size_, Children() + size_ + 1);
+    Keys()[index + 1] = key;
+    Children()[index + 1] = child;
+    size_++;
+  }
+
+  void Assign(const MappingType *items, int n) {
+    for (int i = 0; i < n; i++) {
+      Keys()[i] = items[i].first;
+      Children()[i] = items[i].second;
+    }
+    size_ = n;
+  }
+
+private:
+  KeyType *Keys() const { return reinterpret_cast<KeyType *>(const_cast<char *>(data_)); }
+  page_id_t *Children() const {
+    return reinterpret_cast<page_id_t *>(const_cast<char *>(data_) +
+                                         SecondArrayOffset<KeyType, page_id_t>(Capacity()));
+  }
+
+  alignas(KeyType) char data_[0];
+};
+
+} // namespace scudb
@@ -0,0 +1,123 @@
+/**
+ * b_plus_tree_test.cpp
+ */
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "disk/memory_disk_manager.h"
+#include "gtest/gtest.h"
+#include "index/b_plus_tree.h"
+
+namespace scudb {
+
+using Tree = BPlusTree<int64_t, RID, IntegerComparator<int64_t>>;
+
+static RID ValueOf(int64_t key) {
+  return RID(static_cast<page_id_t>(key >> 32), static_cast<int>(key));
+}
+
+// every key of keys is found, and a scan returns them in order
+static void CheckTree(Tree &tree, std::vector<int64_t> keys) {
+  std::sort(keys.begin(), keys.end());
+  for (int64_t key : keys) {
+    std::vector<RID> result;
+    ASSERT_TRUE(tree.GetValue(key, result)) << key;
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(ValueOf(key), result[0]);
+  }
+  size_t i = 0;
+  for (Tree::Iterator it = tree.Begin(); !it.isEnd(); ++it, ++i) {
+    ASSERT_LT(i, keys.size());
+    EXPECT_EQ(keys[i], it->first);
+  }
+  EXPECT_EQ(keys.size(), i);
+}
+
+TEST(BPlusTreeTest, InsertAndScan) {
+  MemoryDiskManager disk_manager;
+  BufferPoolManager bpm(64, &disk_manager);
+  // small nodes, so the tree grows a few levels
+  Tree tree(&bpm, IntegerComparator<int64_t>(), 0, INVALID_PAGE_ID, 4, 4);
+  EXPECT_TRUE(tree.IsEmpty());
+
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < 500; key++)
+    keys.push_back(key * 3);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+  for (int64_t key : keys)
+    ASSERT_TRUE(tree.Insert(key, ValueOf(key)));
+  EXPECT_FALSE(tree.Insert(keys[0], ValueOf(keys[0])));
+  EXPECT_FALSE(tree.IsEmpty());
+  EXPECT_GT(tree.GetStats().root_splits, 1);
+  CheckTree(tree, keys);
+
+  std::vector<RID> result;
+  EXPECT_FALSE(tree.GetValue(1, result));
+  // the scan starts at the first key >= 100
+  Tree::Iterator it = tree.Begin(100);
+  ASSERT_FALSE(it.isEnd());
+  EXPECT_EQ(102, it->first);
+}
+
+TEST(BPlusTreeTest, Remove) {
+  MemoryDiskManager disk_manager;
+  BufferPoolManager bpm(64, &disk_manager);
+  Tree tree(&bpm, IntegerComparator<int64_t>(), 0, INVALID_PAGE_ID, 4, 4);
+  for (int64_t key = 0; key < 200; key++)
+    ASSERT_TRUE(tree.Insert(key, ValueOf(key)));
+  std::vector<int64_t> left;
+  for (int64_t key = 0; key < 200; key++) {
+    if (key % 3 == 0)
+      EXPECT_TRUE(tree.Remove(key));
+    else
+      left.push_back(key);
+  }
+  EXPECT_FALSE(tree.Remove(0));
+  CheckTree(tree, left);
+  // removed keys can come back
+  EXPECT_TRUE(tree.Insert(3, ValueOf(3)));
+}
+
+TEST(BPlusTreeTest, BulkLoad) {
+  MemoryDiskManager disk_manager;
+  BufferPoolManager bpm(64, &disk_manager);
+  Tree tree(&bpm, IntegerComparator<int64_t>(), 0, INVALID_PAGE_ID, 8, 8);
+  std::vector<Tree::MappingType> items;
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < 1000; key++) {
+    items.emplace_back(key * 2, ValueOf(key * 2));
+    keys.push_back(key * 2);
+  }
+  ASSERT_TRUE(tree.BulkLoad(items, 0.75));
+  CheckTree(tree, keys);
+  ASSERT_TRUE(tree.Insert(1, ValueOf(1)));
+  keys.push_back(1);
+  CheckTree(tree, keys);
+}
+
+TEST(BPlusTreeTest, ConcurrentInsert) {
+  MemoryDiskManager disk_manager;
+  BufferPoolManager bpm(256, &disk_manager);
+  Tree tree(&bpm, IntegerComparator<int64_t>(), 0, INVALID_PAGE_ID, 8, 8);
+  const int threads = 4, per_thread = 1000;
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&tree, t] {
+      for (int i = 0; i < per_thread; i++) {
+        int64_t key = static_cast<int64_t>(i) * threads + t;
+        EXPECT_TRUE(tree.Insert(key, ValueOf(key)));
+      }
+    });
+  }
+  for (auto &worker : workers)
+    worker.join();
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < threads * per_thread; key++)
+    keys.push_back(key);
+  CheckTree(tree, keys);
+}
+
+} // namespace scudb
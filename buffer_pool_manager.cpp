@@ -1,35 +1,108 @@
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
 #include "buffer/buffer_pool_manager.h"
 
 namespace scudb {
 
+const group_id_t BufferPoolManager::NO_GROUP;
+
 /*
  * BufferPoolManager Constructor
  * When log_manager is nullptr, logging is disabled (for test purpose)
- * WARNING: Do Not Edit This Function
+ * policy selects the replacer; the default FRAME_LRU indexes frames by their
+ * position in pages_, so it needs no hashing and no allocation after
+ * construction. CLOCK never blocks concurrent unpins on high-core-count hosts
+ */
+BufferPoolManager::BufferPoolManager(size_t pool_size, DiskManager* disk_manager, LogManager* log_manager,
+                                     ReplacerPolicy policy)
+    : BufferPoolManager(std::vector<SizeClassConfig>(1, SizeClassConfig{1, pool_size}), disk_manager,
+                        log_manager, policy) {}
+
+static size_t TotalFrames(const std::vector<SizeClassConfig>& classes) {
+    size_t frames = 0;
+    for (auto& config : classes)
+        frames += config.frames;
+    return frames;
+}
+
+//块大小向下取到能整除一个extent的页数,块才能在一个extent内连续分配
+static size_t BlockPages(size_t pages_per_block) {
+    size_t pages = 1;
+    while (pages * 2 <= pages_per_block && SpaceMap::PAGES_PER_EXTENT % (pages * 2) == 0)
+        pages *= 2;
+    return pages;
+}
+
+/*
+ * Frames split into size classes, laid out one class after the other in
+ * pages_, and their data one after the other in the arena, each frame the
+ * block size of its class. Each class gets a replacer over its own frames
+ * only
  */
-BufferPoolManager::BufferPoolManager(size_t pool_size, DiskManager* disk_manager, LogManager* log_manager)
-    : pool_size_(pool_size), disk_manager_(disk_manager), log_manager_(log_manager) {
-    // a consecutive memory space for buffer pool
+BufferPoolManager::BufferPoolManager(const std::vector<SizeClassConfig>& classes, DiskManager* disk_manager,
+                                     LogManager* log_manager, ReplacerPolicy policy)
+    : pool_size_(TotalFrames(classes)), disk_manager_(disk_manager), log_manager_(log_manager), trace_(nullptr),
+      mrc_(nullptr), frame_group_(pool_size_, NO_GROUP), budgets_enabled_(false),
+      pressure_(nullptr), frame_lsn_(pool_size_, INVALID_LSN), rec_lsn_(pool_size_, INVALID_LSN),
+      inflight_rec_lsn_(pool_size_, INVALID_LSN), pin_lsn_(pool_size_, INVALID_LSN), writing_(pool_size_, false),
+      writer_(nullptr),
+      writer_running_(false), loading_(pool_size_, false) {
+    // a consecutive memory space for buffer pool; the frame data lives in
+    // its own mapping so each frame starts on an OS page boundary
     pages_ = new Page[pool_size_];
+    frame_data_size_ = 0;
+    for (auto& config : classes)
+        frame_data_size_ += config.frames * BlockPages(config.pages_per_block) * PAGE_SIZE;
+    frame_data_size_ = std::max<size_t>(frame_data_size_, PAGE_SIZE);
+    void* arena = mmap(nullptr, frame_data_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED)
+        throw std::bad_alloc();
+    frame_data_ = static_cast<char*>(arena);
     page_table_ = new ExtendibleHash<page_id_t, Page*>(BUCKET_SIZE);
-    replacer_ = new LRUReplacer<Page*>;
-    free_list_ = new std::list<Page*>;
-
-    // put all the pages into free list
-    for (size_t i = 0; i < pool_size_; ++i) {
-        free_list_->push_back(&pages_[i]);
+    classes_.resize(classes.size());
+    size_t begin = 0;
+    char* data = frame_data_;
+    for (size_t c = 0; c < classes.size(); c++) {
+        FrameClass& cls = classes_[c];
+        cls.pages_per_block = BlockPages(classes[c].pages_per_block);
+        cls.begin = begin;
+        cls.frames = classes[c].frames;
+        cls.replacer = MakeReplacer<Page*>(policy, cls.frames, pages_ + begin);
+        cls.stats.block_size = cls.pages_per_block * PAGE_SIZE;
+        cls.stats.frames = cls.frames;
+        // put all the pages into free list
+        for (size_t i = begin; i < begin + cls.frames; ++i) {
+            pages_[i].data_ = data;
+            pages_[i].size_ = cls.stats.block_size;
+            data += cls.stats.block_size;
+            cls.free_list.push_back(&pages_[i]);
+        }
+        begin += cls.frames;
     }
 }
 
 /*
  * BufferPoolManager Deconstructor
- * WARNING: Do Not Edit This Function
+ * Stop the background writer and the pressure monitor first, since both
+ * still touch the frames, then free the frames, their arena, the page
+ * table, the replacers of every size class and the trace and MRC helpers.
+ * Dirty pages are not written; call FlushAllPages before
  */
 BufferPoolManager::~BufferPoolManager() {
+    StopBackgroundWriter();
+    StopWatchingMemoryPressure();
     delete[] pages_;
+    munmap(frame_data_, frame_data_size_);
     delete page_table_;
-    delete replacer_;
-    delete free_list_;
+    for (auto& cls : classes_)
+        delete cls.replacer;
+    delete trace_;
+    delete mrc_;
 }
 
 /**
@@ -41,47 +114,95 @@ BufferPoolManager::~BufferPoolManager() {
  * 3. Delete the entry for the old page from the hash table and insert an
  * entry for the new page.
  * 4. Update page metadata, read page content from disk file and return page
- * pointer
+ * pointer. The write-back and the read happen without holding the pool
+ * latch; a concurrent FetchPage of either page waits for them. If the
+ * write-back fails, the old page stays resident and nullptr is returned. If
+ * the page fails checksum verification, return nullptr and
+ * remember it as corrupt (see IsCorrupt). In a size class of larger blocks
+ * page_id must be the first page of a block; other ids return nullptr
  *
  * This function must mark the Page as pinned and remove its entry from LRUReplacer before it is returned to the caller.
  */
-Page* BufferPoolManager::FetchPage(page_id_t page_id) {
-    lock_guard<mutex> lck(latch_);
+Page* BufferPoolManager::FetchPage(page_id_t page_id, group_id_t group) {
+    unique_lock<mutex> lck(latch_);
     Page* target = nullptr;
+    FrameClass& cls = ClassOfGroup(group);
+    if (page_id % static_cast<page_id_t>(cls.pages_per_block) != 0)
+        return nullptr;
+    if (mrc_ != nullptr)
+        mrc_->Access(page_id);
     // 1.1
     //若内存中存在该页面
-    if (page_table_->Find(page_id, target)) {
-        target->pin_count_++;
+    while (page_table_->Find(page_id, target)) {
+        //另一个线程正在读入此页面,等待读完后重新查找(读取可能失败)
+        if (loading_[FrameOf(target)]) {
+            io_cv_.wait(lck);
+            continue;
+        }
+        stats_.hits++;
+        GetGroup(group).hits++;
+        ClassOf(target).stats.hits++;
+        if (trace_ != nullptr)
+            trace_->Record(TraceOp::FETCH, page_id, TRACE_FLAG_HIT);
+        Pin(target);
         //将此页面从待替换队列中删除
-        replacer_->Erase(target);
+        ClassOf(target).replacer->Erase(target);
         return target;
     }
     // 1.2
     //内存中未找到该页面 需寻找一个内存页面调入外存中所需页面
+    stats_.misses++;
+    GetGroup(group).misses++;
+    cls.stats.misses++;
+    if (trace_ != nullptr)
+        trace_->Record(TraceOp::FETCH, page_id);
     // taget此时为待换出页面指针
-    target = GetVictimPage();
+    target = GetVictimPage(group);
     // 若没有页面可换出
     if (target == nullptr)
         return nullptr;
     // 2
     //若待换出页面被修改过，则要将其写回外存
-    if (target->is_dirty_)
-        disk_manager_->WritePage(target->GetPageId(), target->data_);
+    if (!EvictPage(target, page_id, lck))
+        return nullptr;
     // 3
-    //在pagetable中删去待删除页面
+    //在pagetable中删去待删除页面,新页面先登记再读入
     page_table_->Remove(target->GetPageId());
-
-    //读入新页面
-    disk_manager_->ReadPage(page_id, target->data_);
-    // 加入新页面
     page_table_->Insert(page_id, target);
+    ChargeFrame(target, group);
     //将新页面pin置1，修改位为false
-    target->pin_count_ = 1;
+    Pin(target);
     target->is_dirty_ = false;
     target->page_id_ = page_id;
 
+    loading_[FrameOf(target)] = true;
+
+    // 4
+    //读盘时不持有latch_,并发的缺页可以同时使用所有设备
+    lck.unlock();
+    bool ok = ReadBlock(page_id, target->data_, target->size_);
+    lck.lock();
+    loading_[FrameOf(target)] = false;
+    io_cv_.notify_all();
+    //校验失败的页不交给调用者,frame放回空闲列表
+    if (!ok) {
+        DiscardFrame(target);
+        return nullptr;
+    }
+    corrupt_pages_.erase(page_id);
     return target;
 }
+
+void BufferPoolManager::DiscardFrame(Page* page) {
+    stats_.corrupt_reads++;
+    corrupt_pages_.insert(page->GetPageId());
+    page_table_->Remove(page->GetPageId());
+    ChargeFrame(page, NO_GROUP);
+    page->pin_count_ = 0;
+    page->page_id_ = INVALID_PAGE_ID;
+    page->ResetMemory();
+    ClassOf(page).free_list.push_back(page);
+}
 // Page *BufferPoolManager::find
 
 /*
@@ -89,6 +210,9 @@ Page* BufferPoolManager::FetchPage(page_id_t page_id) {
  * if pin_count>0, decrement it and if it becomes zero, put it back to
  * replacer if pin_count<=0 before this call, return false. is_dirty: set the
  * dirty flag of this page
+ * The first dirty unpin since the page was last written enters it in the
+ * dirty page table with the log tail at the time its pin began as recLSN:
+ * every update made under this pin was logged after that point
  */
 bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {
     lock_guard<mutex> lck(latch_);
@@ -96,32 +220,68 @@ bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {
     page_table_->Find(page_id, target);
     if (target == nullptr || target->GetPinCount() <= 0)
         return false;
+    if (trace_ != nullptr)
+        trace_->Record(TraceOp::UNPIN, page_id, is_dirty ? TRACE_FLAG_DIRTY : 0);
     // pin_count减一后如果等于零，将其插入代替换队列
     if (--target->pin_count_ == 0)
-        replacer_->Insert(target);
-    target->is_dirty_ = is_dirty;
+        ClassOf(target).replacer->Insert(target);
+    if (!is_dirty)
+        return true;  // 不能清除其他线程设置的修改位
+    size_t frame = FrameOf(target);
+    if (!target->is_dirty_)
+        rec_lsn_[frame] = pin_lsn_[frame];
+    target->is_dirty_ = true;
+    // 该页的日志记录都在unpin之前追加,所以其LSN不会超过next_lsn-1。
+    // 其他线程可能仍pin着该页并在修改,此处不读页头LSN,写回时再细化
+    if (log_manager_ != nullptr)
+        frame_lsn_[frame] = std::max(frame_lsn_[frame], log_manager_->GetNextLSN() - 1);
     return true;
 }
 
+//pin一个页面;pin计数从0变为1时记下当前日志尾,作为之后修改的recLSN下界
+void BufferPoolManager::Pin(Page* page) {
+    if (page->pin_count_++ == 0)
+        pin_lsn_[FrameOf(page)] = log_manager_ != nullptr ? log_manager_->GetNextLSN() : INVALID_LSN;
+}
+
+/*
+ * Refine bound, an upper bound of the LSNs that modified page, with the LSN
+ * in the page header when it lies in range. The caller must keep the page
+ * from changing: it is unpinned, or read latched
+ */
+lsn_t BufferPoolManager::PageLSNBound(Page* page, lsn_t bound) {
+    lsn_t lsn = page->GetLSN();
+    if (lsn == INVALID_LSN || lsn > bound)
+        lsn = bound;
+    return lsn;
+}
+
 /*
  * Used to flush a particular page of the buffer pool to disk. Should call the
  * write_page method of the disk manager
- * if page is not found in page table, return false
+ * if page is not found in page table, or the write fails, return false.
+ * The page is written like WriteDirtyPages writes, without the pool latch
  * NOTE: make sure page_id != INVALID_PAGE_ID
  */
 //将页面写回外存
 bool BufferPoolManager::FlushPage(page_id_t page_id) {
-    lock_guard<mutex> lck(latch_);
+    unique_lock<mutex> lck(latch_);
     Page* target = nullptr;
-    page_table_->Find(page_id, target);
-    //确保非空指针且pageid有效
-    if (target == nullptr || target->page_id_ == INVALID_PAGE_ID)
-        return false;
-    //若dirty位true,则写回外存并将其置为false
-    if (target->is_dirty_) {
-        disk_manager_->WritePage(page_id, target->GetData());
-        target->is_dirty_ = false;
+    for (;;) {
+        target = nullptr;
+        page_table_->Find(page_id, target);
+        //确保非空指针且pageid有效
+        if (target == nullptr || target->page_id_ == INVALID_PAGE_ID)
+            return false;
+        //后台写线程正在写出此页的旧副本,等它写完再写,否则旧副本会覆盖新写的内容;
+        //正在读入或作为换出页写回的页面也等它完成
+        if (!writing_[FrameOf(target)] && !loading_[FrameOf(target)])
+            break;
+        io_cv_.wait(lck);
     }
+    //若dirty位true,则写回外存并将其置为false
+    if (target->is_dirty_)
+        return WriteFrames({target}, lck) == 1;
 
     return true;
 }
@@ -132,77 +292,643 @@ bool BufferPoolManager::FlushPage(page_id_t page_id) {
  * table, buffer pool manager should be reponsible for removing this entry out
  * of page table, reseting page metadata and adding back to free list. Second,
  * call disk manager's DeallocatePage() method to delete from disk file. If
- * the page is found within page table, but pin_count != 0, return false
+ * the page is found within page table, but pin_count != 0, return false.
+ * A block of a larger size class is deallocated as a whole; its size class
+ * is the frame's, or the one of group's tablespace when it isn't resident
  */
-bool BufferPoolManager::DeletePage(page_id_t page_id) {
+bool BufferPoolManager::DeletePage(page_id_t page_id, group_id_t group) {
     lock_guard<mutex> lck(latch_);
     Page* target = nullptr;
     page_table_->Find(page_id, target);
+    size_t pages = target != nullptr ? ClassOf(target).pages_per_block : ClassOfGroup(group).pages_per_block;
+    if (page_id % static_cast<page_id_t>(pages) != 0)
+        return false;
     if (target != nullptr) {
-        // 若pin大于零表示仍有进程在使用此页面，不可删除
-        if (target->GetPinCount() > 0)
+        // 若pin大于零表示仍有进程在使用此页面，不可删除;正在换出或读入的页面同样
+        if (target->GetPinCount() > 0 || loading_[FrameOf(target)])
             return false;
+        if (trace_ != nullptr)
+            trace_->Record(TraceOp::DELETE, page_id);
         //将此页从代替换页面中删除
-        replacer_->Erase(target);
+        ClassOf(target).replacer->Erase(target);
         //将此页面从pagetable中删除
         page_table_->Remove(page_id);
+        ChargeFrame(target, NO_GROUP);
         target->is_dirty_ = false;
+        frame_lsn_[FrameOf(target)] = INVALID_LSN;
+        rec_lsn_[FrameOf(target)] = INVALID_LSN;
         //将此页面数据清空
         target->ResetMemory();
         //将此页面加入freelist中
-        free_list_->push_back(target);
+        ClassOf(target).free_list.push_back(target);
     }
-    disk_manager_->DeallocatePage(page_id);
+    corrupt_pages_.erase(page_id);
+    for (size_t i = 0; i < pages; i++)
+        disk_manager_->DeallocatePage(page_id + static_cast<page_id_t>(i));
     return true;
 }
 
+bool BufferPoolManager::IsCorrupt(page_id_t page_id) {
+    lock_guard<mutex> lck(latch_);
+    return corrupt_pages_.count(page_id) > 0;
+}
+
+/*
+ * Take a frame for page_id like NewPage does, but for a page that already
+ * exists on disk and isn't read: recovery rebuilds a page that failed
+ * checksum verification from the log in it, and unpins it dirty so the
+ * rebuilt page replaces the bad copy. A resident page is pinned and returned
+ * as it is
+ */
+Page* BufferPoolManager::ResetPage(page_id_t page_id, group_id_t group) {
+    unique_lock<mutex> lck(latch_);
+    Page* target = nullptr;
+    if (page_id % static_cast<page_id_t>(ClassOfGroup(group).pages_per_block) != 0)
+        return nullptr;
+    if (page_table_->Find(page_id, target)) {
+        //正在读入的页面由FetchPage处理
+        if (loading_[FrameOf(target)])
+            return nullptr;
+        Pin(target);
+        ClassOf(target).replacer->Erase(target);
+        return target;
+    }
+    target = GetVictimPage(group);
+    if (target == nullptr || !EvictPage(target, page_id, lck))
+        return nullptr;
+    page_table_->Remove(target->GetPageId());
+    corrupt_pages_.erase(page_id);
+    page_table_->Insert(page_id, target);
+    ChargeFrame(target, group);
+    if (trace_ != nullptr)
+        trace_->Record(TraceOp::NEW, page_id);
+
+    target->page_id_ = page_id;
+    target->ResetMemory();
+    target->is_dirty_ = false;
+    Pin(target);
+
+    return target;
+}
+
 /**
  * User should call this method if needs to create a new page. This routine
- * will call disk manager to allocate a page.
+ * will call disk manager to allocate a page from the extents of group, so
+ * the pages of one table or index stay physically close.
  * Buffer pool manager should be responsible to choose a victim page either
  * from free list or lru replacer(NOTE: always choose from free list first),
  * update new page's metadata, zero out memory and add corresponding entry
- * into page table. return nullptr if all the pages in pool are pinned
+ * into page table. return nullptr if all the pages in pool are pinned, or
+ * the victim is dirty and can't be written back.
+ * In a size class of larger blocks the whole block is allocated and page_id
+ * is its first page
  */
-Page* BufferPoolManager::NewPage(page_id_t& page_id) {
-    lock_guard<mutex> lck(latch_);
+Page* BufferPoolManager::NewPage(page_id_t& page_id, group_id_t group) {
+    unique_lock<mutex> lck(latch_);
     Page* target = nullptr;
     //在内存中创建一个新页面需要一个位置 因此使用target指向待换出页面
-    target = GetVictimPage();
+    target = GetVictimPage(group);
     if (target == nullptr)
         return target;
     // 2
-    //若页面被修改过则写回外存
-    if (target->is_dirty_)
-        disk_manager_->WritePage(target->GetPageId(), target->data_);
+    //若页面被修改过则写回外存;新页号尚未分配,无需登记
+    if (!EvictPage(target, INVALID_PAGE_ID, lck))
+        return nullptr;
     // 3
     //删去旧页面，将新页面插入pagetable
     page_table_->Remove(target->GetPageId());
-    page_id = disk_manager_->AllocatePage();
+    size_t pages = ClassOf(target).pages_per_block;
+    page_id = pages == 1 ? disk_manager_->AllocatePage(group) : disk_manager_->AllocatePages(group, pages);
+    corrupt_pages_.erase(page_id);
     page_table_->Insert(page_id, target);
+    ChargeFrame(target, group);
+    if (trace_ != nullptr)
+        trace_->Record(TraceOp::NEW, page_id);
 
     // 4
     target->page_id_ = page_id;
     //将此页面数据清空
     target->ResetMemory();
     target->is_dirty_ = false;
-    target->pin_count_ = 1;
+    Pin(target);
 
     return target;
 }
 
-//寻找要被换出的页面
-Page* BufferPoolManager::GetVictimPage() {
+/*
+ * Start recording a binary access trace into path (see access_trace.h).
+ * Returns false if the file cannot be created. Replaces a running trace
+ */
+bool BufferPoolManager::StartTrace(const std::string& path) {
+    TraceRecorder* recorder = new TraceRecorder(path);
+    if (!recorder->IsOpen()) {
+        delete recorder;
+        return false;
+    }
+    lock_guard<mutex> lck(latch_);
+    delete trace_;
+    trace_ = recorder;
+    return true;
+}
+
+/*
+ * Stop tracing and write out everything recorded
+ */
+void BufferPoolManager::StopTrace() {
+    TraceRecorder* recorder;
+    {
+        lock_guard<mutex> lck(latch_);
+        recorder = trace_;
+        trace_ = nullptr;
+    }
+    delete recorder;
+}
+
+/*
+ * Start feeding FetchPage accesses to a SHARDS miss-ratio-curve estimator.
+ * Replaces (and resets) a running estimator
+ */
+void BufferPoolManager::EnableMissRatioCurve(size_t max_pool_size, double sample_rate,
+                                             size_t max_tracked) {
+    MrcEstimator* estimator = new MrcEstimator(sample_rate, max_tracked, max_pool_size);
+    lock_guard<mutex> lck(latch_);
+    delete mrc_;
+    mrc_ = estimator;
+}
+
+/*
+ * Snapshot of the counters and of the estimated miss ratio curve
+ */
+BufferPoolStats BufferPoolManager::GetStats() {
+    lock_guard<mutex> lck(latch_);
+    BufferPoolStats stats = stats_;
+    if (mrc_ != nullptr) {
+        stats.miss_ratio_curve = mrc_->GetCurve();
+        stats.mrc_sample_rate = mrc_->GetSampleRate();
+    }
+    if (trace_ != nullptr)
+        stats.trace_dropped = trace_->Dropped();
+    stats.groups = groups_;
+    stats.released_frames = released_list_.size();
+    for (auto& cls : classes_) {
+        stats.size_classes.push_back(cls.stats);
+        stats.size_classes.back().free_frames = cls.free_list.size();
+    }
+    return stats;
+}
+
+void BufferPoolManager::SetTablespaceClass(group_id_t tablespace, size_t size_class) {
+    lock_guard<mutex> lck(latch_);
+    if (size_class >= classes_.size())
+        return;
+    tablespace_class_[tablespace] = size_class;
+    //已设置的预算不能超过新class的frame数
+    auto it = groups_.find(tablespace);
+    if (it != groups_.end())
+        it->second.min_frames = std::min(it->second.min_frames, classes_[size_class].frames);
+}
+
+//frame所属的size class(各class的frame在pages_中依次相连)
+BufferPoolManager::FrameClass& BufferPoolManager::ClassOf(Page* page) {
+    size_t frame = FrameOf(page);
+    size_t c = 0;
+    while (frame >= classes_[c].begin + classes_[c].frames)
+        c++;
+    return classes_[c];
+}
+
+BufferPoolManager::FrameClass& BufferPoolManager::ClassOfGroup(group_id_t group) {
+    auto it = tablespace_class_.find(group);
+    return classes_[it == tablespace_class_.end() ? 0 : it->second];
+}
+
+/*
+ * Set the frame budget of a group. Its min_frames are reserved: free frames
+ * are not handed to other groups while the reservation is unmet, and other
+ * groups can't evict its frames below it. It never holds more than
+ * max_frames; at the cap it can only replace its own frames. Both count
+ * frames of the size class of the group's tablespace, and a reservation
+ * only holds back the free frames of that class
+ */
+void BufferPoolManager::SetFrameBudget(group_id_t group, size_t min_frames, size_t max_frames) {
+    lock_guard<mutex> lck(latch_);
+    FrameGroupStats& g = GetGroup(group);
+    size_t frames = ClassOfGroup(group).frames;
+    g.min_frames = std::min(min_frames, frames);
+    g.max_frames = std::max(std::min(max_frames, frames), g.min_frames);
+    budgets_enabled_ = true;
+}
+
+FrameGroupStats& BufferPoolManager::GetGroup(group_id_t group) {
+    auto it = groups_.find(group);
+    if (it == groups_.end()) {
+        it = groups_.emplace(group, FrameGroupStats()).first;
+        it->second.max_frames = pool_size_;
+    }
+    return it->second;
+}
+
+//cls中其他组尚未满足的最低保留frame数之和
+size_t BufferPoolManager::ReservedFrames(group_id_t except, const FrameClass& cls) {
+    size_t reserved = 0;
+    for (auto& entry : groups_) {
+        if (entry.first != except && entry.second.resident < entry.second.min_frames &&
+            &ClassOfGroup(entry.first) == &cls)
+            reserved += entry.second.min_frames - entry.second.resident;
+    }
+    return reserved;
+}
+
+//一个块的各页依次在data中,每页一个PageIO
+static void AddBlockIOs(std::vector<PageIO>& ios, page_id_t page_id, char* data, size_t size) {
+    for (size_t offset = 0; offset < size; offset += PAGE_SIZE)
+        ios.push_back(PageIO{static_cast<page_id_t>(page_id + offset / PAGE_SIZE), data + offset, false});
+}
+
+//读入以page_id开头的块,所有页都通过校验才返回true
+bool BufferPoolManager::ReadBlock(page_id_t page_id, char* data, size_t size) {
+    if (size == PAGE_SIZE)
+        return disk_manager_->ReadPage(page_id, data);
+    std::vector<PageIO> ios;
+    AddBlockIOs(ios, page_id, data, size);
+    disk_manager_->ReadPages(ios);
+    for (auto& io : ios) {
+        if (!io.ok)
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Write an unpinned frame to disk without latch_, honoring write-ahead
+ * logging: the log is forced only up to frame_lsn, the frame's LSN bound,
+ * and by waiting on the log flusher rather than issuing a separate log
+ * write. Returns false if a page of the frame can't be written
+ */
+bool BufferPoolManager::WriteBack(Page* page, lsn_t frame_lsn) {
+    if (ENABLE_LOGGING && log_manager_ != nullptr && frame_lsn != INVALID_LSN) {
+        lsn_t lsn = PageLSNBound(page, frame_lsn);
+        if (lsn > log_manager_->GetPersistentLSN())
+            log_manager_->WaitForFlush(lsn);
+    }
+    if (page->GetSize() == PAGE_SIZE)
+        return disk_manager_->WritePage(page->GetPageId(), page->GetData());
+    std::vector<PageIO> ios;
+    AddBlockIOs(ios, page->GetPageId(), page->GetData(), page->GetSize());
+    disk_manager_->WritePages(ios);
+    for (auto& io : ios) {
+        if (!io.ok)
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Write back victim, taken from the replacer, before it is reused for
+ * page_id. The write happens without latch_, with loading_ set: the frame
+ * stays in the page table under the old page id, and also under page_id
+ * unless it is INVALID_PAGE_ID, so FetchPage of either page waits instead of
+ * using the frame or reading the old page before it is written. Returns
+ * false if the write failed; the old page then stays resident and dirty and
+ * goes back to the replacer
+ */
+bool BufferPoolManager::EvictPage(Page* victim, page_id_t page_id, unique_lock<mutex>& lck) {
+    if (!victim->is_dirty_)
+        return true;
+    size_t frame = FrameOf(victim);
+    loading_[frame] = true;
+    if (page_id != INVALID_PAGE_ID)
+        page_table_->Insert(page_id, victim);
+    lsn_t frame_lsn = frame_lsn_[frame];
+    lck.unlock();
+    bool ok = WriteBack(victim, frame_lsn);
+    lck.lock();
+    loading_[frame] = false;
+    io_cv_.notify_all();
+    if (!ok) {
+        if (page_id != INVALID_PAGE_ID)
+            page_table_->Remove(page_id);
+        ClassOf(victim).replacer->Insert(victim);
+        return false;
+    }
+    victim->is_dirty_ = false;
+    frame_lsn_[frame] = INVALID_LSN;
+    rec_lsn_[frame] = INVALID_LSN;
+    stats_.dirty_writebacks++;
+    return true;
+}
+
+//把frame记到group名下(NO_GROUP表示frame回到空闲状态)
+void BufferPoolManager::ChargeFrame(Page* page, group_id_t group) {
+    group_id_t& owner = frame_group_[FrameOf(page)];
+    if (owner != NO_GROUP)
+        GetGroup(owner).resident--;
+    owner = group;
+    if (group != NO_GROUP)
+        GetGroup(group).resident++;
+}
+
+/*
+ * 把frame数据区中完整覆盖的操作系统页交还内核(MADV_DONTNEED),
+ * 再次访问时内核按需补零页。frame数据区按页对齐,frame大小是操作系统页大小
+ * 的整数倍时整个frame都能释放
+ */
+static void ReleaseFrameMemory(char* data, size_t size) {
+    static const uintptr_t os_page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(data) + os_page - 1) & ~(os_page - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(data) + size) & ~(os_page - 1);
+    if (begin < end)
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+}
+
+/*
+ * Release up to count frames. Free frames go first, then clean unpinned
+ * frames in replacer order, class by class; dirty frames are never dropped
+ * here. Released frames leave the free list and the page table until
+ * GrowPool
+ */
+size_t BufferPoolManager::ShrinkPool(size_t count, size_t min_frames) {
+    lock_guard<mutex> lck(latch_);
+    size_t released = 0;
+    auto clean = [](Page* const& page) { return !page->is_dirty_; };
+    while (released < count && pool_size_ - released_list_.size() > min_frames) {
+        Page* target = nullptr;
+        for (auto& cls : classes_) {
+            if (!cls.free_list.empty()) {
+                target = cls.free_list.front();
+                cls.free_list.pop_front();
+                break;
+            }
+        }
+        for (size_t c = 0; target == nullptr && c < classes_.size(); c++) {
+            if (classes_[c].replacer->Victim(target, clean, classes_[c].frames)) {
+                page_table_->Remove(target->GetPageId());
+                GetGroup(frame_group_[FrameOf(target)]).evictions++;
+                ChargeFrame(target, NO_GROUP);
+                target->page_id_ = INVALID_PAGE_ID;
+                classes_[c].stats.evictions++;
+                stats_.evictions++;
+            }
+        }
+        if (target == nullptr)
+            break;  // 只剩脏页或被pin住的页
+        ReleaseFrameMemory(target->data_, target->size_);
+        released_list_.push_back(target);
+        released++;
+    }
+    return released;
+}
+
+size_t BufferPoolManager::GrowPool(size_t count) {
+    lock_guard<mutex> lck(latch_);
+    size_t grown = 0;
+    for (; grown < count && !released_list_.empty(); grown++) {
+        ClassOf(released_list_.front()).free_list.push_back(released_list_.front());
+        released_list_.pop_front();
+    }
+    return grown;
+}
+
+/*
+ * pressure_latch_ serializes starting and stopping; deleting the monitor
+ * joins its thread, so no callback runs once StopWatchingMemoryPressure
+ * returns
+ */
+void BufferPoolManager::WatchMemoryPressure(const std::string& path, std::chrono::milliseconds interval,
+                                            size_t step, size_t min_frames, int calm_polls) {
+    lock_guard<mutex> lck(pressure_latch_);
+    delete pressure_;
+    int calm = 0;
+    pressure_ = new MemoryPressureMonitor(path, interval, [=](bool under_pressure) mutable {
+        if (under_pressure) {
+            calm = 0;
+            ShrinkPool(step, min_frames);
+        } else if (++calm >= calm_polls) {
+            GrowPool(step);
+        }
+    });
+    pressure_->Start();
+}
+
+void BufferPoolManager::StopWatchingMemoryPressure() {
+    lock_guard<mutex> lck(pressure_latch_);
+    delete pressure_;
+    pressure_ = nullptr;
+}
+
+/*
+ * Snapshot of the dirty page table. A page the background writer is writing
+ * stays in it, with the older of its two recLSNs, until the write completes.
+ * A pinned page only becomes dirty when it is unpinned, but may already have
+ * been changed and logged; it is included with the log tail at the time its
+ * pin began (pin_lsn_) as recLSN, which bounds every such change from below
+ */
+std::map<page_id_t, lsn_t> BufferPoolManager::GetDirtyPageTable() {
+    lock_guard<mutex> lck(latch_);
+    std::map<page_id_t, lsn_t> table;
+    for (size_t i = 0; i < pool_size_; i++) {
+        Page* page = &pages_[i];
+        bool inflight = writing_[i] && inflight_rec_lsn_[i] != INVALID_LSN;
+        bool pinned = page->pin_count_ > 0 && pin_lsn_[i] != INVALID_LSN;
+        if (!page->is_dirty_ && !inflight && !pinned)
+            continue;
+        lsn_t lsn = page->is_dirty_ ? rec_lsn_[i] : INVALID_LSN;
+        if (inflight && (lsn == INVALID_LSN || inflight_rec_lsn_[i] < lsn))
+            lsn = inflight_rec_lsn_[i];
+        if (pinned && (lsn == INVALID_LSN || pin_lsn_[i] < lsn))
+            lsn = pin_lsn_[i];
+        table[page->GetPageId()] = lsn;
+    }
+    return table;
+}
+
+/*
+ * Pick the dirty unpinned frames with the oldest recLSN and write them with
+ * WriteFrames. Writing oldest first moves the recovery start point,
+ * min(recLSN), forward fastest
+ */
+size_t BufferPoolManager::WriteDirtyPages(size_t max_pages) {
+    unique_lock<mutex> lck(latch_);
+    std::vector<std::pair<lsn_t, Page*>> candidates;
+    for (size_t i = 0; i < pool_size_; i++) {
+        Page* page = &pages_[i];
+        if (page->is_dirty_ && page->pin_count_ == 0 && !writing_[i] && !loading_[i])
+            candidates.emplace_back(rec_lsn_[i], page);
+    }
+    std::sort(candidates.begin(), candidates.end());
+    if (candidates.size() > max_pages)
+        candidates.resize(max_pages);
+    std::vector<Page*> batch;
+    for (auto& entry : candidates)
+        batch.push_back(entry.second);
+    size_t written = WriteFrames(batch, lck);
+    stats_.background_writes += written;
+    return written;
+}
+
+/*
+ * Pin the dirty frames of batch and mark them clean under latch_, then write
+ * them holding only each page's read latch, so fetches and unpins go on
+ * meanwhile. A page updated during the write is simply dirty again
+ * afterwards; FlushPage waits for the write before writing such a page, so
+ * the older copy never lands last. A page whose write fails is dirty again,
+ * with its old recLSN. Called and returns with lck held; returns the number
+ * of frames written
+ */
+size_t BufferPoolManager::WriteFrames(const std::vector<Page*>& batch, unique_lock<mutex>& lck) {
+    for (Page* page : batch) {
+        size_t frame = FrameOf(page);
+        Pin(page);
+        ClassOf(page).replacer->Erase(page);
+        page->is_dirty_ = false;
+        writing_[frame] = true;
+        inflight_rec_lsn_[frame] = rec_lsn_[frame];
+        rec_lsn_[frame] = INVALID_LSN;
+        frame_lsn_[frame] = INVALID_LSN;
+    }
+    lck.unlock();
+    //先在读latch下复制页面,再整批写出:写出时不持有任何页latch,
+    //整批分散到各个条带文件的I/O队列上并行执行
+    size_t staging_size = 0;
+    for (Page* page : batch)
+        staging_size += page->GetSize();
+    std::vector<char> staging(staging_size);
+    std::vector<PageIO> ios;
+    std::vector<lsn_t> page_lsn(batch.size(), INVALID_LSN);
+    lsn_t wal_lsn = INVALID_LSN;
+    size_t offset = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        Page* page = batch[i];
+        page->RLatch();
+        if (ENABLE_LOGGING && log_manager_ != nullptr) {
+            // 页面可能在取出后又被修改过,以当前日志尾为上界
+            page_lsn[i] = PageLSNBound(page, log_manager_->GetNextLSN() - 1);
+            wal_lsn = std::max(wal_lsn, page_lsn[i]);
+        }
+        memcpy(&staging[offset], page->GetData(), page->GetSize());
+        page->RUnlatch();
+        AddBlockIOs(ios, page->GetPageId(), &staging[offset], page->GetSize());
+        offset += page->GetSize();
+    }
+    if (wal_lsn != INVALID_LSN && wal_lsn > log_manager_->GetPersistentLSN())
+        log_manager_->WaitForFlush(wal_lsn);
+    disk_manager_->WritePages(ios);
+    //检查点之前会同步这些写,先让内核开始回写
+    if (!ios.empty())
+        disk_manager_->StartWriteback();
+    lck.lock();
+    size_t written = 0;
+    size_t next_io = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        Page* page = batch[i];
+        size_t frame = FrameOf(page);
+        bool ok = true;
+        for (size_t n = page->GetSize() / PAGE_SIZE; n > 0; n--)
+            ok = ios[next_io++].ok && ok;
+        //写失败的页重新标脏,恢复recLSN,否则它会被当作干净页换出
+        if (!ok) {
+            if (!page->is_dirty_ || inflight_rec_lsn_[frame] < rec_lsn_[frame])
+                rec_lsn_[frame] = inflight_rec_lsn_[frame];
+            page->is_dirty_ = true;
+            frame_lsn_[frame] = std::max(frame_lsn_[frame], page_lsn[i]);
+        } else {
+            written++;
+        }
+        writing_[frame] = false;
+        inflight_rec_lsn_[frame] = INVALID_LSN;
+        if (--page->pin_count_ == 0)
+            ClassOf(page).replacer->Insert(page);
+    }
+    if (!batch.empty())
+        io_cv_.notify_all();  // FlushPage等待的写出已完成
+    return written;
+}
+
+/*
+ * One WriteDirtyPages pass over the whole pool, then a single group sync
+ * instead of one sync per page
+ */
+size_t BufferPoolManager::FlushAllPages() {
+    size_t written = WriteDirtyPages(pool_size_);
+    SyncWrites();
+    return written;
+}
+
+bool BufferPoolManager::SyncWrites() {
+    return disk_manager_->SyncUpTo(disk_manager_->WriteMark());
+}
+
+void BufferPoolManager::StartBackgroundWriter(std::chrono::milliseconds interval, size_t max_pages) {
+    StopBackgroundWriter();
+    writer_running_ = true;
+    writer_ = new std::thread([this, interval, max_pages] {
+        std::unique_lock<std::mutex> lock(writer_latch_);
+        while (!writer_cv_.wait_for(lock, interval, [this] { return !writer_running_; })) {
+            lock.unlock();
+            WriteDirtyPages(max_pages);
+            lock.lock();
+        }
+    });
+}
+
+void BufferPoolManager::StopBackgroundWriter() {
+    if (writer_ == nullptr)
+        return;
+    {
+        std::lock_guard<std::mutex> lck(writer_latch_);
+        writer_running_ = false;
+    }
+    writer_cv_.notify_all();
+    writer_->join();
+    delete writer_;
+    writer_ = nullptr;
+}
+
+/*
+ * Find a frame for a page of group in the size class of its tablespace.
+ * Free frames come first unless group is at its cap or they are reserved
+ * for other groups. Otherwise a victim is chosen in LRU order among, in
+ * turn: frames of groups over their cap, frames of groups over their
+ * reservation, and group's own frames
+ */
+Page* BufferPoolManager::GetVictimPage(group_id_t group) {
     Page* target = nullptr;
+    FrameClass& cls = ClassOfGroup(group);
+    FrameGroupStats& g = GetGroup(group);
+    bool at_cap = g.resident >= g.max_frames;
     //先在freelist中寻找，再在replace中寻找
-    if (!free_list_->empty()) {
+    if (!at_cap && !cls.free_list.empty() &&
+        (g.resident < g.min_frames || cls.free_list.size() > ReservedFrames(group, cls))) {
         // freelist队首元素作为target
-        target = free_list_->front();
-        free_list_->pop_front();
-    } else if (replacer_->Size() == 0)
+        target = cls.free_list.front();
+        cls.free_list.pop_front();
+        return target;
+    }
+    if (cls.replacer->Size() == 0)
         return nullptr;  // freelist与replacer都为空 返回空指针表示没有待换出页面
-    else
-        replacer_->Victim(target);
+    if (!budgets_enabled_) {
+        cls.replacer->Victim(target);
+    } else {
+        auto owner = [this](Page* page) -> FrameGroupStats& {
+            return GetGroup(frame_group_[FrameOf(page)]);
+        };
+        auto own = [&](Page* const& page) { return frame_group_[FrameOf(page)] == group; };
+        auto over_cap = [&](Page* const& page) {
+            return owner(page).resident > owner(page).max_frames;
+        };
+        auto over_min = [&](Page* const& page) {
+            return owner(page).resident > owner(page).min_frames;
+        };
+        if (!at_cap && !cls.replacer->Victim(target, over_cap, cls.frames))
+            cls.replacer->Victim(target, over_min, cls.frames);
+        if (target == nullptr)
+            cls.replacer->Victim(target, own, cls.frames);
+    }
+    if (target == nullptr)
+        return nullptr;
+    GetGroup(frame_group_[FrameOf(target)]).evictions++;
+    cls.stats.evictions++;
+    stats_.evictions++;
     return target;
 }
 
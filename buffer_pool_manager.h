@@ -7,41 +7,239 @@
  */
 
 #pragma once
+#include <chrono>
+#include <condition_variable>
 #include <list>
+#include <map>
 #include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
-#include "buffer/lru_replacer.h"
+#include "buffer/access_trace.h"
+#include "buffer/memory_pressure.h"
+#include "buffer/mrc_estimator.h"
+#include "buffer/replacer_factory.h"
 #include "disk/disk_manager.h"
 #include "hash/extendible_hash.h"
 #include "logging/log_manager.h"
 #include "page/page.h"
 
 namespace scudb {
+// frame-budget group a page is charged to, e.g. a tenant or an index. New
+// pages of a group are also allocated from the same disk extents
+typedef int32_t group_id_t;
+const group_id_t DEFAULT_GROUP = 0;
+
+struct FrameGroupStats {
+  size_t min_frames = 0; // reserved: other groups can't evict below this
+  size_t max_frames = 0; // cap: the group never holds more frames
+  size_t resident = 0;   // frames currently charged to the group
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;  // frames taken away from the group
+};
+
+/*
+ * Size classes. A frame of a class holds one block of pages_per_block *
+ * PAGE_SIZE bytes (Page::GetSize()). On disk a block is pages_per_block
+ * consecutive page ids of one extent, allocated together by NewPage and
+ * named by the first of them, so FetchPage/DeletePage of a tablespace of a
+ * larger class take block-aligned page ids; a block is read and written in
+ * one batch. pages_per_block is rounded down to a divisor of
+ * SpaceMap::PAGES_PER_EXTENT. Each class has its own frames, free list,
+ * replacer and frame reservations, so the blocks of a big scan only evict
+ * frames of their own class
+ */
+struct SizeClassConfig {
+  size_t pages_per_block; // 1 for plain pages, e.g. 16 for 64 KiB blocks
+  size_t frames;
+};
+
+struct SizeClassStats {
+  size_t block_size = 0;  // pages_per_block * PAGE_SIZE
+  size_t frames = 0;
+  size_t free_frames = 0;
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+};
+
+struct BufferPoolStats {
+  size_t hits = 0;             // FetchPage found the page in the pool
+  size_t misses = 0;           // FetchPage had to read the page
+  size_t evictions = 0;        // frames taken from the replacer
+  size_t dirty_writebacks = 0; // dirty victims written before reuse
+  size_t released_frames = 0;  // frames given back to the OS by ShrinkPool
+  size_t background_writes = 0; // dirty pages written by WriteDirtyPages
+  size_t corrupt_reads = 0;     // FetchPage misses that failed verification
+  size_t trace_dropped = 0;     // records the running trace dropped
+  // estimated (pool size, miss ratio) points, empty unless
+  // EnableMissRatioCurve was called
+  std::vector<std::pair<size_t, double>> miss_ratio_curve;
+  double mrc_sample_rate = 0;
+  std::map<group_id_t, FrameGroupStats> groups;
+  std::vector<SizeClassStats> size_classes;
+};
+
 class BufferPoolManager {
 public:
-  BufferPoolManager(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr);
+  BufferPoolManager(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr,
+                    ReplacerPolicy policy = ReplacerPolicy::FRAME_LRU);
+
+  // frames split into size classes; class 0 serves every tablespace that
+  // SetTablespaceClass didn't assign
+  BufferPoolManager(const std::vector<SizeClassConfig> &classes, DiskManager *disk_manager,
+                    LogManager *log_manager = nullptr,
+                    ReplacerPolicy policy = ReplacerPolicy::FRAME_LRU);
 
   ~BufferPoolManager();
 
-  Page *FetchPage(page_id_t page_id);
+  Page *FetchPage(page_id_t page_id, group_id_t group = DEFAULT_GROUP);
 
   bool UnpinPage(page_id_t page_id, bool is_dirty);
 
   bool FlushPage(page_id_t page_id);
 
-  Page *NewPage(page_id_t &page_id);
+  Page *NewPage(page_id_t &page_id, group_id_t group = DEFAULT_GROUP);
+
+  // group picks the size class of a page that isn't resident
+  bool DeletePage(page_id_t page_id, group_id_t group = DEFAULT_GROUP);
+
+  // whether the last read of page_id failed checksum verification, which
+  // tells such a FetchPage failure apart from a full pool
+  bool IsCorrupt(page_id_t page_id);
+
+  // pin page_id in a zeroed frame without reading it, to rebuild a page that
+  // failed verification; nullptr if all the pages in pool are pinned
+  Page *ResetPage(page_id_t page_id, group_id_t group = DEFAULT_GROUP);
+
+  // record every FetchPage/UnpinPage/NewPage/DeletePage into a binary trace
+  bool StartTrace(const std::string &path);
 
-  bool DeletePage(page_id_t page_id);
+  void StopTrace();
+
+  // estimate the miss ratio of pool sizes up to max_pool_size from sampled
+  // FetchPage reuse distances, keeping at most max_tracked sampled pages
+  void EnableMissRatioCurve(size_t max_pool_size, double sample_rate = 0.01,
+                            size_t max_tracked = 8192);
+
+  BufferPoolStats GetStats();
+
+  // FetchPage/NewPage of pages of tablespace (their group) use size_class
+  void SetTablespaceClass(group_id_t tablespace, size_t size_class);
+
+  // reserve min_frames for group and cap it at max_frames, frames of the
+  // size class of its tablespace
+  void SetFrameBudget(group_id_t group, size_t min_frames, size_t max_frames);
+
+  // give up to count clean, unpinned frames (free ones first, then the
+  // coldest) back to the OS, keeping at least min_frames usable
+  size_t ShrinkPool(size_t count, size_t min_frames);
+
+  // put up to count released frames back on the free list
+  size_t GrowPool(size_t count);
+
+  // poll a PSI or memory.events file (see memory_pressure.h): shrink by step
+  // frames per poll under pressure, regrow by step after calm_polls quiet polls
+  void WatchMemoryPressure(const std::string &path, std::chrono::milliseconds interval,
+                           size_t step, size_t min_frames, int calm_polls = 3);
+
+  void StopWatchingMemoryPressure();
+
+  // dirty page table: page id -> recLSN of every dirty page, including pages
+  // the background writer is writing right now and pinned pages, which may
+  // have been changed before they are unpinned dirty
+  std::map<page_id_t, lsn_t> GetDirtyPageTable();
+
+  // write up to max_pages unpinned dirty pages, oldest recLSN first, without
+  // holding the pool latch during I/O. Returns the number written
+  size_t WriteDirtyPages(size_t max_pages);
+
+  // write every unpinned dirty page and make the writes durable with one
+  // group sync, e.g. at shutdown. Returns the number of pages written
+  size_t FlushAllPages();
+
+  // make every page write completed so far durable (see
+  // DiskManager::SyncUpTo). Returns false if a sync failed
+  bool SyncWrites();
+
+  // call WriteDirtyPages(max_pages) every interval on a background thread
+  void StartBackgroundWriter(std::chrono::milliseconds interval, size_t max_pages);
+
+  void StopBackgroundWriter();
 
 private:
   size_t pool_size_; // number of pages in buffer pool
   Page *pages_;      // array of pages
+  char *frame_data_; // page-aligned arena holding the data of every frame
+  size_t frame_data_size_;
   DiskManager *disk_manager_;
   LogManager *log_manager_;
   HashTable<page_id_t, Page *> *page_table_; // to keep track of pages
-  Replacer<Page *> *replacer_;   // to find an unpinned page for replacement
-  std::list<Page *> *free_list_; // to find a free page for replacement
-  std::mutex latch_;             // to protect shared data structure
-  Page *GetVictimPage();
+  // size classes: frames [begin, begin + frames) of pages_ with their own
+  // free list and replacer, protected by latch_
+  struct FrameClass {
+    size_t pages_per_block;
+    size_t begin;
+    size_t frames;
+    std::list<Page *> free_list;     // to find a free page for replacement
+    ScanReplacer<Page *> *replacer;  // to find an unpinned page for replacement
+    SizeClassStats stats;
+  };
+  std::vector<FrameClass> classes_;
+  std::map<group_id_t, size_t> tablespace_class_;
+  std::mutex latch_;               // to protect shared data structure
+  TraceRecorder *trace_;           // nullptr unless tracing
+  MrcEstimator *mrc_;              // nullptr unless estimating the MRC
+  BufferPoolStats stats_;          // counters, protected by latch_
+  std::set<page_id_t> corrupt_pages_; // protected by latch_
+  // frame budgets, protected by latch_
+  static const group_id_t NO_GROUP = -1;
+  std::vector<group_id_t> frame_group_; // owner group of each frame
+  std::map<group_id_t, FrameGroupStats> groups_;
+  bool budgets_enabled_;
+  std::list<Page *> released_list_; // frames whose memory was released
+  MemoryPressureMonitor *pressure_; // nullptr unless watching pressure
+  std::mutex pressure_latch_;       // protects pressure_
+  // per frame: the log must be durable up to this LSN before the frame is
+  // written back (INVALID_LSN when clean), protected by latch_
+  std::vector<lsn_t> frame_lsn_;
+  // dirty page table, per frame, protected by latch_: recLSN of a dirty
+  // frame, recLSN of a frame the background writer is writing, and the log
+  // tail when the current pin began (a lower bound for the frame's updates)
+  std::vector<lsn_t> rec_lsn_;
+  std::vector<lsn_t> inflight_rec_lsn_;
+  std::vector<lsn_t> pin_lsn_;
+  // per frame: the background writer is writing a copy of the page,
+  // protected by latch_
+  std::vector<char> writing_;
+  // background writer
+  std::thread *writer_;
+  bool writer_running_;
+  std::mutex writer_latch_;
+  std::condition_variable writer_cv_;
+  // per frame: FetchPage is reading the page in, or a dirty victim is
+  // written back, without latch_; waiters sleep on io_cv_, as does FlushPage
+  // on a background write. Protected by latch_
+  std::vector<char> loading_;
+  std::condition_variable io_cv_;
+
+  inline size_t FrameOf(Page *page) const { return page - pages_; }
+  FrameClass &ClassOf(Page *page);
+  FrameClass &ClassOfGroup(group_id_t group);
+  void DiscardFrame(Page *page);
+  FrameGroupStats &GetGroup(group_id_t group);
+  size_t ReservedFrames(group_id_t except, const FrameClass &cls);
+  void ChargeFrame(Page *page, group_id_t group);
+  void Pin(Page *page);
+  lsn_t PageLSNBound(Page *page, lsn_t bound);
+  bool ReadBlock(page_id_t page_id, char *data, size_t size);
+  bool WriteBack(Page *page, lsn_t frame_lsn);
+  bool EvictPage(Page *victim, page_id_t page_id, std::unique_lock<std::mutex> &lck);
+  size_t WriteFrames(const std::vector<Page *> &batch, std::unique_lock<std::mutex> &lck);
+  Page *GetVictimPage(group_id_t group);
 };
 }
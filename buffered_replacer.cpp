@@ -0,0 +1,230 @@
+/**
+ * Buffered replacer implementation
+ */
+#include <functional>
+
+#include "buffer/buffered_replacer.h"
+#include "page/page.h"
+
+namespace scudb {
+
+template <typename T>
+BufferedReplacer<T>::BufferedReplacer(ScanReplacer<T> *replacer, size_t num_stripes,
+                                      size_t stripe_capacity,
+                                      size_t drain_threshold)
+    : replacer(replacer), capacity(1), drainThreshold(drain_threshold),
+      seq(0), nextApply(0), running(false) {
+  if (num_stripes == 0)
+    num_stripes = 1;
+  while (capacity < stripe_capacity)
+    capacity <<= 1;
+  if (drainThreshold == 0 || drainThreshold > capacity)
+    drainThreshold = capacity;
+  for (size_t i = 0; i < num_stripes; i++) {
+    Stripe *stripe = new Stripe;
+    stripe->slots.reset(new Slot[capacity]);
+    for (size_t j = 0; j < capacity; j++)
+      stripe->slots[j].turn.store(j);
+    stripe->tail.store(0);
+    stripe->head.store(0);
+    stripes.emplace_back(stripe);
+  }
+}
+
+template <typename T> BufferedReplacer<T>::~BufferedReplacer() {
+  StopMaintenance();
+  delete replacer;
+}
+
+template <typename T>
+typename BufferedReplacer<T>::Stripe &BufferedReplacer<T>::LocalStripe() {
+  // 每个线程只计算一次自己的stripe编号
+  static thread_local size_t id = hash<thread::id>{}(this_thread::get_id());
+  return *stripes[id % stripes.size()];
+}
+
+/*
+ * Multi-producer push into a bounded ring. Returns false when the stripe is
+ * full
+ */
+template <typename T>
+bool BufferedReplacer<T>::TryPush(Stripe &stripe, const Event &event) {
+  size_t pos = stripe.tail.load(memory_order_relaxed);
+  for (;;) {
+    Slot &slot = stripe.slots[pos & (capacity - 1)];
+    size_t turn = slot.turn.load(memory_order_acquire);
+    intptr_t dif = (intptr_t)turn - (intptr_t)pos;
+    if (dif == 0) {
+      if (stripe.tail.compare_exchange_weak(pos, pos + 1,
+                                            memory_order_relaxed)) {
+        slot.event = event;
+        slot.turn.store(pos + 1, memory_order_release);
+        return true;
+      }
+    } else if (dif < 0) {
+      return false; //已满
+    } else {
+      pos = stripe.tail.load(memory_order_relaxed);
+    }
+  }
+}
+
+/*
+ * Record one event. The hot path is a push into the caller's stripe; the
+ * thread that fills a stripe past drainThreshold tries to drain, and a
+ * thread that finds its stripe full drains synchronously. Events carry
+ * Insert/Erase membership changes, so unlike a pure recency buffer they are
+ * never dropped.
+ */
+template <typename T>
+void BufferedReplacer<T>::Record(const T &value, Op op) {
+  Event event;
+  // 同一value上的操作由调用者保证先后,顺序号保证回放时不会颠倒
+  event.seq = seq.fetch_add(1, memory_order_relaxed);
+  event.value = value;
+  event.op = op;
+  Stripe &stripe = LocalStripe();
+  while (!TryPush(stripe, event)) {
+    lock_guard<mutex> lck(drainLatch);
+    DrainLocked();
+  }
+  size_t queued = stripe.tail.load(memory_order_relaxed) -
+                  stripe.head.load(memory_order_relaxed);
+  if (queued >= drainThreshold && drainLatch.try_lock()) {
+    DrainLocked();
+    drainLatch.unlock();
+  }
+}
+
+/*
+ * Move every published event out of the stripes and apply the ones whose
+ * sequence numbers are contiguous. An event whose predecessor is still being
+ * pushed by another thread waits in pending for the next drain.
+ */
+template <typename T> void BufferedReplacer<T>::DrainLocked() {
+  for (auto &stripe : stripes) {
+    size_t head = stripe->head.load(memory_order_relaxed);
+    for (;;) {
+      Slot &slot = stripe->slots[head & (capacity - 1)];
+      if (slot.turn.load(memory_order_acquire) != head + 1)
+        break;
+      pending.emplace(slot.event.seq, slot.event);
+      if (slot.event.op == Op::ERASE)
+        erasing[slot.event.value]++;
+      slot.turn.store(head + capacity, memory_order_release);
+      head++;
+    }
+    stripe->head.store(head, memory_order_relaxed);
+  }
+  while (!pending.empty() && pending.begin()->first == nextApply) {
+    Event &event = pending.begin()->second;
+    if (event.op == Op::INSERT) {
+      replacer->Insert(event.value);
+    } else {
+      replacer->Erase(event.value);
+      auto it = erasing.find(event.value);
+      if (--it->second == 0)
+        erasing.erase(it);
+    }
+    pending.erase(pending.begin());
+    nextApply++;
+  }
+}
+
+template <typename T> void BufferedReplacer<T>::Drain() {
+  lock_guard<mutex> lck(drainLatch);
+  DrainLocked();
+}
+
+template <typename T> void BufferedReplacer<T>::Insert(const T &value) {
+  Record(value, Op::INSERT);
+}
+
+template <typename T> bool BufferedReplacer<T>::Erase(const T &value) {
+  Record(value, Op::ERASE);
+  return true;
+}
+
+/*
+ * Drain first so the victim is chosen from an up-to-date order. Every Erase
+ * that returned was published, so after the drain an Erase that is not
+ * applied yet is in pending, and its value is passed over
+ */
+template <typename T> bool BufferedReplacer<T>::Victim(T &value) {
+  lock_guard<mutex> lck(drainLatch);
+  DrainLocked();
+  if (erasing.empty())
+    return replacer->Victim(value);
+  return replacer->Victim(
+      value, [this](const T &v) { return erasing.count(v) == 0; },
+      replacer->Size());
+}
+
+template <typename T>
+bool BufferedReplacer<T>::Victim(T &value,
+                                 const function<bool(const T &)> &pred,
+                                 size_t scan_limit) {
+  lock_guard<mutex> lck(drainLatch);
+  DrainLocked();
+  if (erasing.empty())
+    return replacer->Victim(value, pred, scan_limit);
+  return replacer->Victim(
+      value, [&](const T &v) { return erasing.count(v) == 0 && pred(v); },
+      scan_limit);
+}
+
+template <typename T>
+size_t BufferedReplacer<T>::Peek(vector<T> &values, size_t n) {
+  lock_guard<mutex> lck(drainLatch);
+  DrainLocked();
+  if (erasing.empty())
+    return replacer->Peek(values, n);
+  vector<T> candidates;
+  replacer->Peek(candidates, n + erasing.size());
+  values.clear();
+  for (auto &v : candidates) {
+    if (values.size() < n && erasing.count(v) == 0)
+      values.push_back(v);
+  }
+  return values.size();
+}
+
+template <typename T> size_t BufferedReplacer<T>::Size() {
+  lock_guard<mutex> lck(drainLatch);
+  DrainLocked();
+  return replacer->Size();
+}
+
+template <typename T>
+void BufferedReplacer<T>::StartMaintenance(chrono::milliseconds interval) {
+  lock_guard<mutex> lck(maintainLatch);
+  if (running)
+    return;
+  running = true;
+  maintainer = thread([this, interval] {
+    unique_lock<mutex> lock(maintainLatch);
+    while (running) {
+      maintainCv.wait_for(lock, interval);
+      lock.unlock();
+      Drain();
+      lock.lock();
+    }
+  });
+}
+
+template <typename T> void BufferedReplacer<T>::StopMaintenance() {
+  {
+    lock_guard<mutex> lck(maintainLatch);
+    if (!running)
+      return;
+    running = false;
+  }
+  maintainCv.notify_all();
+  maintainer.join();
+}
+
+template class BufferedReplacer<Page *>;
+// test only
+template class BufferedReplacer<int>;
+
+}
@@ -0,0 +1,105 @@
+/**
+ * buffered_replacer.h
+ *
+ * Functionality: A replacer decorator that takes Insert/Erase off the latch
+ * of the wrapped replacer. Each call is recorded as an event in a striped ring
+ * buffer (one stripe per thread, chosen by thread id) and applied to the
+ * wrapped replacer in batches, either by whichever thread wins a try-lock on
+ * the drain latch once a stripe fills up, or by an optional maintenance
+ * thread. Victim and Size drain all pending events first, so the wrapped
+ * replacer still sees the Insert/Erase sequence in the order it was issued.
+ *
+ * A drain applies only a contiguous run of sequence numbers, so an Erase
+ * that already returned can wait behind an event whose sequence number was
+ * taken but not yet pushed. Victim and Peek skip every value with such an
+ * Erase outstanding: a pinned page is never handed out.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "buffer/scan_replacer.h"
+
+using namespace std;
+namespace scudb {
+
+template <typename T> class BufferedReplacer : public ScanReplacer<T> {
+  enum class Op : uint8_t { INSERT, ERASE };
+  struct Event {
+    uint64_t seq; // 全局顺序号,drain时按此顺序回放
+    T value;
+    Op op;
+  };
+  struct Slot {
+    atomic<size_t> turn; // 槽位状态,见Vyukov有界队列
+    Event event;
+  };
+  struct alignas(64) Stripe {
+    unique_ptr<Slot[]> slots;
+    atomic<size_t> tail; // 生产者写入位置
+    atomic<size_t> head; // 消费者读取位置,只在持有drainLatch时推进
+  };
+
+public:
+  // replacer: the wrapped replacer, owned by this object
+  // stripe_capacity is rounded up to a power of two
+  BufferedReplacer(ScanReplacer<T> *replacer, size_t num_stripes = 8,
+                   size_t stripe_capacity = 64, size_t drain_threshold = 32);
+
+  ~BufferedReplacer();
+
+  void Insert(const T &value);
+
+  bool Victim(T &value);
+
+  bool Victim(T &value, const function<bool(const T &)> &pred,
+              size_t scan_limit);
+
+  size_t Peek(vector<T> &values, size_t n);
+
+  // the return value only says the erase was recorded: whether value was in
+  // the replacer is known when the event is applied
+  bool Erase(const T &value);
+
+  size_t Size();
+
+  // apply every pending event to the wrapped replacer
+  void Drain();
+
+  // drain from a background thread every interval
+  void StartMaintenance(chrono::milliseconds interval);
+  void StopMaintenance();
+
+private:
+  void Record(const T &value, Op op);
+  bool TryPush(Stripe &stripe, const Event &event);
+  void DrainLocked();
+  Stripe &LocalStripe();
+
+  ScanReplacer<T> *replacer;
+  vector<unique_ptr<Stripe>> stripes;
+  size_t capacity;
+  size_t drainThreshold;
+  atomic<uint64_t> seq;
+
+  // 以下成员受drainLatch保护
+  mutex drainLatch;
+  uint64_t nextApply;           // 下一个应回放的顺序号
+  map<uint64_t, Event> pending; // 已取出但顺序号不连续、暂不能回放的事件
+  map<T, size_t> erasing;       // pending中尚未回放的Erase个数,Victim跳过这些值
+
+  thread maintainer;
+  bool running;
+  mutex maintainLatch;
+  condition_variable maintainCv;
+};
+
+}
@@ -0,0 +1,169 @@
+/**
+ * checkpoint_manager.cpp
+ */
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "logging/checkpoint_manager.h"
+
+namespace scudb {
+
+namespace {
+
+const char CHECKPOINT_MAGIC[8] = {'S', 'C', 'U', 'C', 'K', 'P', 'T', '1'};
+
+struct CheckpointFileHeader {
+  char magic[8];
+  lsn_t begin_lsn;
+  lsn_t redo_lsn;
+  uint64_t redo_offset;
+  uint64_t scan_offset;
+  uint32_t num_dirty_pages;
+  uint32_t num_active_txns;
+};
+
+struct CheckpointEntry {
+  int32_t id; // page id或事务id
+  lsn_t lsn;
+};
+
+} // namespace
+
+CheckpointManager::CheckpointManager(const std::string &path,
+                                     LogManager *log_manager,
+                                     BufferPoolManager *buffer_pool_manager)
+    : path_(path), log_manager_(log_manager),
+      buffer_pool_manager_(buffer_pool_manager), thread_(nullptr),
+      running_(false) {}
+
+CheckpointManager::~CheckpointManager() { Stop(); }
+
+/*
+ * The log tail is read before either table. A page missing from the dirty
+ * page table snapshot was clean and unpinned when it was taken (pinned pages
+ * are in it with the log tail at their pin as recLSN), so its updates not on
+ * disk were made under a later pin and logged at or after begin_lsn, which
+ * redo_lsn <= begin_lsn covers. Pages cleaned before the snapshot were
+ * only written, so their writes are synced (one group sync) before redo_lsn
+ * may skip them. The log is forced up to begin_lsn so the stored redo
+ * offset always points into the written log
+ */
+bool CheckpointManager::TakeCheckpoint(Checkpoint *checkpoint) {
+  std::lock_guard<std::mutex> lck(latch_);
+  Checkpoint ckpt;
+  ckpt.begin_lsn = log_manager_->GetNextLSN();
+  ckpt.active_txns = log_manager_->GetActiveTransactions();
+  ckpt.dirty_pages = buffer_pool_manager_->GetDirtyPageTable();
+  ckpt.redo_lsn = ckpt.begin_lsn;
+  for (auto &entry : ckpt.dirty_pages) {
+    // 没有记录recLSN的脏页(不写日志时)只能从头重做
+    lsn_t rec_lsn = entry.second == INVALID_LSN ? 0 : entry.second;
+    ckpt.redo_lsn = std::min(ckpt.redo_lsn, rec_lsn);
+  }
+  // 不在脏页表里的页已写回,但要等它们落盘,redo起点才能越过它们的日志
+  if (!buffer_pool_manager_->SyncWrites())
+    return false;
+  log_manager_->WaitForFlush(ckpt.begin_lsn - 1);
+  ckpt.redo_offset = log_manager_->GetLogOffset(ckpt.redo_lsn);
+  lsn_t scan_lsn = ckpt.redo_lsn;
+  for (auto &entry : ckpt.active_txns)
+    scan_lsn = std::min(scan_lsn, entry.second);
+  ckpt.scan_offset = log_manager_->GetLogOffset(scan_lsn);
+  if (!Store(path_, ckpt))
+    return false;
+  //旧批次的偏移不会再被用到
+  log_manager_->DiscardLogOffsets(scan_lsn);
+  if (checkpoint != nullptr)
+    *checkpoint = ckpt;
+  return true;
+}
+
+void CheckpointManager::Start(std::chrono::milliseconds interval) {
+  Stop();
+  running_ = true;
+  thread_ = new std::thread([this, interval] {
+    std::unique_lock<std::mutex> lock(thread_latch_);
+    while (!cv_.wait_for(lock, interval, [this] { return !running_; })) {
+      lock.unlock();
+      TakeCheckpoint();
+      lock.lock();
+    }
+  });
+}
+
+void CheckpointManager::Stop() {
+  if (thread_ == nullptr)
+    return;
+  {
+    std::lock_guard<std::mutex> lck(thread_latch_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  thread_->join();
+  delete thread_;
+  thread_ = nullptr;
+}
+
+bool CheckpointManager::Store(const std::string &path,
+                              const Checkpoint &checkpoint) {
+  CheckpointFileHeader header;
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.begin_lsn = checkpoint.begin_lsn;
+  header.redo_lsn = checkpoint.redo_lsn;
+  header.redo_offset = checkpoint.redo_offset;
+  header.scan_offset = checkpoint.scan_offset;
+  header.num_dirty_pages = checkpoint.dirty_pages.size();
+  header.num_active_txns = checkpoint.active_txns.size();
+  std::vector<CheckpointEntry> entries;
+  for (auto &entry : checkpoint.dirty_pages)
+    entries.push_back({entry.first, entry.second});
+  for (auto &entry : checkpoint.active_txns)
+    entries.push_back({entry.first, entry.second});
+
+  std::string tmp = path + ".tmp";
+  FILE *file = fopen(tmp.c_str(), "wb");
+  if (file == nullptr)
+    return false;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(entries.data(), sizeof(CheckpointEntry), entries.size(),
+                   file) == entries.size() &&
+            fflush(file) == 0 && fsync(fileno(file)) == 0;
+  ok = fclose(file) == 0 && ok;
+  return ok && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool CheckpointManager::Load(const std::string &path, Checkpoint &checkpoint) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr)
+    return false;
+  CheckpointFileHeader header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0;
+  std::vector<CheckpointEntry> entries;
+  if (ok) {
+    entries.resize(size_t(header.num_dirty_pages) + header.num_active_txns);
+    ok = fread(entries.data(), sizeof(CheckpointEntry), entries.size(), file) ==
+         entries.size();
+  }
+  fclose(file);
+  if (!ok)
+    return false;
+  checkpoint = Checkpoint();
+  checkpoint.begin_lsn = header.begin_lsn;
+  checkpoint.redo_lsn = header.redo_lsn;
+  checkpoint.redo_offset = header.redo_offset;
+  checkpoint.scan_offset = header.scan_offset;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (i < header.num_dirty_pages)
+      checkpoint.dirty_pages[entries[i].id] = entries[i].lsn;
+    else
+      checkpoint.active_txns[entries[i].id] = entries[i].lsn;
+  }
+  return true;
+}
+
+} // namespace scudb
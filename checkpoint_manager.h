@@ -0,0 +1,72 @@
+/**
+ * checkpoint_manager.h
+ *
+ * Functionality: Fuzzy checkpoints. A checkpoint snapshots the buffer pool's
+ * dirty page table (page id -> recLSN) and the log manager's active
+ * transaction table without flushing any page or pausing appends, and stores
+ * them with the point where redo must start: min(recLSN), or the log tail if
+ * no page is dirty. Dirty pages reach disk on their own, by eviction or the
+ * background writer (BufferPoolManager::StartBackgroundWriter), which moves
+ * that point forward for the next checkpoint. The background writer starts
+ * writeback of what it wrote right away, and the checkpoint makes those
+ * writes durable with one group sync before storing the new redo point.
+ *
+ * The log record format has no checkpoint type, so the checkpoint is kept in
+ * its own file, replaced atomically (write to path.tmp, fsync, rename).
+ */
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "buffer/buffer_pool_manager.h"
+#include "logging/log_manager.h"
+
+namespace scudb {
+
+struct Checkpoint {
+  lsn_t begin_lsn = INVALID_LSN; // log tail when the checkpoint started
+  lsn_t redo_lsn = INVALID_LSN;  // redo starts here
+  size_t redo_offset = 0;        // log file offset of the batch holding redo_lsn
+  // recovery reads the log from here: the batch holding the older of
+  // redo_lsn and the BEGIN of the oldest active transaction, which undo needs
+  size_t scan_offset = 0;
+  std::map<page_id_t, lsn_t> dirty_pages;  // page id -> recLSN
+  std::map<txn_id_t, lsn_t> active_txns;   // txn id -> LSN of its BEGIN
+};
+
+class CheckpointManager {
+public:
+  CheckpointManager(const std::string &path, LogManager *log_manager,
+                    BufferPoolManager *buffer_pool_manager);
+
+  ~CheckpointManager();
+
+  // take a fuzzy checkpoint and store it; returns false on I/O failure
+  bool TakeCheckpoint(Checkpoint *checkpoint = nullptr);
+
+  // take a checkpoint every interval on a background thread
+  void Start(std::chrono::milliseconds interval);
+  void Stop();
+
+  // read the last stored checkpoint; false if there is none or it is corrupt
+  static bool Load(const std::string &path, Checkpoint &checkpoint);
+
+private:
+  static bool Store(const std::string &path, const Checkpoint &checkpoint);
+
+  std::string path_;
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  std::mutex latch_; // serializes checkpoints
+  std::thread *thread_;
+  bool running_;
+  std::mutex thread_latch_;
+  std::condition_variable cv_;
+};
+
+} // namespace scudb
@@ -0,0 +1,196 @@
+/**
+ * checksum.cpp
+ */
+#include <cstring>
+
+#include "common/checksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define SCUDB_CRC32C_X86
+#endif
+
+namespace scudb {
+
+static const uint32_t CRC32C_POLY = 0x82F63B78; // reflected 0x1EDC6F41
+
+namespace {
+
+struct SlicingTables {
+  uint32_t t[8][256];
+  SlicingTables() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int k = 0; k < 8; k++)
+        crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+      t[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+      for (int k = 1; k < 8; k++)
+        t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+  }
+};
+
+const SlicingTables &Tables() {
+  static const SlicingTables tables;
+  return tables;
+}
+
+} // namespace
+
+/*
+ * Slicing-by-8: one table lookup per input byte, but the eight lookups of a
+ * word are independent, so they overlap instead of forming one long chain
+ */
+uint32_t Crc32cSoftware(const void *data, size_t len, uint32_t crc) {
+  const uint32_t(*t)[256] = Tables().t;
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  crc = ~crc;
+  for (; len > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0; len--)
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+  for (; len >= 8; len -= 8, p += 8) {
+    uint32_t lo, hi;
+    memcpy(&lo, p, 4);
+    memcpy(&hi, p + 4, 4);
+    lo ^= crc;
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^
+          t[4][lo >> 24] ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+          t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+  }
+  for (; len > 0; len--)
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+  return ~crc;
+}
+
+#ifdef SCUDB_CRC32C_X86
+/*
+ * The crc32 instruction has a latency of 3 cycles but a throughput of one
+ * per cycle, so a page is split into three lanes that are checksummed in
+ * parallel and then merged
+ */
+__attribute__((target("sse4.2"))) static inline uint64_t
+Crc32cWords(uint64_t crc, const unsigned char *p, size_t words) {
+  for (size_t i = 0; i < words; i++) {
+    uint64_t word;
+    memcpy(&word, p + i * 8, 8);
+    crc = _mm_crc32_u64(crc, word);
+  }
+  return crc;
+}
+
+/*
+ * Shift crc over len zero bytes (crc(A || 0^len) from crc(A)) with the
+ * square-and-multiply method over GF(2), used to merge the lanes
+ */
+static uint32_t MultiplyModP(uint32_t a, uint32_t b) {
+  uint32_t product = 0;
+  for (int i = 0; i < 32; i++) {
+    product ^= (0 - (b >> 31)) & a;
+    b <<= 1;
+    a = (a >> 1) ^ (CRC32C_POLY & (0 - (a & 1)));
+  }
+  return product;
+}
+
+static uint32_t ShiftOperator(size_t len) {
+  // x^(8*len) mod P, in reflected form. 0x80000000 is x^0
+  uint32_t result = 0x80000000, power = 0x00800000; // x^8
+  for (size_t n = len; n != 0; n >>= 1) {
+    if (n & 1)
+      result = MultiplyModP(result, power);
+    power = MultiplyModP(power, power);
+  }
+  return result;
+}
+
+namespace {
+
+/*
+ * Multiplying by a fixed shift operator is linear in the crc, so it is
+ * tabulated per byte: merging a lane costs four lookups instead of a 32-step
+ * multiplication
+ */
+struct LaneShift {
+  size_t lane = 0;
+  uint32_t table[4][256];
+
+  void Init(size_t lane_len) {
+    lane = lane_len;
+    uint32_t shift = ShiftOperator(lane_len);
+    for (int k = 0; k < 4; k++)
+      for (uint32_t i = 0; i < 256; i++)
+        table[k][i] = MultiplyModP(i << (8 * k), shift);
+  }
+
+  inline uint32_t Apply(uint32_t crc) const {
+    return table[0][crc & 0xFF] ^ table[1][(crc >> 8) & 0xFF] ^
+           table[2][(crc >> 16) & 0xFF] ^ table[3][crc >> 24];
+  }
+};
+
+// 调用方几乎总是对整页计算,缓存两种lane长度即可
+const LaneShift &CachedShift(size_t lane) {
+  static thread_local LaneShift cache[2];
+  static thread_local size_t next = 0;
+  for (auto &entry : cache)
+    if (entry.lane == lane)
+      return entry;
+  LaneShift &entry = cache[next++ % 2];
+  entry.Init(lane);
+  return entry;
+}
+
+} // namespace
+
+__attribute__((target("sse4.2"))) uint32_t
+Crc32cHardware(const void *data, size_t len, uint32_t crc) {
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  uint64_t c = ~crc & 0xFFFFFFFFu;
+  for (; len > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0; len--)
+    c = _mm_crc32_u8(c, *p++);
+  if (len >= 384) {
+    size_t lane_words = len / 24;
+    size_t lane = lane_words * 8;
+    uint64_t c1 = 0, c2 = 0;
+    const unsigned char *p1 = p + lane, *p2 = p + 2 * lane;
+    for (size_t i = 0; i < lane_words; i++) {
+      uint64_t w0, w1, w2;
+      memcpy(&w0, p + i * 8, 8);
+      memcpy(&w1, p1 + i * 8, 8);
+      memcpy(&w2, p2 + i * 8, 8);
+      c = _mm_crc32_u64(c, w0);
+      c1 = _mm_crc32_u64(c1, w1);
+      c2 = _mm_crc32_u64(c2, w2);
+    }
+    // crc(A||B) = shift(crc(A), |B|) xor crc0(B), crc0 starting from 0
+    const LaneShift &shift = CachedShift(lane);
+    c = shift.Apply(static_cast<uint32_t>(c)) ^ c1;
+    c = shift.Apply(static_cast<uint32_t>(c)) ^ c2;
+    p += 3 * lane;
+    len -= 3 * lane;
+  }
+  c = Crc32cWords(c, p, len / 8);
+  p += len / 8 * 8;
+  for (len %= 8; len > 0; len--)
+    c = _mm_crc32_u8(c, *p++);
+  return ~static_cast<uint32_t>(c);
+}
+
+bool Crc32cHardwareAvailable() {
+  static const bool available = __builtin_cpu_supports("sse4.2");
+  return available;
+}
+#else
+uint32_t Crc32cHardware(const void *data, size_t len, uint32_t crc) {
+  return Crc32cSoftware(data, len, crc);
+}
+
+bool Crc32cHardwareAvailable() { return false; }
+#endif
+
+uint32_t Crc32c(const void *data, size_t len, uint32_t crc) {
+  return Crc32cHardwareAvailable() ? Crc32cHardware(data, len, crc)
+                                   : Crc32cSoftware(data, len, crc);
+}
+
+} // namespace scudb
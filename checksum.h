@@ -0,0 +1,26 @@
+/**
+ * checksum.h
+ *
+ * Functionality: CRC32C (Castagnoli), the checksum stamped on every page
+ * the disk manager writes. Uses the SSE4.2 crc32 instruction when the CPU
+ * has it (checked once at startup) and a table-driven slicing-by-8
+ * implementation otherwise; both produce the same value.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace scudb {
+
+// extend crc with len bytes of data. Start with crc = 0
+uint32_t Crc32c(const void *data, size_t len, uint32_t crc = 0);
+
+// the two implementations, exposed for benchmarks and tests
+uint32_t Crc32cHardware(const void *data, size_t len, uint32_t crc);
+uint32_t Crc32cSoftware(const void *data, size_t len, uint32_t crc);
+
+// whether Crc32c uses the SSE4.2 instruction
+bool Crc32cHardwareAvailable();
+
+} // namespace scudb
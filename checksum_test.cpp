@@ -0,0 +1,91 @@
+/**
+ * checksum_test.cpp
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "common/checksum.h"
+#include "disk/disk_manager.h"
+#include "gtest/gtest.h"
+
+namespace scudb {
+
+TEST(ChecksumTest, KnownValues) {
+  const char *digits = "123456789";
+  EXPECT_EQ(0xE3069283u, Crc32c(digits, strlen(digits)));
+  EXPECT_EQ(0u, Crc32c(digits, 0));
+  // RFC 3720 B.4
+  char zeros[32] = {};
+  EXPECT_EQ(0x8A9136AAu, Crc32c(zeros, sizeof(zeros)));
+  char ones[32];
+  memset(ones, 0xff, sizeof(ones));
+  EXPECT_EQ(0x62A8AB43u, Crc32c(ones, sizeof(ones)));
+}
+
+TEST(ChecksumTest, IncrementalAndImplementationsAgree) {
+  std::vector<char> data(3 * PAGE_SIZE + 7);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = static_cast<char>(i * 131 + 7);
+  for (size_t offset : {0, 1, 3, 8}) {
+    for (size_t len : {0, 1, 7, 8, 63, 64, 65, 1000, 3 * PAGE_SIZE}) {
+      const char *p = data.data() + offset;
+      uint32_t crc = Crc32cSoftware(p, len, 0);
+      EXPECT_EQ(crc, Crc32c(p, len));
+      if (Crc32cHardwareAvailable()) {
+        EXPECT_EQ(crc, Crc32cHardware(p, len, 0));
+      }
+      size_t half = len / 2;
+      EXPECT_EQ(crc, Crc32c(p + half, len - half, Crc32c(p, half)));
+    }
+  }
+}
+
+// a corrupted page fails verification on read
+TEST(ChecksumTest, DiskManagerDetectsCorruption) {
+  std::string db = "checksum_test.db";
+  remove(db.c_str());
+  remove("checksum_test.log");
+  char page[PAGE_SIZE];
+  for (size_t i = 0; i < PAGE_SIZE; i++)
+    page[i] = static_cast<char>('a' + i % 26);
+  page_id_t page_id;
+  {
+    DiskManager disk_manager(db);
+    page_id = disk_manager.AllocatePage();
+    ASSERT_TRUE(disk_manager.WritePage(page_id, page));
+    char read[PAGE_SIZE];
+    ASSERT_TRUE(disk_manager.ReadPage(page_id, read));
+    EXPECT_EQ(0, memcmp(page, read, PAGE_SIZE));
+  }
+
+  // flip one byte of the page in the file
+  std::vector<char> file;
+  {
+    std::ifstream in(db, std::ios::binary);
+    file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  auto pos = std::search(file.begin(), file.end(), page, page + PAGE_SIZE);
+  ASSERT_NE(file.end(), pos);
+  pos[PAGE_SIZE / 2] ^= 1;
+  {
+    std::ofstream out(db, std::ios::binary | std::ios::in);
+    out.write(file.data(), file.size());
+  }
+
+  {
+    DiskManager disk_manager(db);
+    char read[PAGE_SIZE];
+    EXPECT_FALSE(disk_manager.ReadPage(page_id, read));
+    EXPECT_EQ(1, disk_manager.GetChecksumStats().failures);
+  }
+  remove(db.c_str());
+  remove("checksum_test.log");
+}
+
+} // namespace scudb
@@ -0,0 +1,137 @@
+/**
+ * Lock-free CLOCK implementation
+ */
+#include "buffer/clock_replacer.h"
+#include "page/page.h"
+
+namespace scudb {
+
+template <typename T> const uint8_t ClockReplacer<T>::EVICTABLE;
+template <typename T> const uint8_t ClockReplacer<T>::REFERENCED;
+
+template <typename T>
+ClockReplacer<T>::ClockReplacer(size_t num_frames, T base)
+    : base(base), numFrames(num_frames), state(new atomic<uint8_t>[num_frames]),
+      hand(0), size(0) {
+  for (size_t i = 0; i < numFrames; i++)
+    state[i].store(0, memory_order_relaxed);
+}
+
+template <typename T> ClockReplacer<T>::~ClockReplacer() {}
+
+/*
+ * Mark value evictable and referenced. Values outside
+ * [base, base + num_frames) are ignored
+ */
+template <typename T> void ClockReplacer<T>::Insert(const T &value) {
+  size_t frame = FrameOf(value);
+  if (frame >= numFrames)
+    return;
+  uint8_t old = state[frame].fetch_or(EVICTABLE | REFERENCED);
+  if (!(old & EVICTABLE))
+    size.fetch_add(1);
+}
+
+/*
+ * Sweep the clock hand until an evictable frame without the reference bit is
+ * claimed. A referenced frame has its bit cleared and is skipped this round.
+ * Returns false once no frame is evictable
+ */
+template <typename T> bool ClockReplacer<T>::Victim(T &value) {
+  while (size.load() > 0) {
+    //最多扫描两圈:第一圈清除所有引用位,第二圈必能找到可替换的frame
+    for (size_t i = 0; i < 2 * numFrames; i++) {
+      size_t frame = hand.fetch_add(1) % numFrames;
+      uint8_t s = state[frame].load();
+      if (!(s & EVICTABLE))
+        continue;
+      if (s & REFERENCED) {
+        //CAS失败说明有其他线程刚刚修改过该frame,这一轮跳过即可
+        state[frame].compare_exchange_strong(s, s & ~REFERENCED);
+        continue;
+      }
+      if (state[frame].compare_exchange_strong(s, 0)) {
+        size.fetch_sub(1);
+        value = base + frame;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/*
+ * Sweep like Victim(T &), but only unreferenced evictable frames count as
+ * candidates, and a candidate is claimed only if pred accepts it. Rejected
+ * frames keep their state
+ */
+template <typename T>
+bool ClockReplacer<T>::Victim(T &value, const function<bool(const T &)> &pred,
+                              size_t scan_limit) {
+  size_t examined = 0;
+  for (size_t i = 0; i < 2 * numFrames && examined < scan_limit; i++) {
+    if (size.load() <= 0)
+      return false;
+    size_t frame = hand.fetch_add(1) % numFrames;
+    uint8_t s = state[frame].load();
+    if (!(s & EVICTABLE))
+      continue;
+    if (s & REFERENCED) {
+      state[frame].compare_exchange_strong(s, s & ~REFERENCED);
+      continue;
+    }
+    examined++;
+    if (!pred(base + frame))
+      continue;
+    if (state[frame].compare_exchange_strong(s, 0)) {
+      size.fetch_sub(1);
+      value = base + frame;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * CLOCK has no total order; starting at the hand, unreferenced evictable
+ * frames are reported first, then referenced ones. The hand does not move
+ */
+template <typename T>
+size_t ClockReplacer<T>::Peek(vector<T> &values, size_t n) {
+  values.clear();
+  size_t start = hand.load();
+  for (int pass = 0; pass < 2; pass++) {
+    uint8_t want = pass == 0 ? EVICTABLE : (EVICTABLE | REFERENCED);
+    for (size_t i = 0; i < numFrames && values.size() < n; i++) {
+      size_t frame = (start + i) % numFrames;
+      if (state[frame].load() == want)
+        values.push_back(base + frame);
+    }
+  }
+  return values.size();
+}
+
+/*
+ * Remove value from the replacer. If removal is successful, return true,
+ * otherwise return false
+ */
+template <typename T> bool ClockReplacer<T>::Erase(const T &value) {
+  size_t frame = FrameOf(value);
+  if (frame >= numFrames)
+    return false;
+  if (!(state[frame].exchange(0) & EVICTABLE))
+    return false;
+  size.fetch_sub(1);
+  return true;
+}
+
+template <typename T> size_t ClockReplacer<T>::Size() {
+  int64_t n = size.load();
+  return n > 0 ? n : 0;
+}
+
+template class ClockReplacer<Page *>;
+// test only
+template class ClockReplacer<int>;
+
+}
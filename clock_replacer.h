@@ -0,0 +1,61 @@
+/**
+ * clock_replacer.h
+ *
+ * Functionality: A lock-free CLOCK replacer for high-core-count hosts. Every
+ * frame has one atomic state word holding an evictable flag and a reference
+ * bit. Insert and Erase are a single atomic operation on that word, so
+ * threads unpinning pages never block each other. Victim advances a shared
+ * atomic clock hand: frames with the reference bit set get a second chance,
+ * and an evictable frame is claimed with a CAS, so concurrent victim searches
+ * always claim distinct frames. Like FrameLRUReplacer, values are mapped to
+ * frame indexes as value - base.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "buffer/scan_replacer.h"
+
+using namespace std;
+namespace scudb {
+
+template <typename T> class ClockReplacer : public ScanReplacer<T> {
+public:
+  // num_frames: number of frames; base: the value of frame 0 (e.g. pages_)
+  ClockReplacer(size_t num_frames, T base = T());
+
+  ~ClockReplacer();
+
+  void Insert(const T &value);
+
+  bool Victim(T &value);
+
+  bool Victim(T &value, const function<bool(const T &)> &pred,
+              size_t scan_limit);
+
+  size_t Peek(vector<T> &values, size_t n);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+private:
+  static const uint8_t EVICTABLE = 1;
+  static const uint8_t REFERENCED = 2;
+
+  inline size_t FrameOf(const T &value) const {
+    return static_cast<size_t>(value - base);
+  }
+
+  T base;
+  size_t numFrames;
+  unique_ptr<atomic<uint8_t>[]> state;
+  atomic<size_t> hand;
+  // 可被替换的frame数量;Insert与Victim之间可能短暂为负
+  atomic<int64_t> size;
+};
+
+}
@@ -0,0 +1,317 @@
+/**
+ * compressed_page_store.cpp
+ */
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/checksum.h"
+#include "common/compression.h"
+#include "common/logger.h"
+#include "disk/compressed_page_store.h"
+
+namespace scudb {
+
+const size_t CompressedPageStore::SECTORS_PER_PAGE;
+const size_t CompressedPageStore::SECTOR_SIZE;
+const size_t CompressedPageStore::MAX_SECTORS;
+const size_t CompressedPageStore::HEADER_SIZE;
+
+// 压缩格式,记录在slot头部
+static const uint8_t CODEC_ZERO_RUN = 1;
+static const uint8_t CODEC_LZ4 = 2;
+
+static bool PwriteFull(int fd, const char *data, size_t size, off_t offset) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = pwrite(fd, data + done, size - done, offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    done += n;
+  }
+  return true;
+}
+
+static bool PreadFull(int fd, char *data, size_t size, off_t offset) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = pread(fd, data + done, size - done, offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    done += n;
+  }
+  return true;
+}
+
+static bool SyncFd(int fd) {
+  int rc;
+  do {
+    rc = fdatasync(fd);
+  } while (rc < 0 && errno == EINTR);
+  return rc == 0;
+}
+
+CompressedPageStore::CompressedPageStore(const std::string &path)
+    : free_(SECTORS_PER_PAGE + 1), end_sector_(0) {
+  data_fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  map_fd_ = open((path + ".map").c_str(), O_RDWR | O_CREAT, 0644);
+  if (!IsOpen()) {
+    LOG_DEBUG("can't open compressed page store");
+    return;
+  }
+  Load();
+}
+
+CompressedPageStore::~CompressedPageStore() {
+  if (IsOpen() && !Sync())
+    LOG_DEBUG("I/O error while syncing compressed page store");
+  if (data_fd_ >= 0)
+    close(data_fd_);
+  if (map_fd_ >= 0)
+    close(map_fd_);
+}
+
+bool CompressedPageStore::IsOpen() const { return data_fd_ >= 0 && map_fd_ >= 0; }
+
+/*
+ * Rebuild the free slots from the map: every sector below the end of the
+ * data file that no entry covers is free. An entry reaching past the end
+ * of the file (its image never made it to disk) is dropped
+ */
+void CompressedPageStore::Load() {
+  struct stat st;
+  if (fstat(map_fd_, &st) == 0 && st.st_size >= 8) {
+    std::vector<char> raw(st.st_size / 8 * 8);
+    if (PreadFull(map_fd_, raw.data(), raw.size(), 0)) {
+      map_.resize(raw.size() / 8);
+      for (size_t i = 0; i < map_.size(); i++) {
+        memcpy(&map_[i].sector, &raw[i * 8], 4);
+        memcpy(&map_[i].sectors, &raw[i * 8 + 4], 4);
+      }
+    }
+  }
+  end_sector_ = fstat(data_fd_, &st) == 0 ? st.st_size / SECTOR_SIZE : 0;
+  std::vector<bool> used(end_sector_, false);
+  for (auto &entry : map_) {
+    if (entry.sectors == 0)
+      continue;
+    if (entry.sectors > MAX_SECTORS ||
+        entry.sector + entry.sectors > end_sector_) {
+      entry = Entry();
+      continue;
+    }
+    for (uint32_t s = entry.sector; s < entry.sector + entry.sectors; s++)
+      used[s] = true;
+    stats_.used_sectors += entry.sectors;
+  }
+  for (uint32_t s = 0; s < end_sector_;) {
+    if (used[s]) {
+      s++;
+      continue;
+    }
+    uint32_t run = 0;
+    while (s + run < end_sector_ && !used[s + run] && run < SECTORS_PER_PAGE)
+      run++;
+    free_[run].push_back(s);
+    s += run;
+  }
+}
+
+/*
+ * LZ4 when it is compiled in, else the zero-run codec, which still catches
+ * the free space in the middle of a slotted page. cap bounds the work on
+ * incompressible pages
+ */
+size_t CompressedPageStore::Encode(const char *data, char *dst, size_t cap,
+                                   uint8_t &codec) {
+  if (Lz4Available()) {
+    codec = CODEC_LZ4;
+    return Lz4Compress(data, PAGE_SIZE, dst, cap);
+  }
+  codec = CODEC_ZERO_RUN;
+  return ZeroRunEncode(data, PAGE_SIZE, dst, cap);
+}
+
+uint32_t CompressedPageStore::AllocateSlot(uint32_t sectors) {
+  for (size_t n = sectors; n <= SECTORS_PER_PAGE; n++) {
+    if (free_[n].empty())
+      continue;
+    uint32_t sector = free_[n].back();
+    free_[n].pop_back();
+    if (n > sectors)
+      free_[n - sectors].push_back(sector + sectors);
+    return sector;
+  }
+  uint32_t sector = end_sector_;
+  end_sector_ += sectors;
+  return sector;
+}
+
+void CompressedPageStore::FreeSlot(const Entry &entry) {
+  pending_.push_back(entry);
+  stats_.used_sectors -= entry.sectors;
+}
+
+bool CompressedPageStore::WriteEntry(page_id_t page_id, const Entry &entry) {
+  char raw[8];
+  memcpy(raw, &entry.sector, 4);
+  memcpy(raw + 4, &entry.sectors, 4);
+  return PwriteFull(map_fd_, raw, sizeof(raw), static_cast<off_t>(page_id) * 8);
+}
+
+/*
+ * Compress into a fresh slot, then switch the map entry to it in memory;
+ * the next sync writes the entry
+ */
+bool CompressedPageStore::Write(page_id_t page_id, const char *data) {
+  char image[MAX_SECTORS * SECTOR_SIZE];
+  uint8_t codec;
+  size_t len = Encode(data, image + HEADER_SIZE,
+                      MAX_SECTORS * SECTOR_SIZE - HEADER_SIZE, codec);
+  if (len == 0) {
+    std::lock_guard<std::mutex> lock(latch_);
+    stats_.bypassed_writes++;
+    return false;
+  }
+  uint32_t crc = Crc32c(image + HEADER_SIZE, len);
+  crc = Crc32c(&page_id, sizeof(page_id), crc);
+  uint16_t length = len;
+  memcpy(image, &page_id, 4);
+  memcpy(image + 4, &length, 2);
+  image[6] = codec;
+  image[7] = 0;
+  memcpy(image + 8, &crc, 4);
+  Entry entry;
+  entry.sectors = (HEADER_SIZE + len + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  memset(image + HEADER_SIZE + len, 0,
+         entry.sectors * SECTOR_SIZE - HEADER_SIZE - len);
+  {
+    std::lock_guard<std::mutex> lock(latch_);
+    entry.sector = AllocateSlot(entry.sectors);
+  }
+  bool ok = PwriteFull(data_fd_, image, entry.sectors * SECTOR_SIZE,
+                       static_cast<off_t>(entry.sector) * SECTOR_SIZE);
+  std::lock_guard<std::mutex> lock(latch_);
+  if (!ok) {
+    // 新slot从未被引用,可以直接回收
+    free_[entry.sectors].push_back(entry.sector);
+    return false;
+  }
+  if (static_cast<size_t>(page_id) >= map_.size())
+    map_.resize(page_id + 1);
+  Entry old = map_[page_id];
+  map_[page_id] = entry;
+  dirty_.insert(page_id);
+  stats_.used_sectors += entry.sectors;
+  if (old.sectors != 0)
+    FreeSlot(old);
+  stats_.compressed_writes++;
+  stats_.bytes_in += PAGE_SIZE;
+  stats_.bytes_out += len;
+  return true;
+}
+
+bool CompressedPageStore::Read(page_id_t page_id, char *data, bool &mapped) {
+  Entry entry;
+  {
+    std::lock_guard<std::mutex> lock(latch_);
+    if (page_id >= 0 && static_cast<size_t>(page_id) < map_.size())
+      entry = map_[page_id];
+    mapped = entry.sectors != 0;
+    if (!mapped)
+      return true;
+    stats_.compressed_reads++;
+  }
+  char image[MAX_SECTORS * SECTOR_SIZE];
+  size_t size = entry.sectors * SECTOR_SIZE;
+  if (!PreadFull(data_fd_, image, size,
+                 static_cast<off_t>(entry.sector) * SECTOR_SIZE))
+    return false;
+  page_id_t id;
+  uint16_t length;
+  uint32_t crc;
+  memcpy(&id, image, 4);
+  memcpy(&length, image + 4, 2);
+  memcpy(&crc, image + 8, 4);
+  if (id != page_id || HEADER_SIZE + length > size)
+    return false;
+  uint32_t actual = Crc32c(image + HEADER_SIZE, length);
+  if (Crc32c(&page_id, sizeof(page_id), actual) != crc)
+    return false;
+  if (image[6] == CODEC_LZ4)
+    return Lz4Decompress(image + HEADER_SIZE, length, data, PAGE_SIZE);
+  if (image[6] == CODEC_ZERO_RUN)
+    return ZeroRunDecode(image + HEADER_SIZE, length, data, PAGE_SIZE);
+  return false;
+}
+
+bool CompressedPageStore::Remove(page_id_t page_id) {
+  std::lock_guard<std::mutex> lock(latch_);
+  if (page_id < 0 || static_cast<size_t>(page_id) >= map_.size() ||
+      map_[page_id].sectors == 0)
+    return false;
+  FreeSlot(map_[page_id]);
+  map_[page_id] = Entry();
+  dirty_.insert(page_id);
+  return true;
+}
+
+CompressedPageStore::MapChanges CompressedPageStore::TakeChanges() {
+  MapChanges changes;
+  std::lock_guard<std::mutex> lock(latch_);
+  for (page_id_t page_id : dirty_)
+    changes.entries.emplace_back(page_id, map_[page_id]);
+  dirty_.clear();
+  changes.releasing.swap(pending_);
+  return changes;
+}
+
+/*
+ * The data file is synced before any entry is written, so no entry on disk
+ * points at an image that may not be there. The slots released were freed
+ * by the entries written here, so they become reusable once the map is
+ * synced
+ */
+bool CompressedPageStore::Sync(MapChanges &changes) {
+  if (changes.entries.empty())
+    return true;
+  bool ok = SyncFd(data_fd_);
+  for (size_t i = 0; ok && i < changes.entries.size(); i++)
+    ok = WriteEntry(changes.entries[i].first, changes.entries[i].second);
+  ok = ok && SyncFd(map_fd_);
+  std::lock_guard<std::mutex> lock(latch_);
+  if (!ok) {
+    // 未写成的改动留给下一次同步,其间又改过的页写的是新值
+    for (auto &change : changes.entries)
+      dirty_.insert(change.first);
+    pending_.insert(pending_.end(), changes.releasing.begin(),
+                    changes.releasing.end());
+    return false;
+  }
+  for (auto &entry : changes.releasing)
+    free_[entry.sectors].push_back(entry.sector);
+  return true;
+}
+
+bool CompressedPageStore::Sync() {
+  MapChanges changes = TakeChanges();
+  return Sync(changes);
+}
+
+CompressionStats CompressedPageStore::GetStats() {
+  std::lock_guard<std::mutex> lock(latch_);
+  CompressionStats stats = stats_;
+  for (size_t n = 1; n <= SECTORS_PER_PAGE; n++)
+    stats.free_sectors += free_[n].size() * n;
+  for (auto &entry : pending_)
+    stats.free_sectors += entry.sectors;
+  return stats;
+}
+
+} // namespace scudb
@@ -0,0 +1,127 @@
+/**
+ * compressed_page_store.h
+ *
+ * Functionality: Compressed page images for DiskManager. A page that
+ * compresses well is written, compressed, into a variable-size slot of a
+ * side file instead of into its home slot, so reading and writing it moves
+ * a fraction of PAGE_SIZE. Frames in the buffer pool stay uncompressed.
+ *
+ * Slots are runs of 1 to SECTORS_PER_PAGE sectors of SECTOR_SIZE bytes. A
+ * slot starts with a header (page id, codec, length and the CRC32C of the
+ * compressed bytes) followed by the compressed page. A page only goes
+ * into the store when it fits in at most MAX_SECTORS sectors; anything
+ * bigger isn't worth a detour and stays in its home slot. The encoder
+ * gives up as soon as the output exceeds that, so an incompressible page
+ * costs little CPU.
+ *
+ * The page map file holds one 8-byte entry per page id: the first sector
+ * and the sector count of the page's slot, or zero for "in its home slot".
+ * It is read whole on open. Map changes are kept in memory and only written
+ * by a sync, after the data file is synced, so an entry on disk never points
+ * at an image that isn't.
+ *
+ * Writes are copy-on-write: the new image goes into a free slot, then the
+ * map entry is switched, then the old slot is freed. A freed slot is only
+ * reused once the sync that writes the new entry is done, so until then
+ * the entry on disk still points at intact data. Free slots are kept in one
+ * list per sector count; a request with no free slot of its size splits a
+ * bigger one or extends the file.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+
+namespace scudb {
+
+struct CompressionStats {
+  size_t compressed_writes = 0; // pages written into the store
+  size_t bypassed_writes = 0;   // pages too incompressible for the store
+  size_t compressed_reads = 0;  // pages read from the store
+  size_t bytes_in = 0;          // PAGE_SIZE per compressed write
+  size_t bytes_out = 0;         // compressed bytes of those writes
+  size_t used_sectors = 0;      // sectors held by current page images
+  size_t free_sectors = 0;      // sectors free or waiting for a sync
+};
+
+class CompressedPageStore {
+public:
+  static const size_t SECTORS_PER_PAGE = 8;
+  static const size_t SECTOR_SIZE = PAGE_SIZE / SECTORS_PER_PAGE;
+  // a page is only stored compressed when it saves at least a quarter
+  static const size_t MAX_SECTORS = SECTORS_PER_PAGE * 3 / 4;
+  static const size_t HEADER_SIZE = 12;
+
+  // open or create path (the slots) and path.map (the page map)
+  explicit CompressedPageStore(const std::string &path);
+  ~CompressedPageStore();
+
+  // whether both files are open
+  bool IsOpen() const;
+
+  // store page_id compressed. Returns false, without touching the store,
+  // if the page doesn't compress enough or can't be written; it belongs in
+  // its home slot then (see Remove)
+  bool Write(page_id_t page_id, const char *data);
+
+  // read page_id into data if it is in the store. mapped tells whether it
+  // is; the result is false if its image can't be read or fails its CRC
+  bool Read(page_id_t page_id, char *data, bool &mapped);
+
+  // take page_id out of the store, after its image was written to the
+  // home slot or the page was deallocated. Returns whether it was there
+  bool Remove(page_id_t page_id);
+
+  struct Entry {
+    uint32_t sector = 0;
+    uint32_t sectors = 0; // 0: not in the store
+  };
+  // map changes not written yet, and the slots they free
+  struct MapChanges {
+    std::vector<std::pair<page_id_t, Entry>> entries;
+    std::vector<Entry> releasing;
+  };
+
+  // take the map changes made so far, for Sync. A caller that also syncs
+  // the home slots takes them first, so the home image of every Remove it
+  // takes is synced before the entry
+  MapChanges TakeChanges();
+
+  // sync the data file, write changes into the map and sync it, then make
+  // the slots they free reusable. On failure the changes are kept for the
+  // next sync
+  bool Sync(MapChanges &changes);
+
+  // make every write so far durable
+  bool Sync();
+
+  CompressionStats GetStats();
+
+private:
+  static size_t Encode(const char *data, char *dst, size_t cap, uint8_t &codec);
+  uint32_t AllocateSlot(uint32_t sectors);
+  void FreeSlot(const Entry &entry);
+  bool WriteEntry(page_id_t page_id, const Entry &entry);
+  void Load();
+
+  int data_fd_;
+  int map_fd_;
+  // allocation state and map, protected by latch_
+  std::mutex latch_;
+  std::vector<Entry> map_;
+  std::set<page_id_t> dirty_; // pages whose map entry changed since a sync
+  // free slots by sector count (index 1..SECTORS_PER_PAGE)
+  std::vector<std::vector<uint32_t>> free_;
+  // slots freed by map changes not taken by a sync yet
+  std::vector<Entry> pending_;
+  uint32_t end_sector_;
+  CompressionStats stats_;
+};
+
+} // namespace scudb
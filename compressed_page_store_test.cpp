@@ -0,0 +1,137 @@
+/**
+ * compressed_page_store_test.cpp
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "disk/compressed_page_store.h"
+#include "disk/disk_manager.h"
+#include "gtest/gtest.h"
+
+namespace scudb {
+
+static void RemoveStore(const std::string &path) {
+  remove(path.c_str());
+  remove((path + ".map").c_str());
+}
+
+// mostly zeros with a few bytes set: compresses well
+static void SparsePage(char *data, int seed) {
+  memset(data, 0, PAGE_SIZE);
+  for (int i = 0; i < 16; i++)
+    data[(i * 37 + seed) % PAGE_SIZE] = static_cast<char>(seed + i);
+}
+
+TEST(CompressedPageStoreTest, WriteReadRemove) {
+  std::string path = "compressed_page_store_test.cpg";
+  RemoveStore(path);
+  CompressedPageStore store(path);
+  ASSERT_TRUE(store.IsOpen());
+
+  char page[PAGE_SIZE], read[PAGE_SIZE];
+  bool mapped;
+  SparsePage(page, 1);
+  ASSERT_TRUE(store.Write(3, page));
+  EXPECT_TRUE(store.Read(3, read, mapped));
+  EXPECT_TRUE(mapped);
+  EXPECT_EQ(0, memcmp(page, read, PAGE_SIZE));
+  EXPECT_EQ(1, store.GetStats().compressed_writes);
+
+  // a page that doesn't compress stays out of the store
+  std::mt19937 rng(7);
+  char noise[PAGE_SIZE];
+  for (size_t i = 0; i < PAGE_SIZE; i++)
+    noise[i] = static_cast<char>(rng());
+  EXPECT_FALSE(store.Write(4, noise));
+  store.Read(4, read, mapped);
+  EXPECT_FALSE(mapped);
+  EXPECT_EQ(1, store.GetStats().bypassed_writes);
+
+  EXPECT_TRUE(store.Remove(3));
+  EXPECT_FALSE(store.Remove(3));
+  store.Read(3, read, mapped);
+  EXPECT_FALSE(mapped);
+  RemoveStore(path);
+}
+
+// a rewritten page's old slot is only reusable after a sync
+TEST(CompressedPageStoreTest, CopyOnWrite) {
+  std::string path = "compressed_page_store_test.cpg";
+  RemoveStore(path);
+  CompressedPageStore store(path);
+  char page[PAGE_SIZE], read[PAGE_SIZE];
+  bool mapped;
+  SparsePage(page, 1);
+  ASSERT_TRUE(store.Write(0, page));
+  size_t used = store.GetStats().used_sectors;
+  EXPECT_EQ(0, store.GetStats().free_sectors);
+
+  SparsePage(page, 2);
+  ASSERT_TRUE(store.Write(0, page));
+  EXPECT_EQ(used, store.GetStats().used_sectors);
+  EXPECT_EQ(used, store.GetStats().free_sectors);
+  ASSERT_TRUE(store.Sync());
+  ASSERT_TRUE(store.Write(1, page));
+  // the new image took the slot the sync released
+  EXPECT_EQ(0, store.GetStats().free_sectors);
+  EXPECT_TRUE(store.Read(0, read, mapped));
+  EXPECT_EQ(0, memcmp(page, read, PAGE_SIZE));
+  RemoveStore(path);
+}
+
+TEST(CompressedPageStoreTest, Reopen) {
+  std::string path = "compressed_page_store_test.cpg";
+  RemoveStore(path);
+  char page[PAGE_SIZE], read[PAGE_SIZE];
+  bool mapped;
+  {
+    CompressedPageStore store(path);
+    for (int i = 0; i < 10; i++) {
+      SparsePage(page, i);
+      ASSERT_TRUE(store.Write(i, page));
+    }
+    ASSERT_TRUE(store.Sync());
+    store.Remove(5);
+  }
+  CompressedPageStore store(path);
+  for (int i = 0; i < 10; i++) {
+    SparsePage(page, i);
+    EXPECT_TRUE(store.Read(i, read, mapped));
+    EXPECT_EQ(i != 5, mapped);
+    if (mapped) {
+      EXPECT_EQ(0, memcmp(page, read, PAGE_SIZE));
+    }
+  }
+  RemoveStore(path);
+}
+
+TEST(CompressedPageStoreTest, DiskManagerCompression) {
+  std::string db = "compressed_page_store_test.db";
+  remove(db.c_str());
+  RemoveStore(db + ".cpg");
+  char page[PAGE_SIZE], read[PAGE_SIZE];
+  page_id_t page_id;
+  {
+    DiskManager disk_manager(db);
+    ASSERT_TRUE(disk_manager.SetPageCompression(true));
+    page_id = disk_manager.AllocatePage();
+    SparsePage(page, 3);
+    ASSERT_TRUE(disk_manager.WritePage(page_id, page));
+    ASSERT_TRUE(disk_manager.ReadPage(page_id, read));
+    EXPECT_EQ(0, memcmp(page, read, PAGE_SIZE));
+    EXPECT_EQ(1, disk_manager.GetCompressionStats().compressed_writes);
+    ASSERT_TRUE(disk_manager.SyncUpTo(disk_manager.WriteMark()));
+  }
+  // reopened with its store even with compression off
+  DiskManager disk_manager(db);
+  ASSERT_TRUE(disk_manager.ReadPage(page_id, read));
+  EXPECT_EQ(0, memcmp(page, read, PAGE_SIZE));
+  remove(db.c_str());
+  remove("compressed_page_store_test.log");
+  RemoveStore(db + ".cpg");
+}
+
+} // namespace scudb
@@ -0,0 +1,153 @@
+/**
+ * compression.cpp
+ */
+
+#include <cstring>
+#include <vector>
+
+#ifdef SCUDB_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#include "common/compression.h"
+
+namespace scudb {
+
+size_t PutVarint(char *dst, size_t cap, uint64_t value) {
+  size_t n = 0;
+  do {
+    if (n == cap)
+      return 0;
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    dst[n++] = static_cast<char>(value != 0 ? byte | 0x80 : byte);
+  } while (value != 0);
+  return n;
+}
+
+size_t GetVarint(const char *src, size_t len, uint64_t &value) {
+  value = 0;
+  for (size_t n = 0; n < len && n < 10; n++) {
+    uint8_t byte = static_cast<uint8_t>(src[n]);
+    value |= static_cast<uint64_t>(byte & 0x7f) << (7 * n);
+    if ((byte & 0x80) == 0)
+      return n + 1;
+  }
+  return 0;
+}
+
+/*
+ * 扫描时按8字节一组跳过零,页面和更新前后像差异中的零段通常很长
+ */
+static size_t ZeroRunLength(const char *src, size_t len) {
+  size_t n = 0;
+  uint64_t word;
+  while (n + sizeof(word) <= len) {
+    memcpy(&word, src + n, sizeof(word));
+    if (word != 0)
+      break;
+    n += sizeof(word);
+  }
+  while (n < len && src[n] == 0)
+    n++;
+  return n;
+}
+
+size_t ZeroRunEncode(const char *src, size_t len, char *dst, size_t cap) {
+  size_t in = 0, out = 0;
+  while (in < len) {
+    size_t zeros = ZeroRunLength(src + in, len - in);
+    size_t literal = in + zeros;
+    // 短于3字节的零段并入字面量,单独编码不划算
+    size_t end = literal;
+    while (end < len) {
+      size_t run = ZeroRunLength(src + end, len - end);
+      if (run >= 3 || end + run == len)
+        break;
+      end += run == 0 ? 1 : run;
+    }
+    size_t n = PutVarint(dst + out, cap - out, zeros);
+    if (n == 0)
+      return 0;
+    out += n;
+    n = PutVarint(dst + out, cap - out, end - literal);
+    if (n == 0 || cap - out - n < end - literal)
+      return 0;
+    out += n;
+    memcpy(dst + out, src + literal, end - literal);
+    out += end - literal;
+    in = end;
+  }
+  return out;
+}
+
+bool ZeroRunDecode(const char *src, size_t len, char *dst, size_t dst_len) {
+  size_t in = 0, out = 0;
+  while (out < dst_len) {
+    uint64_t zeros, literal;
+    size_t n = GetVarint(src + in, len - in, zeros);
+    if (n == 0 || zeros > dst_len - out)
+      return false;
+    in += n;
+    memset(dst + out, 0, zeros);
+    out += zeros;
+    n = GetVarint(src + in, len - in, literal);
+    if (n == 0 || literal > dst_len - out || literal > len - in - n)
+      return false;
+    in += n;
+    memcpy(dst + out, src + in, literal);
+    in += literal;
+    out += literal;
+  }
+  return in == len;
+}
+
+size_t XorDeltaEncode(const char *base, size_t base_len, const char *target,
+                      size_t target_len, char *dst, size_t cap) {
+  static thread_local std::vector<char> buffer;
+  buffer.resize(target_len);
+  char *diff = buffer.data();
+  size_t common = base_len < target_len ? base_len : target_len;
+  for (size_t i = 0; i < common; i++)
+    diff[i] = base[i] ^ target[i];
+  memcpy(diff + common, target + common, target_len - common);
+  return ZeroRunEncode(diff, target_len, dst, cap);
+}
+
+bool XorDeltaDecode(const char *base, size_t base_len, const char *src,
+                    size_t len, char *target, size_t target_len) {
+  if (!ZeroRunDecode(src, len, target, target_len))
+    return false;
+  size_t common = base_len < target_len ? base_len : target_len;
+  for (size_t i = 0; i < common; i++)
+    target[i] ^= base[i];
+  return true;
+}
+
+#ifdef SCUDB_HAVE_LZ4
+
+bool Lz4Available() { return true; }
+
+size_t Lz4Compress(const char *src, size_t len, char *dst, size_t cap) {
+  int n = LZ4_compress_default(src, dst, static_cast<int>(len),
+                               static_cast<int>(cap));
+  return n > 0 ? n : 0;
+}
+
+bool Lz4Decompress(const char *src, size_t len, char *dst, size_t dst_len) {
+  int n = LZ4_decompress_safe(src, dst, static_cast<int>(len),
+                              static_cast<int>(dst_len));
+  return n >= 0 && static_cast<size_t>(n) == dst_len;
+}
+
+#else
+
+bool Lz4Available() { return false; }
+
+size_t Lz4Compress(const char *, size_t, char *, size_t) { return 0; }
+
+bool Lz4Decompress(const char *, size_t, char *, size_t) { return false; }
+
+#endif
+
+} // namespace scudb
@@ -0,0 +1,49 @@
+/**
+ * compression.h
+ *
+ * Functionality: Byte-level codecs shared by the log and page storage:
+ * varints with zigzag for signed values, a zero-run codec that stores runs
+ * of zero bytes as counts, an XOR delta that encodes a new image against an
+ * old one (whatever didn't change becomes a zero run), and LZ4 block
+ * compression when built with SCUDB_HAVE_LZ4 (link with -llz4).
+ *
+ * Encoders write at most cap bytes and return the number written, or 0 if
+ * the output would not fit; decoders return false on malformed input.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace scudb {
+
+// unsigned LEB128, at most 10 bytes
+size_t PutVarint(char *dst, size_t cap, uint64_t value);
+// returns the number of bytes read, 0 if truncated
+size_t GetVarint(const char *src, size_t len, uint64_t &value);
+
+inline uint64_t ZigZag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+inline int64_t UnZigZag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// (varint zero run, varint literal length, literal bytes) pairs
+size_t ZeroRunEncode(const char *src, size_t len, char *dst, size_t cap);
+// dst_len is the exact decoded length
+bool ZeroRunDecode(const char *src, size_t len, char *dst, size_t dst_len);
+
+// zero-run encoding of target XOR base; base bytes past base_len read as 0
+size_t XorDeltaEncode(const char *base, size_t base_len, const char *target,
+                      size_t target_len, char *dst, size_t cap);
+bool XorDeltaDecode(const char *base, size_t base_len, const char *src,
+                    size_t len, char *target, size_t target_len);
+
+// whether LZ4 support was compiled in
+bool Lz4Available();
+// 0 when LZ4 is unavailable or the result would not fit in cap
+size_t Lz4Compress(const char *src, size_t len, char *dst, size_t cap);
+bool Lz4Decompress(const char *src, size_t len, char *dst, size_t dst_len);
+
+} // namespace scudb
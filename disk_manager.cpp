@@ -0,0 +1,997 @@
+/**
+ * disk_manager.cpp
+ */
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "common/checksum.h"
+#include "common/logger.h"
+#include "disk/disk_manager.h"
+
+namespace scudb {
+
+const size_t DiskManager::GROWTH_BYTES;
+const size_t DiskManager::TRAILER_SIZE;
+const size_t DiskManager::TRAILERS_PER_PAGE;
+
+// 空间映射页在校验尾部记录的id,与数据页的id不会重合
+static inline int32_t MapPageId(size_t map_no) {
+  return -1 - static_cast<int32_t>(map_no);
+}
+
+static inline uint64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// fdatasync, retried when interrupted
+static bool SyncFd(int fd) {
+  int rc;
+  do {
+    rc = fdatasync(fd);
+  } while (rc < 0 && errno == EINTR);
+  return rc == 0;
+}
+
+/*
+ * pread/pwrite until the whole range is transferred. Returns the number of
+ * bytes read (short only at end of file) / whether everything was written
+ */
+static ssize_t ReadFull(int fd, char *data, size_t size, off_t offset) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = pread(fd, data + done, size - done, offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return -1;
+    if (n == 0)
+      break;
+    done += n;
+  }
+  return done;
+}
+
+static bool WriteFull(int fd, const char *data, size_t size, off_t offset) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = pwrite(fd, data + done, size - done, offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    done += n;
+  }
+  return true;
+}
+
+/**
+ * Constructor: open/create a single database file & log file
+ * @input db_file: database file name
+ */
+DiskManager::DiskManager(const std::string &db_file)
+    : DiskManager(db_file, std::vector<std::string>()) {}
+
+/**
+ * Constructor: open/create the stripe files of a database & its log file.
+ * Without stripe_dirs the database is the single file db_file
+ */
+DiskManager::DiskManager(const std::string &db_file,
+                         const std::vector<std::string> &stripe_dirs,
+                         size_t stripe_pages, size_t queue_depth)
+    : log_fd_(-1), file_name_(db_file),
+      stripe_pages_(stripe_pages == 0 ? 1 : stripe_pages),
+      queue_depth_(queue_depth == 0 ? 1 : queue_depth), stamped_(0),
+      verified_(0), failures_(0), stamp_ns_(0), verify_ns_(0),
+      compress_pages_(false), fast_fd_(-1), fast_map_fd_(-1), fast_writes_(0),
+      fast_synced_(0), migrator_(nullptr), migrator_running_(false),
+      write_mark_(0), syncing_(false), durable_mark_(0), num_flushes_(0),
+      flush_log_(false), flush_log_f_(nullptr) {
+  // 只在最后一个'/'之后找扩展名,目录名中的'.'不算;没有扩展名时在整个文件名后加上.log
+  std::string::size_type n = file_name_.find('.', file_name_.rfind('/') + 1);
+  log_name_ = file_name_.substr(0, n) + ".log";
+
+  log_fd_ = open(log_name_.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (log_fd_ < 0)
+    LOG_DEBUG("can't open log file");
+
+  std::vector<std::string> paths;
+  if (stripe_dirs.empty()) {
+    paths.push_back(file_name_);
+  } else {
+    std::string base = file_name_.substr(file_name_.rfind('/') + 1);
+    for (size_t i = 0; i < stripe_dirs.size(); i++)
+      paths.push_back(stripe_dirs[i] + "/" + base + "." + std::to_string(i));
+  }
+  for (auto &path : paths) {
+    std::unique_ptr<StripeFile> file(new StripeFile);
+    file->path = path;
+    file->fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (file->fd < 0)
+      LOG_DEBUG("can't open db file");
+    long long size = GetFileSize(file->fd);
+    file->pages = size < 0 ? 0 : FileSlots(size);
+    files_.push_back(std::move(file));
+  }
+  LoadSpaceMap();
+  compressed_path_ = file_name_ + ".cpg";
+  if (access(compressed_path_.c_str(), F_OK) == 0)
+    compressed_.reset(new CompressedPageStore(compressed_path_));
+}
+
+/*
+ * Constructor for subclasses that bring their own storage: no file is
+ * opened, and the single pseudo stripe file only names the storage and
+ * carries its I/O queue
+ */
+DiskManager::DiskManager(const std::string &name, size_t queue_depth)
+    : log_fd_(-1), file_name_(name), stripe_pages_(SpaceMap::PAGES_PER_EXTENT),
+      queue_depth_(queue_depth == 0 ? 1 : queue_depth), stamped_(0),
+      verified_(0), failures_(0), stamp_ns_(0), verify_ns_(0),
+      compress_pages_(false), fast_fd_(-1), fast_map_fd_(-1), fast_writes_(0),
+      fast_synced_(0), migrator_(nullptr), migrator_running_(false),
+      write_mark_(0), syncing_(false), durable_mark_(0), num_flushes_(0),
+      flush_log_(false), flush_log_f_(nullptr) {
+  std::unique_ptr<StripeFile> file(new StripeFile);
+  file->path = name;
+  files_.push_back(std::move(file));
+}
+
+DiskManager::~DiskManager() {
+  StopMigration();
+  StopWorkers();
+  // 关闭前把所有写过的文件各同步一次
+  if (!SyncUpTo(write_mark_.load()))
+    LOG_DEBUG("I/O error while syncing db file");
+  for (auto &file : files_)
+    if (file->fd >= 0)
+      close(file->fd);
+  if (fast_fd_ >= 0)
+    close(fast_fd_);
+  if (fast_map_fd_ >= 0)
+    close(fast_map_fd_);
+  if (log_fd_ >= 0)
+    close(log_fd_);
+}
+
+/*
+ * Stop and join the I/O workers. Safe to call more than once
+ */
+void DiskManager::StopWorkers() {
+  for (auto &file : files_) {
+    {
+      std::lock_guard<std::mutex> lock(file->latch);
+      file->stop = true;
+    }
+    file->not_empty.notify_all();
+    for (auto &worker : file->workers)
+      worker.join();
+    file->workers.clear();
+  }
+}
+
+/*
+ * Rebuild the allocation state from every space map page in the files
+ */
+void DiskManager::LoadSpaceMap() {
+  char data[PAGE_SIZE];
+  for (size_t map_no = 0;; map_no++) {
+    int64_t local;
+    StripeFile &file = Locate(SpaceMap::MapSlot(map_no), local);
+    if (local >= file.pages)
+      break;
+    // 校验失败时仍尽量使用读到的内容,清空它会把已分配的页当成空闲
+    if (!ReadSlot(SpaceMap::MapSlot(map_no), MapPageId(map_no), data))
+      LOG_DEBUG("space map page fails verification");
+    space_map_.Load(map_no, data);
+  }
+}
+
+void DiskManager::WriteSpaceMap(size_t map_no) {
+  char data[PAGE_SIZE];
+  space_map_.Store(map_no, data);
+  if (!WriteSlot(SpaceMap::MapSlot(map_no), MapPageId(map_no), data))
+    LOG_DEBUG("I/O error while writing space map");
+}
+
+/*
+ * The checksum covers the page and the id it is written for, so a page
+ * written to the wrong slot doesn't verify either
+ */
+void DiskManager::StampSlot(int32_t id, const char *data, char *trailer) {
+  uint64_t start = NowNs();
+  uint32_t crc = Crc32c(data, PAGE_SIZE);
+  crc = Crc32c(&id, sizeof(id), crc);
+  memcpy(trailer, &crc, sizeof(crc));
+  memcpy(trailer + sizeof(crc), &id, sizeof(id));
+  stamp_ns_ += NowNs() - start;
+  stamped_++;
+}
+
+bool DiskManager::VerifySlot(int32_t id, const char *data, const char *trailer) {
+  uint64_t start = NowNs();
+  uint32_t crc = Crc32c(data, PAGE_SIZE);
+  crc = Crc32c(&id, sizeof(id), crc);
+  bool ok = memcmp(trailer, &crc, sizeof(crc)) == 0 &&
+            memcmp(trailer + sizeof(crc), &id, sizeof(id)) == 0;
+  if (!ok) {
+    // 从未写过的slot(预分配或空洞)全为0
+    static const char zeros[PAGE_SIZE] = {};
+    ok = memcmp(data, zeros, PAGE_SIZE) == 0 &&
+         memcmp(trailer, zeros, TRAILER_SIZE) == 0;
+  }
+  verify_ns_ += NowNs() - start;
+  verified_++;
+  if (!ok)
+    failures_++;
+  return ok;
+}
+
+bool DiskManager::WriteSlot(int64_t slot, int32_t id, const char *data) {
+  char trailer[TRAILER_SIZE];
+  StampSlot(id, data, trailer);
+  int64_t local;
+  StripeFile &file = Locate(slot, local);
+  if (!WriteRaw(slot, data, trailer))
+    return false;
+  // 先计入文件再推进写标记,同步时看到的标记一定被文件计数覆盖
+  file.writes++;
+  write_mark_++;
+  return true;
+}
+
+/*
+ * Read slot into data and verify it. Past the end of the file the slot
+ * reads as zeros
+ */
+bool DiskManager::ReadSlot(int64_t slot, int32_t id, char *data) {
+  char trailer[TRAILER_SIZE];
+  int64_t local;
+  Locate(slot, local).reads++;
+  if (!ReadRaw(slot, data, trailer)) {
+    LOG_DEBUG("I/O error while reading");
+    return false;
+  }
+  return VerifySlot(id, data, trailer);
+}
+
+/*
+ * Write the page, then its trailer into the checksum page. A crash in
+ * between leaves a page that fails verification, like a torn write;
+ * LogRecovery::Redo rebuilds such a page from the log
+ */
+bool DiskManager::WriteRaw(int64_t slot, const char *data, const char *trailer) {
+  int64_t local;
+  int fd = Locate(slot, local).fd;
+  return WriteFull(fd, data, PAGE_SIZE, PageOffset(local)) &&
+         WriteFull(fd, trailer, TRAILER_SIZE, TrailerOffset(local));
+}
+
+bool DiskManager::ReadRaw(int64_t slot, char *data, char *trailer) {
+  int64_t local;
+  int fd = Locate(slot, local).fd;
+  ssize_t read_count = ReadFull(fd, data, PAGE_SIZE, PageOffset(local));
+  if (read_count < 0)
+    return false;
+  // 普通文件只会在文件末尾读不满
+  memset(data + read_count, 0, PAGE_SIZE - read_count);
+  read_count = ReadFull(fd, trailer, TRAILER_SIZE, TrailerOffset(local));
+  if (read_count < 0)
+    return false;
+  memset(trailer + read_count, 0, TRAILER_SIZE - read_count);
+  return true;
+}
+
+/*
+ * Make sure the stripe file holding slot covers it, growing the file by
+ * whole GROWTH_BYTES chunks
+ */
+void DiskManager::EnsureFileSize(int64_t slot) {
+  int64_t local;
+  StripeFile &file = Locate(slot, local);
+  if (local < file.pages)
+    return;
+  off_t new_size = (FileBytes(local + 1) + GROWTH_BYTES - 1) / GROWTH_BYTES *
+                   GROWTH_BYTES;
+  if (!GrowRaw(slot, FileSlots(new_size))) {
+    LOG_DEBUG("can't grow db file");
+    return;
+  }
+  file.pages = FileSlots(new_size);
+}
+
+/*
+ * fallocate reserves real blocks so the new extents are contiguous on disk;
+ * where it isn't supported the file is extended sparsely
+ */
+bool DiskManager::GrowRaw(int64_t slot, int64_t pages) {
+  int64_t local;
+  StripeFile &file = Locate(slot, local);
+  off_t old_size = FileBytes(file.pages);
+  off_t new_size = FileBytes(pages);
+#ifdef __linux__
+  if (fallocate(file.fd, 0, old_size, new_size - old_size) == 0)
+    return true;
+#endif
+  return ftruncate(file.fd, new_size) == 0;
+}
+
+uint64_t DiskManager::WriteMark() const { return write_mark_.load(); }
+
+/*
+ * Group sync: whoever finds no sync running becomes the leader, takes the
+ * current write mark and syncs every file with writes the last sync didn't
+ * cover. Requests arriving meanwhile wait and are usually covered by that
+ * sync; only those with a newer mark start the next one. The mark is read
+ * before the per-file counts, so every write it counts is synced. The
+ * compressed page map changes are taken in between: a page leaves the store
+ * only after its home slot write is counted, so that write is synced before
+ * the map entry is written
+ */
+bool DiskManager::SyncUpTo(uint64_t mark) {
+  std::unique_lock<std::mutex> lock(sync_latch_);
+  sync_stats_.requests++;
+  while (durable_mark_ < mark) {
+    if (syncing_) {
+      sync_done_.wait(lock);
+      continue;
+    }
+    syncing_ = true;
+    uint64_t target = write_mark_.load();
+    CompressedPageStore::MapChanges map_changes;
+    if (compressed_ != nullptr)
+      map_changes = compressed_->TakeChanges();
+    uint64_t fast_writes = fast_writes_.load();
+    std::vector<std::pair<size_t, uint64_t>> dirty;
+    for (size_t i = 0; i < files_.size(); i++) {
+      uint64_t writes = files_[i]->writes.load();
+      if (writes != files_[i]->synced)
+        dirty.emplace_back(i, writes);
+    }
+    lock.unlock();
+    uint64_t start = NowNs();
+    bool ok = true;
+    for (auto &entry : dirty)
+      ok = SyncFile(entry.first, true) && ok;
+    if (compressed_ != nullptr)
+      ok = compressed_->Sync(map_changes) && ok;
+    if (tier_ != nullptr) {
+      std::vector<size_t> released;
+      {
+        std::lock_guard<std::mutex> tier_lock(tier_latch_);
+        released = tier_->TakePending();
+      }
+      if (fast_writes != fast_synced_)
+        ok = SyncFd(fast_fd_) && SyncFd(fast_map_fd_) && ok;
+      std::lock_guard<std::mutex> tier_lock(tier_latch_);
+      tier_->Release(released, ok);
+    }
+    lock.lock();
+    if (ok)
+      fast_synced_ = fast_writes;
+    syncing_ = false;
+    sync_stats_.syncs++;
+    sync_stats_.file_syncs += dirty.size();
+    sync_stats_.sync_ns += NowNs() - start;
+    if (ok) {
+      for (auto &entry : dirty)
+        files_[entry.first]->synced = entry.second;
+      durable_mark_ = std::max(durable_mark_, target);
+    }
+    sync_done_.notify_all();
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+void DiskManager::StartWriteback() {
+  std::vector<size_t> dirty;
+  {
+    std::lock_guard<std::mutex> lock(sync_latch_);
+    for (size_t i = 0; i < files_.size(); i++) {
+      StripeFile &file = *files_[i];
+      uint64_t writes = file.writes.load();
+      if (writes != file.synced && writes != file.written_back) {
+        file.written_back = writes;
+        dirty.push_back(i);
+      }
+    }
+    sync_stats_.writebacks += dirty.size();
+  }
+  for (size_t i : dirty)
+    SyncFile(i, false);
+}
+
+/*
+ * fdatasync also covers the file size grown by GrowRaw, which reading the
+ * data back needs. sync_file_range only queues the dirty pages for writeback
+ */
+bool DiskManager::SyncFile(size_t file, bool wait) {
+  int fd = files_[file]->fd;
+  if (fd < 0)
+    return true;
+  if (!wait) {
+#ifdef __linux__
+    return sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE) == 0;
+#else
+    return true;
+#endif
+  }
+  return SyncFd(fd);
+}
+
+/**
+ * Write the contents of the specified page, stamped with its checksum, into
+ * disk file. Returns false on I/O error
+ */
+bool DiskManager::WritePage(page_id_t page_id, const char *page_data) {
+  if (StorePage(page_id, page_data))
+    return true;
+  LOG_DEBUG("I/O error while writing page %d", page_id);
+  return false;
+}
+
+/**
+ * Read the contents of the specified page into the given memory area and
+ * verify its checksum
+ */
+bool DiskManager::ReadPage(page_id_t page_id, char *page_data) {
+  if (LoadPage(page_id, page_data))
+    return true;
+  LOG_DEBUG("page %d fails checksum verification", page_id);
+  return false;
+}
+
+/*
+ * A page that doesn't compress enough goes to its home slot, and only then
+ * leaves the store. The store writes that map change only after a sync
+ * covered the home slot write, so until then a crash finds the older
+ * compressed image
+ */
+bool DiskManager::StorePage(page_id_t page_id, const char *data) {
+  if (compressed_ != nullptr && compress_pages_ &&
+      compressed_->Write(page_id, data)) {
+    write_mark_++;
+    return true;
+  }
+  bool ok = tier_ != nullptr
+                ? WriteTiered(page_id, data)
+                : WriteSlot(SpaceMap::PageSlot(page_id), page_id, data);
+  if (!ok)
+    return false;
+  // 页面映射的改动也要被之后取得的写标记覆盖
+  if (compressed_ != nullptr && compressed_->Remove(page_id))
+    write_mark_++;
+  return true;
+}
+
+bool DiskManager::LoadPage(page_id_t page_id, char *data) {
+  if (compressed_ != nullptr) {
+    bool mapped;
+    bool ok = compressed_->Read(page_id, data, mapped);
+    if (mapped) {
+      verified_++;
+      if (!ok)
+        failures_++;
+      return ok;
+    }
+  }
+  if (tier_ != nullptr)
+    return ReadTiered(page_id, data);
+  return ReadSlot(SpaceMap::PageSlot(page_id), page_id, data);
+}
+
+bool DiskManager::SetPageCompression(bool enable) {
+  if (enable && compressed_ == nullptr) {
+    if (compressed_path_.empty())
+      return false;
+    compressed_.reset(new CompressedPageStore(compressed_path_));
+  }
+  if (enable && !compressed_->IsOpen())
+    return false;
+  compress_pages_ = enable;
+  return true;
+}
+
+CompressionStats DiskManager::GetCompressionStats() {
+  if (compressed_ == nullptr)
+    return CompressionStats();
+  return compressed_->GetStats();
+}
+
+/*
+ * Map entries hold page id + 1, so the zeros of a new map file read as free
+ * slots. A map holding more entries than fast_pages keeps them all: those
+ * slots may hold the newest image of their pages
+ */
+bool DiskManager::SetFastTier(const std::string &fast_dir, size_t fast_pages) {
+  // 子类没有文件,不支持分层
+  if (tier_ != nullptr || compressed_path_.empty() || fast_pages == 0)
+    return false;
+  std::string path =
+      fast_dir + "/" + file_name_.substr(file_name_.rfind('/') + 1) + ".fast";
+  int fast_fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  int map_fd = open((path + ".map").c_str(), O_RDWR | O_CREAT, 0644);
+  // 失败时关闭已打开的文件,成功后才交给fast_fd_/fast_map_fd_
+  auto fail = [&](const char *what) {
+    LOG_DEBUG("%s", what);
+    if (fast_fd >= 0)
+      close(fast_fd);
+    if (map_fd >= 0)
+      close(map_fd);
+    return false;
+  };
+  if (fast_fd < 0 || map_fd < 0)
+    return fail("can't open fast tier");
+  long long map_size = GetFileSize(map_fd);
+  size_t loaded = map_size < 0 ? 0 : map_size / sizeof(int32_t);
+  std::vector<int32_t> entries(loaded);
+  if (loaded > 0 &&
+      ReadFull(map_fd, reinterpret_cast<char *>(entries.data()),
+               loaded * sizeof(int32_t), 0) < 0)
+    return fail("can't read fast tier map");
+  fast_pages = std::max(fast_pages, loaded);
+  std::unique_ptr<TierMap> tier(new TierMap(fast_pages));
+  for (size_t slot = 0; slot < loaded; slot++)
+    tier->Load(slot, entries[slot] - 1);
+  off_t fast_size = FileBytes(fast_pages);
+  if (GetFileSize(fast_fd) < fast_size) {
+#ifdef __linux__
+    if (fallocate(fast_fd, 0, 0, fast_size) != 0)
+#endif
+      if (ftruncate(fast_fd, fast_size) != 0)
+        return fail("can't size fast tier");
+  }
+  fast_fd_ = fast_fd;
+  fast_map_fd_ = map_fd;
+  tier_stats_.fast_slots = fast_pages;
+  tier_ = std::move(tier);
+  return true;
+}
+
+bool DiskManager::WriteTiered(page_id_t page_id, const char *data) {
+  tier_io_latch_.RLock();
+  int64_t slot;
+  {
+    std::lock_guard<std::mutex> lock(tier_latch_);
+    tier_->RecordAccess(page_id);
+    tier_->NoteWrite(page_id);
+    slot = tier_->FastSlot(page_id);
+    if (slot >= 0)
+      tier_stats_.fast_writes++;
+    else
+      tier_stats_.slow_writes++;
+  }
+  bool ok = slot >= 0 ? WriteFast(slot, page_id, data)
+                      : WriteSlot(SpaceMap::PageSlot(page_id), page_id, data);
+  tier_io_latch_.RUnlock();
+  return ok;
+}
+
+bool DiskManager::ReadTiered(page_id_t page_id, char *data) {
+  tier_io_latch_.RLock();
+  int64_t slot;
+  {
+    std::lock_guard<std::mutex> lock(tier_latch_);
+    tier_->RecordAccess(page_id);
+    slot = tier_->FastSlot(page_id);
+    if (slot >= 0)
+      tier_stats_.fast_reads++;
+    else
+      tier_stats_.slow_reads++;
+  }
+  bool ok = slot >= 0 ? ReadFast(slot, page_id, data)
+                      : ReadSlot(SpaceMap::PageSlot(page_id), page_id, data);
+  tier_io_latch_.RUnlock();
+  return ok;
+}
+
+/*
+ * The fast file has the same layout of slots and checksum pages as a
+ * stripe file
+ */
+bool DiskManager::WriteFast(size_t slot, page_id_t page_id, const char *data) {
+  char trailer[TRAILER_SIZE];
+  StampSlot(page_id, data, trailer);
+  if (!WriteFull(fast_fd_, data, PAGE_SIZE, PageOffset(slot)) ||
+      !WriteFull(fast_fd_, trailer, TRAILER_SIZE, TrailerOffset(slot)))
+    return false;
+  fast_writes_++;
+  write_mark_++;
+  return true;
+}
+
+bool DiskManager::ReadFast(size_t slot, page_id_t page_id, char *data) {
+  char trailer[TRAILER_SIZE];
+  if (ReadFull(fast_fd_, data, PAGE_SIZE, PageOffset(slot)) !=
+          static_cast<ssize_t>(PAGE_SIZE) ||
+      ReadFull(fast_fd_, trailer, TRAILER_SIZE, TrailerOffset(slot)) !=
+          static_cast<ssize_t>(TRAILER_SIZE))
+    return false;
+  return VerifySlot(page_id, data, trailer);
+}
+
+/*
+ * Called under tier_latch_, so a sync that releases the slot freed by this
+ * entry change (TakePending) always covers the write
+ */
+bool DiskManager::WriteTierEntry(size_t slot, page_id_t page_id) {
+  int32_t entry = page_id + 1;
+  if (!WriteFull(fast_map_fd_, reinterpret_cast<const char *>(&entry),
+                 sizeof(entry), slot * sizeof(entry)))
+    return false;
+  fast_writes_++;
+  write_mark_++;
+  return true;
+}
+
+/*
+ * Copy every planned page to its new location without holding any latch,
+ * sync the copies, then commit the moves one by one under tier_io_latch_,
+ * so no page I/O is between choosing a location and using it and no map
+ * entry points at a copy that isn't durable. Writes that began before the
+ * moves were planned aren't flagged by NoteWrite, so the copy waits for
+ * them first. A move whose map entry can't be written is reverted. Slots
+ * freed by demotions are reused once the map is synced, which the round
+ * does itself
+ */
+size_t DiskManager::MigratePages(size_t max_moves) {
+  if (tier_ == nullptr)
+    return 0;
+  std::vector<TierMove> moves;
+  {
+    std::lock_guard<std::mutex> lock(tier_latch_);
+    moves = tier_->PlanMoves(max_moves);
+  }
+  // 等待计划之前开始的页面I/O结束:它们的写不会被NoteWrite记到
+  tier_io_latch_.WLock();
+  tier_io_latch_.WUnlock();
+  std::vector<bool> copied(moves.size());
+  bool any_copied = false;
+  char data[PAGE_SIZE];
+  for (size_t i = 0; i < moves.size(); i++) {
+    TierMove &move = moves[i];
+    int64_t home = SpaceMap::PageSlot(move.page_id);
+    copied[i] =
+        move.promote ? ReadSlot(home, move.page_id, data) &&
+                           WriteFast(move.slot, move.page_id, data)
+                     : ReadFast(move.slot, move.page_id, data) &&
+                           WriteSlot(home, move.page_id, data);
+    any_copied = any_copied || copied[i];
+  }
+  // 副本落盘之后才能写映射项,否则崩溃后映射项可能指向未写完的副本
+  if (any_copied && !SyncUpTo(write_mark_.load())) {
+    LOG_DEBUG("I/O error while syncing migrated pages");
+    copied.assign(moves.size(), false);
+  }
+  size_t moved = 0;
+  bool demoted = false;
+  for (size_t i = 0; i < moves.size(); i++) {
+    TierMove &move = moves[i];
+    tier_io_latch_.WLock();
+    {
+      std::lock_guard<std::mutex> lock(tier_latch_);
+      bool committed = false;
+      if (!copied[i])
+        tier_->Abort(move);
+      else
+        committed = tier_->Commit(move);
+      if (committed &&
+          !WriteTierEntry(move.slot, move.promote ? move.page_id
+                                                  : INVALID_PAGE_ID)) {
+        LOG_DEBUG("I/O error while writing tier map");
+        tier_->Revert(move);
+        committed = false;
+      }
+      if (!committed)
+        tier_stats_.aborted_moves++;
+      else if (move.promote)
+        tier_stats_.promotions++;
+      else
+        tier_stats_.demotions++;
+      if (committed) {
+        moved++;
+        demoted = demoted || !move.promote;
+      }
+    }
+    tier_io_latch_.WUnlock();
+  }
+  {
+    std::lock_guard<std::mutex> lock(tier_latch_);
+    tier_->Decay();
+  }
+  if (demoted && !SyncUpTo(write_mark_.load()))
+    LOG_DEBUG("I/O error while syncing tier map");
+  return moved;
+}
+
+void DiskManager::StartMigration(std::chrono::milliseconds interval,
+                                 size_t max_moves) {
+  StopMigration();
+  migrator_running_ = true;
+  migrator_ = new std::thread([this, interval, max_moves] {
+    std::unique_lock<std::mutex> lock(migrator_latch_);
+    while (!migrator_cv_.wait_for(lock, interval,
+                                  [this] { return !migrator_running_; })) {
+      lock.unlock();
+      MigratePages(max_moves);
+      lock.lock();
+    }
+  });
+}
+
+void DiskManager::StopMigration() {
+  if (migrator_ == nullptr)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(migrator_latch_);
+    migrator_running_ = false;
+  }
+  migrator_cv_.notify_all();
+  migrator_->join();
+  delete migrator_;
+  migrator_ = nullptr;
+}
+
+TierStats DiskManager::GetTierStats() {
+  std::lock_guard<std::mutex> lock(tier_latch_);
+  TierStats stats = tier_stats_;
+  if (tier_ != nullptr)
+    stats.fast_pages = tier_->NumFastPages();
+  return stats;
+}
+
+void DiskManager::ReadPages(std::vector<PageIO> &batch) {
+  SubmitBatch(batch, false);
+}
+
+void DiskManager::WritePages(std::vector<PageIO> &batch) {
+  SubmitBatch(batch, true);
+}
+
+/*
+ * Queue every page of batch on its stripe file's I/O queue and wait for
+ * all of them. The workers are started on first use, so a DiskManager that
+ * only does single-page I/O never creates them
+ */
+void DiskManager::SubmitBatch(std::vector<PageIO> &batch, bool write) {
+  if (batch.empty())
+    return;
+  std::call_once(workers_started_, [this] {
+    for (auto &file : files_)
+      for (size_t i = 0; i < queue_depth_; i++)
+        file->workers.emplace_back(&DiskManager::RunIoWorker, this,
+                                   std::ref(*file));
+  });
+  IoBatch io_batch;
+  io_batch.pending = batch.size();
+  for (auto &io : batch) {
+    int64_t local;
+    StripeFile &file = Locate(SpaceMap::PageSlot(io.page_id), local);
+    {
+      std::lock_guard<std::mutex> lock(file.latch);
+      file.queue.push_back({write, &io, &io_batch});
+      file.queued++;
+      file.max_queue = std::max(file.max_queue, file.queue.size());
+    }
+    file.not_empty.notify_one();
+  }
+  std::unique_lock<std::mutex> lock(io_batch.latch);
+  io_batch.done.wait(lock, [&] { return io_batch.pending == 0; });
+}
+
+void DiskManager::RunIoWorker(StripeFile &file) {
+  std::unique_lock<std::mutex> lock(file.latch);
+  for (;;) {
+    file.not_empty.wait(lock, [&] { return !file.queue.empty() || file.stop; });
+    if (file.queue.empty())
+      return;
+    IoRequest request = file.queue.front();
+    file.queue.pop_front();
+    lock.unlock();
+    PageIO &io = *request.io;
+    if (request.write)
+      io.ok = StorePage(io.page_id, io.data);
+    else
+      io.ok = LoadPage(io.page_id, io.data);
+    {
+      // 持锁通知:等待者返回后io_batch即被销毁
+      std::lock_guard<std::mutex> batch_lock(request.batch->latch);
+      if (--request.batch->pending == 0)
+        request.batch->done.notify_all();
+    }
+    lock.lock();
+  }
+}
+
+/**
+ * Write the contents of the log into disk file
+ * Only return when sync is done, and only perform sequence write
+ */
+void DiskManager::WriteLog(char *log_data, int size) {
+  if (size == 0) // no effect on num_flushes_ if log buffer is empty
+    return;
+
+  flush_log_ = true;
+
+  if (flush_log_f_ != nullptr)
+    // used for checking non-blocking flushing
+    assert(flush_log_f_->wait_for(std::chrono::seconds(10)) ==
+           std::future_status::ready);
+
+  num_flushes_ += 1;
+  if (!AppendLog(log_data, size))
+    LOG_DEBUG("I/O error while writing log");
+  flush_log_ = false;
+}
+
+/*
+ * Sequential write at the end of the log, which is opened with O_APPEND.
+ * Returns once the data is durable: the caller publishes the persistent LSN
+ * right after
+ */
+bool DiskManager::AppendLog(const char *log_data, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = write(log_fd_, log_data + done, size - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    done += n;
+  }
+  return SyncFd(log_fd_);
+}
+
+/**
+ * Read the contents of the log into the given memory area
+ * Always read from the beginning and perform sequence read
+ * @return: false means already reach the end
+ */
+bool DiskManager::ReadLog(char *log_data, int size, int offset) {
+  if (offset >= LogSize())
+    return false;
+  ssize_t read_count = ReadLogAt(log_data, size, offset);
+  if (read_count < 0)
+    return false;
+  // if log file ends before reading "size"
+  if (read_count < size)
+    memset(log_data + read_count, 0, size - read_count);
+  return true;
+}
+
+int64_t DiskManager::LogSize() { return GetFileSize(log_fd_); }
+
+ssize_t DiskManager::ReadLogAt(char *log_data, size_t size, off_t offset) {
+  return ReadFull(log_fd_, log_data, size, offset);
+}
+
+/**
+ * Allocate new page (operations like create index/table) from the extents
+ * of group. The space map page is written through, so the page stays
+ * allocated across restarts before anything is stored in it
+ */
+page_id_t DiskManager::AllocatePage(int32_t group) {
+  return AllocatePages(group, 1);
+}
+
+/*
+ * count consecutive pages of one extent, the first at a multiple of count
+ * (a large page of a buffer pool size class). INVALID_PAGE_ID unless count
+ * divides SpaceMap::PAGES_PER_EXTENT
+ */
+page_id_t DiskManager::AllocatePages(int32_t group, size_t count) {
+  if (count == 0 || SpaceMap::PAGES_PER_EXTENT % count != 0)
+    return INVALID_PAGE_ID;
+  std::lock_guard<std::mutex> lock(alloc_latch_);
+  size_t map_no;
+  page_id_t page_id = space_map_.AllocateRun(group, count, map_no);
+  for (size_t i = 0; i < count; i++)
+    EnsureFileSize(SpaceMap::PageSlot(page_id + i));
+  WriteSpaceMap(map_no);
+  return page_id;
+}
+
+/**
+ * Deallocate page (operations like drop index/table). The page can be handed
+ * out again by AllocatePage
+ */
+void DiskManager::DeallocatePage(page_id_t page_id) {
+  std::lock_guard<std::mutex> lock(alloc_latch_);
+  size_t map_no;
+  if (!space_map_.Free(page_id, map_no)) {
+    LOG_DEBUG("deallocating a free page");
+    return;
+  }
+  WriteSpaceMap(map_no);
+  if (compressed_ != nullptr && compressed_->Remove(page_id))
+    write_mark_++;
+  if (tier_ != nullptr) {
+    std::lock_guard<std::mutex> tier_lock(tier_latch_);
+    int64_t slot = tier_->Drop(page_id);
+    if (slot >= 0 && !WriteTierEntry(slot, INVALID_PAGE_ID))
+      LOG_DEBUG("I/O error while writing tier map");
+  }
+}
+
+bool DiskManager::IsAllocated(page_id_t page_id) {
+  std::lock_guard<std::mutex> lock(alloc_latch_);
+  return space_map_.IsAllocated(page_id);
+}
+
+SpaceStats DiskManager::GetSpaceStats() {
+  std::lock_guard<std::mutex> lock(alloc_latch_);
+  SpaceStats stats = space_map_.GetStats();
+  for (auto &file : files_)
+    stats.file_pages += file->pages;
+  return stats;
+}
+
+ChecksumStats DiskManager::GetChecksumStats() const {
+  ChecksumStats stats;
+  stats.stamped = stamped_.load();
+  stats.verified = verified_.load();
+  stats.failures = failures_.load();
+  stats.stamp_ns = stamp_ns_.load();
+  stats.verify_ns = verify_ns_.load();
+  return stats;
+}
+
+std::vector<StripeStats> DiskManager::GetStripeStats() {
+  std::vector<StripeStats> stats;
+  for (auto &file : files_) {
+    StripeStats entry;
+    entry.path = file->path;
+    entry.reads = file->reads.load();
+    entry.writes = file->writes.load();
+    {
+      std::lock_guard<std::mutex> lock(file->latch);
+      entry.queued = file->queued;
+      entry.max_queue = file->max_queue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(alloc_latch_);
+      entry.file_pages = file->pages;
+    }
+    stats.push_back(entry);
+  }
+  return stats;
+}
+
+SyncStats DiskManager::GetSyncStats() {
+  std::lock_guard<std::mutex> lock(sync_latch_);
+  return sync_stats_;
+}
+
+int DiskManager::GetNumFlushes() const { return num_flushes_; }
+bool DiskManager::GetFlushState() const { return flush_log_.load(); }
+
+long long DiskManager::GetFileSize(int fd) {
+  struct stat stat_buf;
+  int rc = fstat(fd, &stat_buf);
+  return rc == 0 ? static_cast<long long>(stat_buf.st_size) : -1;
+}
+
+off_t DiskManager::FileBytes(int64_t slots) {
+  int64_t groups = (slots + TRAILERS_PER_PAGE - 1) / TRAILERS_PER_PAGE;
+  return (slots + groups) * static_cast<off_t>(PAGE_SIZE);
+}
+
+//只有校验页而没有数据页的尾部不算slot
+int64_t DiskManager::FileSlots(off_t size) {
+  int64_t pages = size / static_cast<off_t>(PAGE_SIZE);
+  int64_t groups = pages / (TRAILERS_PER_PAGE + 1);
+  int64_t rest = pages % (TRAILERS_PER_PAGE + 1);
+  return groups * TRAILERS_PER_PAGE + (rest > 0 ? rest - 1 : 0);
+}
+
+} // namespace scudb
@@ -0,0 +1,351 @@
+/**
+ * disk_manager.h
+ *
+ * Disk manager takes care of the allocation and deallocation of pages within a
+ * database. It also performs read and write of pages to and from disk, and
+ * provides a logical file layer within the context of a database management
+ * system.
+ *
+ * Page allocation goes through a free-space bitmap and extent allocator (see
+ * space_map.h): AllocatePage takes an allocation group so that one object's
+ * pages come from the same extents, and DeallocatePage makes a page
+ * reusable. The database file grows by preallocating GROWTH_BYTES at a time
+ * with fallocate.
+ *
+ * Every page is stored in a PAGE_SIZE slot at a PAGE_SIZE aligned offset,
+ * and has a trailer holding the CRC32C (see checksum.h) of the page and its
+ * page id. The trailers of TRAILERS_PER_PAGE consecutive slots are packed
+ * into a checksum page in front of them:
+ *   | checksum page | slot 0 | ... | slot T-1 | checksum page | slot T | ...
+ * so page I/O stays aligned (as O_DIRECT would need) at the cost of one
+ * page in TRAILERS_PER_PAGE + 1. WritePage stamps the trailer, so every
+ * write-back of the buffer pool is covered; ReadPage verifies it and returns
+ * false for a torn, corrupted or misdirected page. A slot that was never
+ * written (all zero) is accepted.
+ *
+ * The page slots can be striped RAID-0 style over several files, one per
+ * directory (and so per device): stripe unit i of stripe_pages consecutive
+ * slots goes to file i % N. Every file has its own I/O queue served by
+ * queue_depth worker threads; ReadPages/WritePages spread a batch over the
+ * queues so the devices work in parallel. Single-page ReadPage/WritePage
+ * run on the calling thread, so concurrent callers reach all devices too.
+ * Page ids are unaffected. A striped database must be reopened with the
+ * same directories and stripe unit.
+ *
+ * Pages can also be stored compressed (SetPageCompression, see
+ * compressed_page_store.h): a page that compresses well is written into a
+ * variable-size slot of a side file named db_file.cpg, with an on-disk page
+ * map; an incompressible page is written to its home slot as usual. ReadPage
+ * decompresses into the caller's buffer, so the buffer pool sees no
+ * difference. A database that has compressed pages is reopened with its
+ * store whether compression is enabled or not.
+ *
+ * With a fast tier (SetFastTier), hot pages are kept in a smaller file on a
+ * faster device: a page-location map (see tier_map.h) sends each page's I/O
+ * to its fast slot or its home slot. Reads and write-backs, i.e. the buffer
+ * pool's misses and flushes, count as accesses; a migration round
+ * (MigratePages, or periodically StartMigration) promotes the hottest home
+ * pages and demotes cold fast ones. A page is copied first and stays
+ * readable and writable at its old location until the move commits; a
+ * write during the copy cancels the move.
+ *
+ * Writes are not synced one by one. Every completed page write advances a
+ * write mark; a caller that needs its writes durable takes WriteMark() and
+ * calls SyncUpTo(mark). Concurrent requests are merged: one caller syncs
+ * every file written since the last sync, with one fdatasync each, on behalf
+ * of all requests it covers, and the others just wait for it. Streams of
+ * writes that will be synced later (the background writer before a
+ * checkpoint) call StartWriteback, which kicks off writeback of those files
+ * with sync_file_range, so the final fdatasync finds little left to do.
+ *
+ * Pages and the log are accessed with pread/pwrite, so concurrent page I/O
+ * (e.g. the background writer next to a foreground miss) is safe. All file
+ * access goes through a few protected virtual hooks (ReadRaw, WriteRaw,
+ * GrowRaw and the log ones); MemoryDiskManager overrides them to keep
+ * everything in memory behind an emulated device.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+#include "common/config.h"
+#include "common/rwmutex.h"
+#include "disk/compressed_page_store.h"
+#include "disk/space_map.h"
+#include "disk/tier_map.h"
+
+namespace scudb {
+
+struct ChecksumStats {
+  size_t stamped = 0;   // pages written with a checksum
+  size_t verified = 0;  // pages read and checked
+  size_t failures = 0;  // pages whose checksum didn't match
+  double stamp_ns = 0;  // total time spent checksumming written pages
+  double verify_ns = 0; // total time spent verifying read pages
+};
+
+struct StripeStats {
+  std::string path;
+  size_t reads = 0;
+  size_t writes = 0;
+  size_t queued = 0;     // requests served through the file's I/O queue
+  size_t max_queue = 0;  // deepest the I/O queue has been
+  size_t file_pages = 0; // preallocated size, in pages
+};
+
+struct SyncStats {
+  size_t requests = 0;   // SyncUpTo calls
+  size_t syncs = 0;      // group syncs actually run
+  size_t file_syncs = 0; // fdatasync calls, one per written file per sync
+  size_t writebacks = 0; // sync_file_range calls from StartWriteback
+  double sync_ns = 0;    // total time spent in group syncs
+};
+
+// one page of a ReadPages/WritePages batch
+struct PageIO {
+  page_id_t page_id;
+  char *data;
+  bool ok; // set on completion; for a read, whether the page verified
+};
+
+class DiskManager {
+public:
+  // preallocation unit of the database file
+  static const size_t GROWTH_BYTES = 4 << 20;
+  // checksum trailer of a page slot, and trailers per checksum page
+  static const size_t TRAILER_SIZE = 8;
+  static const size_t TRAILERS_PER_PAGE = PAGE_SIZE / TRAILER_SIZE;
+
+  DiskManager(const std::string &db_file);
+  // stripe the database over one file per directory of stripe_dirs, in
+  // stripe units of stripe_pages pages, with queue_depth I/O workers per
+  // file. The files are named after db_file; the log stays next to db_file
+  DiskManager(const std::string &db_file,
+              const std::vector<std::string> &stripe_dirs,
+              size_t stripe_pages = SpaceMap::PAGES_PER_EXTENT,
+              size_t queue_depth = 4);
+  virtual ~DiskManager();
+
+  // returns false if the page can't be written
+  bool WritePage(page_id_t page_id, const char *page_data);
+  // returns false if the page fails checksum verification or can't be read
+  bool ReadPage(page_id_t page_id, char *page_data);
+
+  // read or write a batch of pages through the per-file I/O queues and wait
+  // until all of them are done
+  void ReadPages(std::vector<PageIO> &batch);
+  void WritePages(std::vector<PageIO> &batch);
+
+  // number of page writes completed so far: SyncUpTo(WriteMark()) makes
+  // every write the caller has seen complete durable
+  uint64_t WriteMark() const;
+  // make the writes up to mark durable, merged with concurrent requests.
+  // Returns false if a sync failed
+  bool SyncUpTo(uint64_t mark);
+  // start writing back, without waiting, the files written since the last
+  // sync or writeback
+  void StartWriteback();
+
+  void WriteLog(char *log_data, int size);
+  bool ReadLog(char *log_data, int size, int offset);
+
+  // allocate a page from the extents of group (e.g. the buffer pool's
+  // group_id_t of the table or index the page belongs to)
+  page_id_t AllocatePage(int32_t group = 0);
+  // count consecutive pages starting at a multiple of count, which must
+  // divide SpaceMap::PAGES_PER_EXTENT; returns the first
+  page_id_t AllocatePages(int32_t group, size_t count);
+  void DeallocatePage(page_id_t page_id);
+  bool IsAllocated(page_id_t page_id);
+
+  SpaceStats GetSpaceStats();
+
+  ChecksumStats GetChecksumStats() const;
+
+  std::vector<StripeStats> GetStripeStats();
+
+  SyncStats GetSyncStats();
+
+  // compress pages on write from now on. Call before the database is in
+  // use; returns false if the store can't be opened
+  bool SetPageCompression(bool enable);
+
+  CompressionStats GetCompressionStats();
+
+  // keep hot pages in a fast tier of fast_pages slots, in a file named after
+  // db_file in fast_dir. Call right after opening, before any page I/O; a
+  // tiered database must be reopened with the same fast_dir
+  bool SetFastTier(const std::string &fast_dir, size_t fast_pages);
+
+  // one migration round of up to max_moves moves. Returns the pages moved
+  size_t MigratePages(size_t max_moves);
+
+  // call MigratePages(max_moves) every interval on a background thread
+  void StartMigration(std::chrono::milliseconds interval, size_t max_moves);
+
+  void StopMigration();
+
+  TierStats GetTierStats();
+
+  int GetNumFlushes() const;
+  bool GetFlushState() const;
+  inline void SetFlushLogFuture(std::future<void> *f) { flush_log_f_ = f; }
+  inline bool HasFlushLogFuture() { return flush_log_f_ != nullptr; }
+
+protected:
+  // for subclasses that keep the pages somewhere else than in files, see
+  // memory_disk_manager.h. They override the raw storage hooks below;
+  // allocation, checksums and the I/O queues stay here
+  DiskManager(const std::string &name, size_t queue_depth);
+
+  // read/write the page and trailer of slot without verifying or stamping.
+  // A slot past the end of the storage reads as zeros
+  virtual bool ReadRaw(int64_t slot, char *data, char *trailer);
+  virtual bool WriteRaw(int64_t slot, const char *data, const char *trailer);
+  // grow the storage holding slot to pages slots
+  virtual bool GrowRaw(int64_t slot, int64_t pages);
+  virtual bool AppendLog(const char *log_data, size_t size);
+  virtual int64_t LogSize();
+  virtual ssize_t ReadLogAt(char *log_data, size_t size, off_t offset);
+  // flush file (an index into the stripe files) to stable storage, or with
+  // wait false only start writing it back
+  virtual bool SyncFile(size_t file, bool wait);
+  // subclasses stop the I/O workers in their destructor, before the storage
+  // the workers reach through the hooks goes away
+  void StopWorkers();
+
+private:
+  struct IoBatch {
+    std::mutex latch;
+    std::condition_variable done;
+    size_t pending;
+  };
+  struct IoRequest {
+    bool write;
+    PageIO *io;
+    IoBatch *batch;
+  };
+  struct StripeFile {
+    std::string path;
+    int fd = -1;
+    int64_t pages = 0; // preallocated size, protected by alloc_latch_
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> writes{0}; // completed writes
+    // writes covered by the last sync / writeback, protected by sync_latch_
+    uint64_t synced = 0;
+    uint64_t written_back = 0;
+    // I/O queue, protected by latch
+    std::mutex latch;
+    std::condition_variable not_empty;
+    std::deque<IoRequest> queue;
+    size_t queued = 0;
+    size_t max_queue = 0;
+    bool stop = false;
+    std::vector<std::thread> workers;
+  };
+
+  static long long GetFileSize(int fd);
+  // the stripe file of slot, and the slot's index within that file
+  inline StripeFile &Locate(int64_t slot, int64_t &local) {
+    int64_t stripe = slot / stripe_pages_;
+    StripeFile &file = *files_[stripe % files_.size()];
+    local = stripe / files_.size() * stripe_pages_ + slot % stripe_pages_;
+    return file;
+  }
+  // file offsets of the page and of the trailer of slot local of a file
+  static inline off_t PageOffset(int64_t local) {
+    int64_t group = local / TRAILERS_PER_PAGE;
+    return (group * (TRAILERS_PER_PAGE + 1) + 1 + local % TRAILERS_PER_PAGE) *
+           static_cast<off_t>(PAGE_SIZE);
+  }
+  static inline off_t TrailerOffset(int64_t local) {
+    int64_t group = local / TRAILERS_PER_PAGE;
+    return group * (TRAILERS_PER_PAGE + 1) * static_cast<off_t>(PAGE_SIZE) +
+           local % TRAILERS_PER_PAGE * TRAILER_SIZE;
+  }
+  // bytes of a file holding slots slots, and slots a file of size bytes holds
+  static off_t FileBytes(int64_t slots);
+  static int64_t FileSlots(off_t size);
+  void SubmitBatch(std::vector<PageIO> &batch, bool write);
+  void RunIoWorker(StripeFile &file);
+  void StampSlot(int32_t id, const char *data, char *trailer);
+  bool VerifySlot(int32_t id, const char *data, const char *trailer);
+  bool WriteSlot(int64_t slot, int32_t id, const char *data);
+  bool ReadSlot(int64_t slot, int32_t id, char *data);
+  void LoadSpaceMap();
+  void WriteSpaceMap(size_t map_no);
+  void EnsureFileSize(int64_t slot);
+  // one page through the compressed store or its home slot
+  bool StorePage(page_id_t page_id, const char *data);
+  bool LoadPage(page_id_t page_id, char *data);
+  // page I/O when there is a fast tier
+  bool WriteTiered(page_id_t page_id, const char *data);
+  bool ReadTiered(page_id_t page_id, char *data);
+  bool WriteFast(size_t slot, page_id_t page_id, const char *data);
+  bool ReadFast(size_t slot, page_id_t page_id, char *data);
+  bool WriteTierEntry(size_t slot, page_id_t page_id);
+
+  // file descriptor of the log
+  int log_fd_;
+  std::string log_name_;
+  std::string file_name_;
+  // the database files and the stripe layout over them
+  std::vector<std::unique_ptr<StripeFile>> files_;
+  size_t stripe_pages_;
+  size_t queue_depth_;
+  std::once_flag workers_started_;
+  // allocation state, protected by alloc_latch_
+  std::mutex alloc_latch_;
+  SpaceMap space_map_;
+  // checksum counters, times in nanoseconds
+  std::atomic<uint64_t> stamped_;
+  std::atomic<uint64_t> verified_;
+  std::atomic<uint64_t> failures_;
+  std::atomic<uint64_t> stamp_ns_;
+  std::atomic<uint64_t> verify_ns_;
+  // compressed page store, nullptr unless the database uses one; it can't
+  // be used by subclasses, which have no compressed_path_
+  std::string compressed_path_;
+  std::unique_ptr<CompressedPageStore> compressed_;
+  std::atomic<bool> compress_pages_;
+  // fast tier, nullptr unless SetFastTier was called. tier_latch_ protects
+  // tier_ and tier_stats_; page I/O holds tier_io_latch_ shared from looking
+  // up the page's location until the transfer is done, and a migration
+  // commit holds it exclusive
+  std::unique_ptr<TierMap> tier_;
+  int fast_fd_;
+  int fast_map_fd_;
+  std::mutex tier_latch_;
+  RWMutex tier_io_latch_;
+  TierStats tier_stats_;
+  std::atomic<uint64_t> fast_writes_;
+  uint64_t fast_synced_; // protected by sync_latch_
+  std::thread *migrator_;
+  bool migrator_running_;
+  std::mutex migrator_latch_;
+  std::condition_variable migrator_cv_;
+  // group sync state, protected by sync_latch_
+  std::atomic<uint64_t> write_mark_;
+  std::mutex sync_latch_;
+  std::condition_variable sync_done_;
+  bool syncing_;
+  uint64_t durable_mark_;
+  SyncStats sync_stats_;
+  std::atomic<int> num_flushes_;
+  std::atomic<bool> flush_log_;
+  std::future<void> *flush_log_f_;
+};
+
+} // namespace scudb
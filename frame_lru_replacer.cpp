@@ -0,0 +1,125 @@
+/**
+ * Frame-indexed LRU implementation
+ */
+#include "buffer/frame_lru_replacer.h"
+#include "page/page.h"
+
+namespace scudb {
+
+template <typename T> const uint32_t FrameLRUReplacer<T>::NIL;
+
+template <typename T>
+FrameLRUReplacer<T>::FrameLRUReplacer(size_t num_frames, T base)
+    : base(base), numFrames(num_frames), prev(num_frames + 1, NIL),
+      next(num_frames + 1, NIL), size(0) {
+  //空队列:哨兵自成环
+  prev[numFrames] = next[numFrames] = numFrames;
+}
+
+template <typename T> FrameLRUReplacer<T>::~FrameLRUReplacer() {}
+
+template <typename T> void FrameLRUReplacer<T>::Unlink(size_t frame) {
+  next[prev[frame]] = next[frame];
+  prev[next[frame]] = prev[frame];
+  prev[frame] = next[frame] = NIL;
+}
+
+template <typename T> void FrameLRUReplacer<T>::PushFront(size_t frame) {
+  uint32_t first = next[numFrames];
+  next[frame] = first;
+  prev[frame] = numFrames;
+  prev[first] = frame;
+  next[numFrames] = frame;
+}
+
+/*
+ * Insert value into LRU. Values outside [base, base + num_frames) are
+ * ignored
+ */
+template <typename T> void FrameLRUReplacer<T>::Insert(const T &value) {
+  size_t frame = FrameOf(value);
+  if (frame >= numFrames)
+    return;
+  lock_guard<mutex> lck(latch);
+  if (next[frame] != NIL)
+    Unlink(frame); //已在队列中,先取出再放到队首
+  else
+    size++;
+  PushFront(frame);
+}
+
+/* If LRU is non-empty, pop the tail member from LRU to argument "value", and
+ * return true. If LRU is empty, return false
+ */
+template <typename T> bool FrameLRUReplacer<T>::Victim(T &value) {
+  lock_guard<mutex> lck(latch);
+  if (size == 0)
+    return false;
+  size_t last = prev[numFrames];
+  Unlink(last);
+  size--;
+  value = base + last;
+  return true;
+}
+
+/*
+ * Walk from the tail towards the head and evict the first of the scan_limit
+ * coldest values that satisfies pred. Skipped values stay where they are
+ */
+template <typename T>
+bool FrameLRUReplacer<T>::Victim(T &value,
+                                 const function<bool(const T &)> &pred,
+                                 size_t scan_limit) {
+  lock_guard<mutex> lck(latch);
+  size_t frame = prev[numFrames];
+  for (size_t i = 0; i < scan_limit && frame != numFrames;
+       i++, frame = prev[frame]) {
+    if (!pred(base + frame))
+      continue;
+    Unlink(frame);
+    size--;
+    value = base + frame;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Copy up to n values from the tail of LRU, coldest first
+ */
+template <typename T>
+size_t FrameLRUReplacer<T>::Peek(vector<T> &values, size_t n) {
+  lock_guard<mutex> lck(latch);
+  values.clear();
+  for (size_t frame = prev[numFrames]; values.size() < n && frame != numFrames;
+       frame = prev[frame])
+    values.push_back(base + frame);
+  return values.size();
+}
+
+/*
+ * Remove value from LRU. If removal is successful, return true, otherwise
+ * return false
+ */
+template <typename T> bool FrameLRUReplacer<T>::Erase(const T &value) {
+  size_t frame = FrameOf(value);
+  if (frame >= numFrames)
+    return false;
+  lock_guard<mutex> lck(latch);
+  if (next[frame] == NIL)
+    return false;
+  Unlink(frame);
+  size--;
+  return true;
+}
+
+template <typename T> size_t FrameLRUReplacer<T>::Size() {
+  lock_guard<mutex> lck(latch);
+  return size;
+}
+
+template class FrameLRUReplacer<Page *>;
+// test only
+template class FrameLRUReplacer<int>;
+
+}
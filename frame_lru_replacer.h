@@ -0,0 +1,61 @@
+/**
+ * frame_lru_replacer.h
+ *
+ * Functionality: An exact LRU replacer for values that live in one contiguous
+ * array, such as the Page frames of the buffer pool. A value is mapped to its
+ * frame index (value - base), and the LRU list is kept as prev/next links in
+ * flat arrays sized to the number of frames. Insert/Erase/Victim become array
+ * indexing with no hashing and no allocation; all memory is allocated once in
+ * the constructor.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "buffer/scan_replacer.h"
+
+using namespace std;
+namespace scudb {
+
+template <typename T> class FrameLRUReplacer : public ScanReplacer<T> {
+public:
+  // num_frames: number of frames; base: the value of frame 0 (e.g. pages_)
+  FrameLRUReplacer(size_t num_frames, T base = T());
+
+  ~FrameLRUReplacer();
+
+  void Insert(const T &value);
+
+  bool Victim(T &value);
+
+  bool Victim(T &value, const function<bool(const T &)> &pred,
+              size_t scan_limit);
+
+  size_t Peek(vector<T> &values, size_t n);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+private:
+  static const uint32_t NIL = UINT32_MAX; // 不在队列中
+
+  inline size_t FrameOf(const T &value) const {
+    return static_cast<size_t>(value - base);
+  }
+  void Unlink(size_t frame);
+  void PushFront(size_t frame);
+
+  T base;
+  size_t numFrames;
+  // 下标numFrames为哨兵节点,next[哨兵]为队首,prev[哨兵]为队尾
+  vector<uint32_t> prev;
+  vector<uint32_t> next;
+  size_t size;
+  mutable mutex latch;
+};
+
+}
@@ -0,0 +1,99 @@
+/**
+ * index_iterator.h
+ *
+ * Functionality: Range scan over the leaves of a BPlusTree. The iterator
+ * copies the entries of one leaf under its read latch, then releases the
+ * latch and unpins the page before returning anything, so a scan holds no
+ * latch or pin between calls and may run alongside inserts, even from the
+ * same thread. When the copy is used up it moves to the next leaf.
+ *
+ * Leaves never merge and a split only moves entries to a new leaf to the
+ * right of the old one, so the next-leaf pointer seen at copy time always
+ * leads on past every key already returned. Keys inserted behind the scan
+ * after their leaf was copied are not seen.
+ *
+ * If a leaf can't be fetched (no free frame, or it fails verification) the
+ * scan stops there: isEnd() turns true and Failed() tells such an early end
+ * apart from the end of the keys.
+ */
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "index/b_plus_tree_page.h"
+
+namespace scudb {
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+class IndexIterator {
+  using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>;
+
+public:
+  using MappingType = std::pair<KeyType, ValueType>;
+
+  // an end iterator; failed for a scan that couldn't start
+  explicit IndexIterator(bool failed = false)
+      : bpm_(nullptr), group_(0), next_page_id_(INVALID_PAGE_ID), index_(0), failed_(failed) {}
+
+  // start at entry index of leaf, which the caller holds read-latched and
+  // pinned; the iterator releases it
+  IndexIterator(BufferPoolManager *bpm, group_id_t group, Page *leaf, int index)
+      : bpm_(bpm), group_(group), index_(0), failed_(false) {
+    Load(leaf, index);
+    SkipEmpty();
+  }
+
+  bool isEnd() const { return index_ >= entries_.size(); }
+  // the scan ended before the last key because a page couldn't be read
+  bool Failed() const { return failed_; }
+
+  const MappingType &operator*() const { return entries_[index_]; }
+  const MappingType *operator->() const { return &entries_[index_]; }
+
+  IndexIterator &operator++() {
+    index_++;
+    SkipEmpty();
+    return *this;
+  }
+
+private:
+  void Load(Page *leaf, int index) {
+    auto node = reinterpret_cast<LeafPage *>(leaf->GetData());
+    entries_.clear();
+    for (int i = index; i < node->GetSize(); i++)
+      entries_.push_back(node->GetItem(i));
+    next_page_id_ = node->GetNextPageId();
+    page_id_t page_id = leaf->GetPageId();
+    leaf->RUnlatch();
+    bpm_->UnpinPage(page_id, false);
+    index_ = 0;
+  }
+
+  // 当前叶子已读完时转到下一个非空叶子;读不到页面时提前结束并记为失败
+  void SkipEmpty() {
+    while (index_ >= entries_.size() && next_page_id_ != INVALID_PAGE_ID) {
+      Page *leaf = bpm_->FetchPage(next_page_id_, group_);
+      if (leaf == nullptr) {
+        entries_.clear();
+        index_ = 0;
+        next_page_id_ = INVALID_PAGE_ID;
+        failed_ = true;
+        return;
+      }
+      leaf->RLatch();
+      Load(leaf, 0);
+    }
+  }
+
+  BufferPoolManager *bpm_;
+  group_id_t group_;
+  std::vector<MappingType> entries_;
+  page_id_t next_page_id_;
+  size_t index_;
+  bool failed_;
+};
+
+} // namespace scudb
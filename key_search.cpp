@@ -0,0 +1,280 @@
+/**
+ * key_search.cpp
+ */
+#include <algorithm>
+#include <cstring>
+
+#include "index/key_search.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KEY_SEARCH_X86 1
+#endif
+
+namespace scudb {
+
+const size_t PrefixKeyArray::PREFIX_SIZE;
+const size_t PrefixKeyArray::HEADER_SIZE;
+
+namespace {
+
+// 标量计数,编译成无分支的比较累加
+template <typename T, bool OrEqual> size_t CountScalar(const T *keys, size_t n, T key) {
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++)
+    count += OrEqual ? keys[i] <= key : keys[i] < key;
+  return count;
+}
+
+#ifdef KEY_SEARCH_X86
+
+bool HasAvx2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+
+/*
+ * The vector counts compare lanes with signed greater-than: v < key is
+ * key > v, and v <= key is the lanes where v > key is false. Unsigned keys
+ * flip their sign bit first, which maps unsigned order onto signed order
+ */
+template <bool OrEqual, bool Unsigned>
+size_t Count32Sse2(const int32_t *keys, size_t n, int32_t key) {
+  const __m128i bias = _mm_set1_epi32(Unsigned ? INT32_MIN : 0);
+  const __m128i k = _mm_xor_si128(_mm_set1_epi32(key), bias);
+  size_t count = 0, i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i)), bias);
+    __m128i gt = OrEqual ? _mm_cmpgt_epi32(v, k) : _mm_cmpgt_epi32(k, v);
+    int bits = __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(gt)));
+    count += OrEqual ? 4 - bits : bits;
+  }
+  if (Unsigned)
+    return count + CountScalar<uint32_t, OrEqual>(reinterpret_cast<const uint32_t *>(keys) + i,
+                                                  n - i, static_cast<uint32_t>(key));
+  return count + CountScalar<int32_t, OrEqual>(keys + i, n - i, key);
+}
+
+template <bool OrEqual, bool Unsigned>
+__attribute__((target("avx2"))) size_t Count32Avx2(const int32_t *keys, size_t n, int32_t key) {
+  const __m256i bias = _mm256_set1_epi32(Unsigned ? INT32_MIN : 0);
+  const __m256i k = _mm256_xor_si256(_mm256_set1_epi32(key), bias);
+  size_t count = 0, i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v =
+        _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i)), bias);
+    __m256i gt = OrEqual ? _mm256_cmpgt_epi32(v, k) : _mm256_cmpgt_epi32(k, v);
+    int bits = __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(gt)));
+    count += OrEqual ? 8 - bits : bits;
+  }
+  return count + Count32Sse2<OrEqual, Unsigned>(keys + i, n - i, key);
+}
+
+template <bool OrEqual>
+__attribute__((target("avx2"))) size_t Count64Avx2(const int64_t *keys, size_t n, int64_t key) {
+  const __m256i k = _mm256_set1_epi64x(key);
+  size_t count = 0, i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+    __m256i gt = OrEqual ? _mm256_cmpgt_epi64(v, k) : _mm256_cmpgt_epi64(k, v);
+    int bits = __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(gt)));
+    count += OrEqual ? 4 - bits : bits;
+  }
+  return count + CountScalar<int64_t, OrEqual>(keys + i, n - i, key);
+}
+
+#endif
+
+template <bool OrEqual> size_t CountWindow(const int32_t *keys, size_t n, int32_t key) {
+#ifdef KEY_SEARCH_X86
+  return HasAvx2() ? Count32Avx2<OrEqual, false>(keys, n, key)
+                   : Count32Sse2<OrEqual, false>(keys, n, key);
+#else
+  return CountScalar<int32_t, OrEqual>(keys, n, key);
+#endif
+}
+
+template <bool OrEqual> size_t CountWindow(const uint32_t *keys, size_t n, uint32_t key) {
+#ifdef KEY_SEARCH_X86
+  const int32_t *signed_keys = reinterpret_cast<const int32_t *>(keys);
+  return HasAvx2() ? Count32Avx2<OrEqual, true>(signed_keys, n, key)
+                   : Count32Sse2<OrEqual, true>(signed_keys, n, key);
+#else
+  return CountScalar<uint32_t, OrEqual>(keys, n, key);
+#endif
+}
+
+template <bool OrEqual> size_t CountWindow(const int64_t *keys, size_t n, int64_t key) {
+#ifdef KEY_SEARCH_X86
+  if (HasAvx2())
+    return Count64Avx2<OrEqual>(keys, n, key);
+#endif
+  return CountScalar<int64_t, OrEqual>(keys, n, key);
+}
+
+/*
+ * Branch-free binary search down to one window: each step keeps the upper
+ * half when its first key is below key (a conditional move, not a branch),
+ * and prefetches the middle of both halves it may continue in
+ */
+template <typename T, bool OrEqual> size_t Search(const T *keys, size_t n, T key) {
+  const size_t window = WINDOW_BYTES / sizeof(T);
+  const T *base = keys;
+  while (n > window) {
+    size_t half = n / 2;
+    __builtin_prefetch(base + half / 2);
+    __builtin_prefetch(base + half + half / 2);
+    base = (OrEqual ? base[half] <= key : base[half] < key) ? base + half : base;
+    n -= half;
+  }
+  return (base - keys) + CountWindow<OrEqual>(base, n, key);
+}
+
+} // namespace
+
+size_t CountLess(const int32_t *keys, size_t n, int32_t key) {
+  return Search<int32_t, false>(keys, n, key);
+}
+
+size_t CountLessEqual(const int32_t *keys, size_t n, int32_t key) {
+  return Search<int32_t, true>(keys, n, key);
+}
+
+size_t CountLess(const int64_t *keys, size_t n, int64_t key) {
+  return Search<int64_t, false>(keys, n, key);
+}
+
+size_t CountLessEqual(const int64_t *keys, size_t n, int64_t key) {
+  return Search<int64_t, true>(keys, n, key);
+}
+
+size_t CountLess(const uint32_t *keys, size_t n, uint32_t key) {
+  return Search<uint32_t, false>(keys, n, key);
+}
+
+size_t CountLessEqual(const uint32_t *keys, size_t n, uint32_t key) {
+  return Search<uint32_t, true>(keys, n, key);
+}
+
+const char *KeySearchIsa() {
+#ifdef KEY_SEARCH_X86
+  return HasAvx2() ? "avx2" : "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+/*
+ * PrefixKeyArray
+ */
+bool PrefixKeyArray::Init(char *region, size_t size, uint16_t capacity) {
+  if (size > UINT16_MAX || HEADER_SIZE + capacity * (PREFIX_SIZE + 4) > size)
+    return false;
+  uint16_t *header = reinterpret_cast<uint16_t *>(region);
+  header[0] = 0;
+  header[1] = capacity;
+  header[2] = size;
+  header[3] = size;
+  return true;
+}
+
+size_t PrefixKeyArray::FreeSpace() const {
+  return Header()[3] - (HEADER_SIZE + GetCapacity() * (PREFIX_SIZE + 4));
+}
+
+// 前PREFIX_SIZE字节按大端序组成uint32_t,不足补零,整数顺序即字节序
+uint32_t PrefixKeyArray::Prefix(const char *key, size_t len) {
+  uint32_t prefix = 0;
+  for (size_t i = 0; i < PREFIX_SIZE; i++)
+    prefix = (prefix << 8) | (i < len ? static_cast<uint8_t>(key[i]) : 0);
+  return prefix;
+}
+
+/*
+ * Equal prefixes mean the first PREFIX_SIZE bytes agree, counting the zero
+ * padding; if either key ends within them, it is a prefix of the other and
+ * the lengths decide. Otherwise the tails decide
+ */
+int PrefixKeyArray::Compare(int index, const char *key, size_t len) const {
+  uint32_t prefix = Prefixes()[index], other = Prefix(key, len);
+  if (prefix != other)
+    return prefix < other ? -1 : 1;
+  size_t own_len = KeyLength(index);
+  if (std::min(own_len, len) > PREFIX_SIZE) {
+    int cmp = memcmp(region_ + Slots()[index * 2], key + PREFIX_SIZE,
+                     std::min(own_len, len) - PREFIX_SIZE);
+    if (cmp != 0)
+      return cmp;
+  }
+  return own_len < len ? -1 : (own_len > len ? 1 : 0);
+}
+
+int PrefixKeyArray::LowerBound(const char *key, size_t len) const {
+  uint32_t prefix = Prefix(key, len);
+  int lo = CountLess(Prefixes(), GetSize(), prefix);
+  int hi = CountLessEqual(Prefixes(), GetSize(), prefix);
+  //前缀相同的范围内按完整键二分
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (Compare(mid, key, len) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+bool PrefixKeyArray::Find(const char *key, size_t len, int &index) const {
+  index = LowerBound(key, len);
+  return index < GetSize() && Compare(index, key, len) == 0;
+}
+
+bool PrefixKeyArray::InsertAt(int index, const char *key, size_t len) {
+  size_t tail_len = len > PREFIX_SIZE ? len - PREFIX_SIZE : 0;
+  int size = GetSize();
+  if (size >= GetCapacity() || len > UINT16_MAX || tail_len > FreeSpace())
+    return false;
+  uint16_t *header = Header();
+  header[3] -= tail_len;
+  memcpy(region_ + header[3], key + PREFIX_SIZE, tail_len);
+  uint32_t *prefixes = Prefixes();
+  uint16_t *slots = Slots();
+  std::move_backward(prefixes + index, prefixes + size, prefixes + size + 1);
+  std::move_backward(slots + index * 2, slots + size * 2, slots + size * 2 + 2);
+  prefixes[index] = Prefix(key, len);
+  slots[index * 2] = header[3];
+  slots[index * 2 + 1] = len;
+  header[0]++;
+  return true;
+}
+
+void PrefixKeyArray::RemoveAt(int index) {
+  uint16_t *header = Header();
+  uint16_t *slots = Slots();
+  uint32_t *prefixes = Prefixes();
+  int size = GetSize();
+  uint16_t offset = slots[index * 2];
+  size_t tail_len = KeyLength(index) > PREFIX_SIZE ? KeyLength(index) - PREFIX_SIZE : 0;
+  //把位于它下方的尾部整体上移,空闲空间保持连续
+  if (tail_len > 0) {
+    memmove(region_ + header[3] + tail_len, region_ + header[3], offset - header[3]);
+    for (int i = 0; i < size; i++)
+      if (slots[i * 2] < offset)
+        slots[i * 2] += tail_len;
+    header[3] += tail_len;
+  }
+  std::move(prefixes + index + 1, prefixes + size, prefixes + index);
+  std::move(slots + index * 2 + 2, slots + size * 2, slots + index * 2);
+  header[0]--;
+}
+
+void PrefixKeyArray::KeyAt(int index, char *out) const {
+  size_t len = KeyLength(index);
+  uint32_t prefix = Prefixes()[index];
+  for (size_t i = 0; i < PREFIX_SIZE && i < len; i++)
+    out[i] = static_cast<char>(prefix >> (8 * (PREFIX_SIZE - 1 - i)));
+  if (len > PREFIX_SIZE)
+    memcpy(out + PREFIX_SIZE, region_ + Slots()[index * 2], len - PREFIX_SIZE);
+}
+
+} // namespace scudb
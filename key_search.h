@@ -0,0 +1,151 @@
+/**
+ * key_search.h
+ *
+ * Functionality: Search over the sorted key arrays of index pages.
+ *
+ * Fixed-width integer keys (int32_t, int64_t, uint32_t): a branch-free
+ * binary search narrows the range down to WINDOW_BYTES of keys, prefetching
+ * both halves of the next step so the cache misses of a large node overlap,
+ * then SIMD compares count the keys of the window below the search key. The
+ * SIMD part uses AVX2 when the CPU has it and SSE2 otherwise; SSE2 has no
+ * 64-bit compare, so int64_t keys fall back to a branch-free scalar count
+ * there. Other key types get the branch-free search with their comparator.
+ *
+ * Variable-length keys: PrefixKeyArray keeps the first PREFIX_SIZE bytes of
+ * every key in a dense array of big-endian uint32_t, which the integer
+ * search above can scan, and the remaining bytes (the tail) in a heap at the
+ * end of the region. Only keys whose prefix equals the search key's prefix
+ * are compared in full.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace scudb {
+
+// comparator for integral keys: <0, 0, >0 like the generic key comparators
+template <typename KeyType> struct IntegerComparator {
+  int operator()(const KeyType &lhs, const KeyType &rhs) const {
+    return lhs < rhs ? -1 : (rhs < lhs ? 1 : 0);
+  }
+};
+
+// the keys are scanned with SIMD compares once the range is this small
+// (about a cache line; the binary search steps before it are cheaper than
+// vector compares over more)
+static const size_t WINDOW_BYTES = 64;
+
+// number of keys in sorted keys[0, n) that are < key, or <= key
+size_t CountLess(const int32_t *keys, size_t n, int32_t key);
+size_t CountLessEqual(const int32_t *keys, size_t n, int32_t key);
+size_t CountLess(const int64_t *keys, size_t n, int64_t key);
+size_t CountLessEqual(const int64_t *keys, size_t n, int64_t key);
+size_t CountLess(const uint32_t *keys, size_t n, uint32_t key);
+size_t CountLessEqual(const uint32_t *keys, size_t n, uint32_t key);
+
+// which SIMD instruction set the integer searches use: "avx2", "sse2" or
+// "scalar"
+const char *KeySearchIsa();
+
+/*
+ * Lower and upper bound over keys[0, n) for any comparator, branch-free
+ */
+template <typename KeyType, typename KeyComparator> struct KeySearch {
+  // first index whose key is >= key
+  static int LowerBound(const KeyType *keys, int n, const KeyType &key,
+                        const KeyComparator &comparator) {
+    const KeyType *base = keys;
+    while (n > 1) {
+      int half = n / 2;
+      __builtin_prefetch(base + half / 2);
+      __builtin_prefetch(base + half + half / 2);
+      base = comparator(base[half], key) < 0 ? base + half : base;
+      n -= half;
+    }
+    return (base - keys) + (n == 1 && comparator(*base, key) < 0);
+  }
+
+  // first index whose key is > key
+  static int UpperBound(const KeyType *keys, int n, const KeyType &key,
+                        const KeyComparator &comparator) {
+    const KeyType *base = keys;
+    while (n > 1) {
+      int half = n / 2;
+      __builtin_prefetch(base + half / 2);
+      __builtin_prefetch(base + half + half / 2);
+      base = comparator(base[half], key) <= 0 ? base + half : base;
+      n -= half;
+    }
+    return (base - keys) + (n == 1 && comparator(*base, key) <= 0);
+  }
+};
+
+// integer keys of the widths CountLess covers go to the SIMD search
+template <typename KeyType> struct KeySearch<KeyType, IntegerComparator<KeyType>> {
+  static int LowerBound(const KeyType *keys, int n, const KeyType &key,
+                        const IntegerComparator<KeyType> &) {
+    return CountLess(keys, n, key);
+  }
+  static int UpperBound(const KeyType *keys, int n, const KeyType &key,
+                        const IntegerComparator<KeyType> &) {
+    return CountLessEqual(keys, n, key);
+  }
+};
+
+/*
+ * Sorted variable-length keys in a region of a page:
+ * -------------------------------------------------------------------------
+ * | header | prefixes (capacity x 4) | slots (capacity x 4) | free | tails |
+ * -------------------------------------------------------------------------
+ * Header: size, capacity, region size and where the tails begin (2 bytes
+ * each). A slot is the offset and the length of a key; its tail, the bytes
+ * after PREFIX_SIZE, is at offset. Tails are packed towards the end of the
+ * region, and a remove closes the gap right away, so the free space is
+ * always contiguous. Offsets are 16 bits, so a region is at most 64 KiB.
+ */
+class PrefixKeyArray {
+public:
+  static const size_t PREFIX_SIZE = 4;
+  static const size_t HEADER_SIZE = 8;
+
+  // lay out an empty array of up to capacity keys over region; false if
+  // the slots don't fit in size bytes
+  static bool Init(char *region, size_t size, uint16_t capacity);
+
+  explicit PrefixKeyArray(char *region) : region_(region) {}
+
+  int GetSize() const { return Header()[0]; }
+  int GetCapacity() const { return Header()[1]; }
+  // bytes left for tails
+  size_t FreeSpace() const;
+
+  // first index whose key is >= key
+  int LowerBound(const char *key, size_t len) const;
+  bool Find(const char *key, size_t len, int &index) const;
+
+  // insert key at index (from LowerBound); false if it doesn't fit
+  bool InsertAt(int index, const char *key, size_t len);
+  void RemoveAt(int index);
+
+  size_t KeyLength(int index) const { return Slots()[index * 2 + 1]; }
+  // copy the key at index into out, which holds KeyLength(index) bytes
+  void KeyAt(int index, char *out) const;
+
+  // <0, 0, >0 as the key at index sorts before, with or after key
+  int Compare(int index, const char *key, size_t len) const;
+
+private:
+  static uint32_t Prefix(const char *key, size_t len);
+
+  uint16_t *Header() const { return reinterpret_cast<uint16_t *>(region_); }
+  uint32_t *Prefixes() const { return reinterpret_cast<uint32_t *>(region_ + HEADER_SIZE); }
+  uint16_t *Slots() const {
+    return reinterpret_cast<uint16_t *>(region_ + HEADER_SIZE + GetCapacity() * PREFIX_SIZE);
+  }
+
+  char *region_;
+};
+
+} // namespace scudb
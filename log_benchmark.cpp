@@ -0,0 +1,251 @@
+/**
+ * log_benchmark.cpp
+ *
+ * Log volume and decode speed of every LogEncoding. Built as a standalone
+ * binary against the sources. The includes follow the scudb source layout
+ * (headers in src/include/<dir>, sources in src/<dir>); with the files in
+ * place there and this one at the root of the checkout:
+ *
+ *   g++ -O2 -std=c++17 -Isrc/include -pthread log_benchmark.cpp \
+ *       $(find src/logging src/buffer src/disk src/hash src/index \
+ *              src/common src/table src/type src/concurrency -name '*.cpp') \
+ *       -o log_benchmark
+ *
+ * (add -DSCUDB_HAVE_LZ4 -llz4 for the compact+lz4 encoding). For each
+ * encoding, --threads committers each run --txns transactions of a few
+ * inserts, small in-place updates and deletes, waiting for their COMMIT to
+ * be durable. The log is then scanned back with LogRecovery::ScanLog. One
+ * CSV line per encoding:
+ *
+ *   encoding,transactions,records,raw_bytes,written_bytes,bytes_per_txn,
+ *   ratio,commit_txn_per_s,scan_mb_per_s,scan_records_per_s
+ *
+ * scan_mb_per_s counts decoded (plain) bytes, so the encodings compare
+ * directly. --device ram|nvme|ssd|hdd runs against an emulated device (see
+ * memory_disk_manager.h) instead of the log file, so the commit rate shows
+ * what group commit gets out of a slower or faster log device.
+ *
+ * Then the compact log of one more run is redone into an empty buffer pool
+ * (large enough for every page) with 1, 2, 4, ... up to --redo-workers redo
+ * workers, one CSV line per worker count:
+ *
+ *   redo_workers,records,redone,redo_seconds,redo_records_per_s
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/compression.h"
+#include "disk/memory_disk_manager.h"
+#include "logging/log_manager.h"
+#include "logging/log_recovery.h"
+
+using namespace std;
+using namespace scudb;
+
+namespace {
+
+struct Options {
+  size_t threads = 4;
+  size_t txns = 20000; // per thread
+  size_t tuple_size = 96;
+  size_t redo_workers = max(1u, thread::hardware_concurrency());
+  string device = "file"; // or an emulated device, see DeviceProfile::ByName
+};
+
+// 行数据:若干定长字段,内容类似真实表中的数字与文本
+Tuple MakeTuple(mt19937 &rng, size_t size) {
+  static const char *words[] = {"alpha", "bravo", "charlie", "delta",
+                                "echo",  "foxtrot", "golf", "hotel"};
+  vector<char> buf(sizeof(int32_t) + size, 0);
+  int32_t len = size;
+  memcpy(buf.data(), &len, sizeof(len));
+  char *data = buf.data() + sizeof(int32_t);
+  for (size_t i = 0; i + 8 <= size; i += 16) {
+    int64_t number = rng() % 100000;
+    memcpy(data + i, &number, sizeof(number));
+    const char *word = words[rng() % 8];
+    memcpy(data + i + 8, word, min<size_t>(strlen(word), size - i - 8));
+  }
+  Tuple tuple;
+  tuple.DeserializeFrom(buf.data());
+  return tuple;
+}
+
+// 原地更新:改动元组中的一个数字字段
+Tuple Modify(const Tuple &tuple, mt19937 &rng) {
+  vector<char> buf(sizeof(int32_t) + tuple.GetLength());
+  tuple.SerializeTo(buf.data());
+  int64_t number = rng() % 100000;
+  size_t field = (rng() % (tuple.GetLength() / 16)) * 16;
+  memcpy(buf.data() + sizeof(int32_t) + field, &number, sizeof(number));
+  Tuple updated;
+  updated.DeserializeFrom(buf.data());
+  return updated;
+}
+
+// 每页的元组数:表页头24字节,每个元组另占8字节的槽
+size_t TuplesPerPage(const Options &opt) {
+  return max<size_t>(1, (PAGE_SIZE - 24) / (opt.tuple_size + 8));
+}
+
+void RunTransactions(LogManager &log_manager, const Options &opt, size_t id) {
+  mt19937 rng(id + 1);
+  // 各线程的页交错编号;第一条插入前先有NEWPAGE,重做时页已初始化
+  const uint32_t per_page = TuplesPerPage(opt);
+  page_id_t page_id = id;
+  uint32_t slot = per_page;
+  for (size_t t = 0; t < opt.txns; t++) {
+    txn_id_t txn = id * opt.txns + t;
+    LogRecord begin(txn, INVALID_LSN, LogRecordType::BEGIN);
+    lsn_t prev = log_manager.AppendLogRecord(begin);
+    for (int i = 0; i < 4; i++) {
+      if (slot == per_page) {
+        LogRecord new_page(txn, prev, LogRecordType::NEWPAGE, page_id);
+        prev = log_manager.AppendLogRecord(new_page);
+        page_id += opt.threads;
+        slot = 0;
+      }
+      RID rid(page_id, slot++);
+      Tuple tuple = MakeTuple(rng, opt.tuple_size);
+      LogRecord insert(txn, prev, LogRecordType::INSERT, rid, tuple);
+      prev = log_manager.AppendLogRecord(insert);
+      if (i % 2 == 0) {
+        LogRecord update(txn, prev, LogRecordType::UPDATE, rid, tuple,
+                         Modify(tuple, rng));
+        prev = log_manager.AppendLogRecord(update);
+      }
+      if (i == 3) {
+        LogRecord mark(txn, prev, LogRecordType::MARKDELETE, rid, tuple);
+        prev = log_manager.AppendLogRecord(mark);
+      }
+    }
+    LogRecord commit(txn, prev, LogRecordType::COMMIT);
+    log_manager.WaitForFlush(log_manager.AppendLogRecord(commit));
+  }
+}
+
+DiskManager *OpenDisk(const Options &opt, const string &db) {
+  if (opt.device == "file")
+    return new DiskManager(db);
+  return new MemoryDiskManager(DeviceProfile::ByName(opt.device));
+}
+
+// 所有线程跑完各自的事务,返回耗时(秒)
+double WriteLog(DiskManager &disk_manager, LogEncoding encoding,
+                const Options &opt, LogStats &stats) {
+  LogManager log_manager(&disk_manager, encoding);
+  log_manager.RunFlushThread();
+  auto t0 = chrono::steady_clock::now();
+  vector<thread> workers;
+  for (size_t i = 0; i < opt.threads; i++)
+    workers.emplace_back(RunTransactions, ref(log_manager), cref(opt), i);
+  for (auto &w : workers)
+    w.join();
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+  log_manager.StopFlushThread();
+  stats = log_manager.GetStats();
+  return seconds;
+}
+
+void Bench(LogEncoding encoding, const char *name, const Options &opt) {
+  string db = string("log_benchmark_") + name + ".db";
+  string log = string("log_benchmark_") + name + ".log";
+  {
+    unique_ptr<DiskManager> disk(OpenDisk(opt, db));
+    DiskManager &disk_manager = *disk;
+    LogStats stats;
+    double commit_seconds = WriteLog(disk_manager, encoding, opt, stats);
+    LogRecovery recovery(&disk_manager, nullptr);
+    recovery.ScanLog(0, [](LogRecord &, const LogRecovery::LogLocation &) {});
+    RecoveryStats scan = recovery.GetStats();
+    size_t txns = opt.threads * opt.txns;
+    printf("%s,%zu,%zu,%zu,%zu,%.1f,%.3f,%.0f,%.1f,%.0f\n", name, txns,
+           scan.records, stats.raw_bytes, stats.written_bytes,
+           double(stats.written_bytes) / txns,
+           double(stats.written_bytes) / stats.raw_bytes, txns / commit_seconds,
+           stats.raw_bytes / scan.scan_seconds / 1e6,
+           scan.records / scan.scan_seconds);
+    if (scan.transactions != txns)
+      fprintf(stderr, "%s: scanned %zu of %zu transactions\n", name,
+              scan.transactions, txns);
+  }
+  remove(db.c_str());
+  remove(log.c_str());
+}
+
+/*
+ * Every run redoes the same log into a fresh pool; the pool never writes a
+ * page back, so each run starts from the same (empty) pages
+ */
+void BenchRedo(const Options &opt) {
+  string db = "log_benchmark_redo.db";
+  string log = "log_benchmark_redo.log";
+  {
+    unique_ptr<DiskManager> disk(OpenDisk(opt, db));
+    LogStats stats;
+    WriteLog(*disk, LogEncoding::COMPACT, opt, stats);
+    size_t pages = opt.threads * (opt.txns * 4 / TuplesPerPage(opt) + 2);
+    printf("redo_workers,records,redone,redo_seconds,redo_records_per_s\n");
+    for (size_t workers = 1;; workers = min(workers * 2, opt.redo_workers)) {
+      BufferPoolManager bpm(pages, disk.get());
+      LogRecovery recovery(disk.get(), &bpm, workers);
+      auto t0 = chrono::steady_clock::now();
+      recovery.Redo();
+      double seconds =
+          chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+      RecoveryStats redo = recovery.GetStats();
+      printf("%zu,%zu,%zu,%.3f,%.0f\n", workers, redo.records, redo.redone,
+             seconds, redo.records / seconds);
+      if (workers == opt.redo_workers)
+        break;
+    }
+  }
+  remove(db.c_str());
+  remove(log.c_str());
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    const char *val = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--threads")
+      opt.threads = strtoull(val, nullptr, 10), i++;
+    else if (arg == "--txns")
+      opt.txns = strtoull(val, nullptr, 10), i++;
+    else if (arg == "--tuple-size")
+      opt.tuple_size = max<size_t>(16, strtoull(val, nullptr, 10)), i++;
+    else if (arg == "--device")
+      opt.device = val, i++;
+    else if (arg == "--redo-workers")
+      opt.redo_workers = max<size_t>(1, strtoull(val, nullptr, 10)), i++;
+    else {
+      fprintf(stderr,
+              "usage: %s [--threads N] [--txns N] [--tuple-size N] "
+              "[--device file|ram|nvme|ssd|hdd] [--redo-workers N]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  printf("encoding,transactions,records,raw_bytes,written_bytes,bytes_per_txn,"
+         "ratio,commit_txn_per_s,scan_mb_per_s,scan_records_per_s\n");
+  Bench(LogEncoding::RAW, "raw", opt);
+  Bench(LogEncoding::COMPACT, "compact", opt);
+  if (Lz4Available())
+    Bench(LogEncoding::COMPACT_LZ4, "compact_lz4", opt);
+  BenchRedo(opt);
+  return 0;
+}
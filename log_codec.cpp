@@ -0,0 +1,368 @@
+/**
+ * log_codec.cpp
+ */
+
+#include <cstring>
+
+#include "common/compression.h"
+#include "common/rid.h"
+#include "logging/log_codec.h"
+#include "logging/log_record.h"
+
+namespace scudb {
+
+namespace {
+
+// plain record layout, see LogManager::SerializeLogRecord
+const size_t HEADER_SIZE = 20;
+const size_t SIZE_OFFSET = 0, LSN_OFFSET = 4, TXN_OFFSET = 8, PREV_OFFSET = 12,
+             TYPE_OFFSET = 16;
+
+int32_t Load32(const char *p) {
+  int32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+void Store32(char *p, int32_t v) { memcpy(p, &v, sizeof(v)); }
+
+/*
+ * 带边界检查的写游标,任何一次写不下都会让ok变为false
+ */
+struct Writer {
+  char *pos;
+  char *end;
+  bool ok = true;
+
+  void Varint(uint64_t v) {
+    size_t n = ok ? PutVarint(pos, end - pos, v) : 0;
+    ok = n > 0;
+    pos += n;
+  }
+  void Bytes(const char *src, size_t n) {
+    ok = ok && static_cast<size_t>(end - pos) >= n;
+    if (ok) {
+      memcpy(pos, src, n);
+      pos += n;
+    }
+  }
+  void Byte(uint8_t b) { Bytes(reinterpret_cast<const char *>(&b), 1); }
+};
+
+struct Reader {
+  const char *pos;
+  const char *end;
+  bool ok = true;
+
+  uint64_t Varint() {
+    uint64_t v = 0;
+    size_t n = ok ? GetVarint(pos, end - pos, v) : 0;
+    ok = n > 0;
+    pos += n;
+    return v;
+  }
+  const char *Bytes(size_t n) {
+    ok = ok && static_cast<size_t>(end - pos) >= n;
+    const char *p = pos;
+    if (ok)
+      pos += n;
+    return p;
+  }
+};
+
+/*
+ * RID在纪录中按原样存储;page id编码为与上一条记录所在页的差值,
+ * 同一页上连续的操作只需1字节
+ */
+void EncodeRid(Writer &w, const char *rid_bytes, page_id_t &last_page) {
+  RID rid;
+  memcpy(&rid, rid_bytes, sizeof(RID));
+  w.Varint(ZigZag(int64_t(rid.GetPageId()) - last_page));
+  w.Varint(rid.GetSlotNum());
+  last_page = rid.GetPageId();
+}
+
+void DecodeRid(Reader &r, char *rid_bytes, page_id_t &last_page) {
+  page_id_t page_id = static_cast<page_id_t>(last_page + UnZigZag(r.Varint()));
+  uint32_t slot = static_cast<uint32_t>(r.Varint());
+  RID rid;
+  rid.Set(page_id, slot);
+  memcpy(rid_bytes, &rid, sizeof(RID));
+  last_page = page_id;
+}
+
+// 变换一条元组:int32长度 + 数据
+bool EncodeTuple(Writer &w, const char *&src, const char *end) {
+  if (end - src < 4)
+    return false;
+  int32_t len = Load32(src);
+  if (len < 0 || end - src - 4 < len)
+    return false;
+  w.Varint(len);
+  w.Bytes(src + 4, len);
+  src += 4 + len;
+  return true;
+}
+
+bool DecodeTuple(Reader &r, char *&dst, const char *dst_end) {
+  uint64_t len = r.Varint();
+  const char *data = r.Bytes(len);
+  if (!r.ok || static_cast<uint64_t>(dst_end - dst) < 4 + len)
+    return false;
+  Store32(dst, static_cast<int32_t>(len));
+  memcpy(dst + 4, data, len);
+  dst += 4 + len;
+  return true;
+}
+
+/*
+ * Update: before-image as is, after-image as an XOR delta against it. The
+ * delta length carries a mode bit so an after-image that doesn't delta
+ * well is stored as is
+ */
+bool EncodeUpdateImages(Writer &w, const char *&src, const char *end) {
+  const char *old_image = src;
+  if (!EncodeTuple(w, src, end) || end - src < 4)
+    return false;
+  int32_t old_len = Load32(old_image);
+  int32_t new_len = Load32(src);
+  if (new_len < 0 || end - src - 4 < new_len)
+    return false;
+  const char *new_data = src + 4;
+  w.Varint(new_len);
+  size_t delta = 0;
+  if (w.ok && new_len > 0)
+    delta = XorDeltaEncode(old_image + 4, old_len, new_data, new_len, w.pos,
+                           w.end - w.pos);
+  // 差值写在长度字段应在的位置,确定长度字段的字节数后再后移
+  if (delta > 0 && delta + 5 < static_cast<size_t>(new_len)) {
+    char tmp[10];
+    size_t n = PutVarint(tmp, sizeof(tmp), delta << 1 | 1);
+    w.ok = w.ok && static_cast<size_t>(w.end - w.pos) >= n + delta;
+    if (w.ok) {
+      memmove(w.pos + n, w.pos, delta);
+      memcpy(w.pos, tmp, n);
+      w.pos += n + delta;
+    }
+  } else {
+    w.Varint(static_cast<uint64_t>(new_len) << 1);
+    w.Bytes(new_data, new_len);
+  }
+  src += 4 + new_len;
+  return true;
+}
+
+bool DecodeUpdateImages(Reader &r, char *&dst, const char *dst_end) {
+  char *old_image = dst;
+  if (!DecodeTuple(r, dst, dst_end))
+    return false;
+  uint64_t new_len = r.Varint();
+  uint64_t mode = r.Varint();
+  const char *data = r.Bytes(mode >> 1);
+  if (!r.ok || static_cast<uint64_t>(dst_end - dst) < 4 + new_len)
+    return false;
+  Store32(dst, static_cast<int32_t>(new_len));
+  if (mode & 1) {
+    if (!XorDeltaDecode(old_image + 4, Load32(old_image), data, mode >> 1,
+                        dst + 4, new_len))
+      return false;
+  } else {
+    if ((mode >> 1) != new_len)
+      return false;
+    memcpy(dst + 4, data, new_len);
+  }
+  dst += 4 + new_len;
+  return true;
+}
+
+/*
+ * Plain records -> compact records. Returns the compact size, 0 when the
+ * records are malformed or the output doesn't fit in cap
+ */
+size_t EncodeRecords(const char *raw, size_t len, char *dst, size_t cap) {
+  Writer w{dst, dst + cap};
+  const char *pos = raw, *end = raw + len;
+  lsn_t last_lsn = 0;
+  page_id_t last_page = 0;
+  while (pos < end) {
+    if (end - pos < static_cast<ptrdiff_t>(HEADER_SIZE))
+      return 0;
+    int32_t size = Load32(pos + SIZE_OFFSET);
+    if (size < static_cast<int32_t>(HEADER_SIZE) || end - pos < size)
+      return 0;
+    lsn_t lsn = Load32(pos + LSN_OFFSET);
+    lsn_t prev_lsn = Load32(pos + PREV_OFFSET);
+    LogRecordType type = static_cast<LogRecordType>(Load32(pos + TYPE_OFFSET));
+    w.Byte(static_cast<uint8_t>(type));
+    w.Varint(ZigZag(int64_t(lsn) - last_lsn));
+    w.Varint(ZigZag(Load32(pos + TXN_OFFSET)));
+    w.Varint(prev_lsn == INVALID_LSN ? 0 : ZigZag(int64_t(lsn) - prev_lsn) + 1);
+    last_lsn = lsn;
+    const char *payload = pos + HEADER_SIZE, *record_end = pos + size;
+    bool ok = true;
+    switch (type) {
+    case LogRecordType::INSERT:
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      ok = record_end - payload >= static_cast<ptrdiff_t>(sizeof(RID));
+      if (ok) {
+        EncodeRid(w, payload, last_page);
+        payload += sizeof(RID);
+        ok = EncodeTuple(w, payload, record_end);
+      }
+      break;
+    case LogRecordType::UPDATE:
+      ok = record_end - payload >= static_cast<ptrdiff_t>(sizeof(RID));
+      if (ok) {
+        EncodeRid(w, payload, last_page);
+        payload += sizeof(RID);
+        ok = EncodeUpdateImages(w, payload, record_end);
+      }
+      break;
+    case LogRecordType::NEWPAGE:
+      ok = record_end - payload >= static_cast<ptrdiff_t>(sizeof(page_id_t));
+      if (ok)
+        w.Varint(ZigZag(Load32(payload)));
+      break;
+    default:
+      break;
+    }
+    if (!ok || !w.ok)
+      return 0;
+    pos += size;
+  }
+  return w.pos - dst;
+}
+
+size_t DecodeRecords(const char *src, size_t len, char *dst, size_t cap) {
+  Reader r{src, src + len};
+  char *out = dst, *out_end = dst + cap;
+  lsn_t last_lsn = 0;
+  page_id_t last_page = 0;
+  while (r.pos < r.end) {
+    if (out_end - out < static_cast<ptrdiff_t>(HEADER_SIZE))
+      return 0;
+    uint8_t type = static_cast<uint8_t>(*r.Bytes(1));
+    lsn_t lsn = static_cast<lsn_t>(last_lsn + UnZigZag(r.Varint()));
+    txn_id_t txn = static_cast<txn_id_t>(UnZigZag(r.Varint()));
+    uint64_t back = r.Varint();
+    lsn_t prev_lsn =
+        back == 0 ? INVALID_LSN : static_cast<lsn_t>(lsn - UnZigZag(back - 1));
+    last_lsn = lsn;
+    char *record = out;
+    out += HEADER_SIZE;
+    bool ok = r.ok;
+    switch (static_cast<LogRecordType>(type)) {
+    case LogRecordType::INSERT:
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      ok = ok && out_end - out >= static_cast<ptrdiff_t>(sizeof(RID));
+      if (ok) {
+        DecodeRid(r, out, last_page);
+        out += sizeof(RID);
+        ok = DecodeTuple(r, out, out_end);
+      }
+      break;
+    case LogRecordType::UPDATE:
+      ok = ok && out_end - out >= static_cast<ptrdiff_t>(sizeof(RID));
+      if (ok) {
+        DecodeRid(r, out, last_page);
+        out += sizeof(RID);
+        ok = DecodeUpdateImages(r, out, out_end);
+      }
+      break;
+    case LogRecordType::NEWPAGE:
+      ok = ok && out_end - out >= static_cast<ptrdiff_t>(sizeof(page_id_t));
+      if (ok) {
+        Store32(out, static_cast<int32_t>(UnZigZag(r.Varint())));
+        out += sizeof(page_id_t);
+      }
+      break;
+    default:
+      break;
+    }
+    if (!ok || !r.ok)
+      return 0;
+    Store32(record + SIZE_OFFSET, static_cast<int32_t>(out - record));
+    Store32(record + LSN_OFFSET, lsn);
+    Store32(record + TXN_OFFSET, txn);
+    Store32(record + PREV_OFFSET, prev_lsn);
+    Store32(record + TYPE_OFFSET, type);
+  }
+  return out - dst;
+}
+
+} // namespace
+
+size_t EncodeLogFrame(const char *raw, size_t len, LogEncoding encoding,
+                      char *dst, char *scratch) {
+  if (encoding == LogEncoding::RAW || len <= LOG_FRAME_HEADER_SIZE)
+    return 0;
+  size_t cap = len - LOG_FRAME_HEADER_SIZE;
+  char *payload = dst + LOG_FRAME_HEADER_SIZE;
+  bool lz4 = encoding == LogEncoding::COMPACT_LZ4 && Lz4Available();
+  // 需要LZ4时先编码到scratch,压缩结果再写入dst
+  size_t encoded = EncodeRecords(raw, len, lz4 ? scratch : payload, lz4 ? len : cap);
+  if (encoded == 0)
+    return 0;
+  uint8_t flags = LOG_FRAME_COMPACT;
+  size_t stored = encoded;
+  if (lz4) {
+    stored = Lz4Compress(scratch, encoded, payload, cap);
+    if (stored > 0 && stored < encoded) {
+      flags |= LOG_FRAME_LZ4;
+    } else if (encoded <= cap) {
+      memcpy(payload, scratch, encoded);
+      stored = encoded;
+    } else {
+      return 0;
+    }
+  }
+  uint32_t header[4] = {LOG_FRAME_MAGIC, static_cast<uint32_t>(len),
+                        static_cast<uint32_t>(encoded),
+                        static_cast<uint32_t>(stored)};
+  memcpy(dst, &header[0], 4);
+  dst[4] = static_cast<char>(flags);
+  memcpy(dst + 5, &header[1], 12);
+  return LOG_FRAME_HEADER_SIZE + stored;
+}
+
+bool IsLogFrame(const char *data) {
+  uint32_t magic;
+  memcpy(&magic, data, sizeof(magic));
+  return magic == LOG_FRAME_MAGIC;
+}
+
+size_t LogFrameSize(const char *data) {
+  uint32_t stored;
+  memcpy(&stored, data + 13, sizeof(stored));
+  return LOG_FRAME_HEADER_SIZE + stored;
+}
+
+size_t DecodeLogFrame(const char *frame, size_t size, char *dst, size_t cap,
+                      char *scratch) {
+  if (size < LOG_FRAME_HEADER_SIZE || !IsLogFrame(frame) ||
+      LogFrameSize(frame) != size)
+    return 0;
+  uint8_t flags = static_cast<uint8_t>(frame[4]);
+  uint32_t lens[3]; // raw, encoded, stored
+  memcpy(lens, frame + 5, sizeof(lens));
+  if (lens[0] > cap || lens[1] > cap)
+    return 0;
+  const char *encoded = frame + LOG_FRAME_HEADER_SIZE;
+  if (flags & LOG_FRAME_LZ4) {
+    if (!Lz4Decompress(encoded, lens[2], scratch, lens[1]))
+      return 0;
+    encoded = scratch;
+  } else if (lens[1] != lens[2]) {
+    return 0;
+  }
+  if (!(flags & LOG_FRAME_COMPACT))
+    return 0;
+  size_t n = DecodeRecords(encoded, lens[1], dst, cap);
+  return n == lens[0] ? n : 0;
+}
+
+} // namespace scudb
@@ -0,0 +1,53 @@
+/**
+ * log_codec.h
+ *
+ * Functionality: Compact on-disk encoding of log batches. Records stay in
+ * the fixed layout written by LogManager::AppendLogRecord while in memory;
+ * the flush thread re-encodes each sealed batch as one frame:
+ *
+ *   u32 magic | u8 flags | u32 raw_len | u32 encoded_len | u32 stored_len
+ *   | stored_len bytes
+ *
+ * With LOG_FRAME_COMPACT every record becomes: type byte, varint LSN delta
+ * from the previous record in the frame, zigzag txn id, varint distance
+ * back to prev_lsn (0 for none), then a payload whose RID is a zigzag page
+ * delta from the previous record's page plus the slot number, and whose
+ * update after-image is an XOR delta against the before-image. With
+ * LOG_FRAME_LZ4 the compact bytes are LZ4 compressed as one block.
+ *
+ * The magic reads as a negative record size, so recovery tells frames from
+ * plain records, and a log may mix both. A batch whose frame would not be
+ * smaller than the plain records is written plain.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace scudb {
+
+enum class LogEncoding { RAW, COMPACT, COMPACT_LZ4 };
+
+const uint32_t LOG_FRAME_MAGIC = 0xC0DEC10F;
+const uint8_t LOG_FRAME_COMPACT = 1;
+const uint8_t LOG_FRAME_LZ4 = 2;
+const size_t LOG_FRAME_HEADER_SIZE = 17;
+
+// encode the plain records [raw, raw + len) as a frame into dst. scratch
+// holds at least len bytes. Returns the frame size, or 0 if the frame would
+// not be smaller than len
+size_t EncodeLogFrame(const char *raw, size_t len, LogEncoding encoding,
+                      char *dst, char *scratch);
+
+// data holds at least 4 bytes
+bool IsLogFrame(const char *data);
+
+// total size of the frame starting at data (header must be readable)
+size_t LogFrameSize(const char *data);
+
+// decode a whole frame back into plain records. scratch and dst hold at
+// least cap bytes. Returns the plain length, or 0 if the frame is corrupt
+size_t DecodeLogFrame(const char *frame, size_t size, char *dst, size_t cap,
+                      char *scratch);
+
+} // namespace scudb
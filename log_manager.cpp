@@ -0,0 +1,325 @@
+/**
+ * log_manager.cpp
+ */
+
+#include "logging/log_manager.h"
+
+namespace scudb {
+
+const uint64_t LogManager::COUNT_ONE;
+const uint64_t LogManager::OFFSET_MASK;
+const uint64_t LogManager::SEALED;
+const uint64_t LogManager::NO_STRADDLE;
+
+LogManager::LogManager(DiskManager *disk_manager, LogEncoding encoding)
+    : base_lsn_(0), persistent_lsn_(INVALID_LSN), reserve_(0), committed_(0),
+      straddle_(NO_STRADDLE), epoch_(0), flush_request_(false),
+      flushing_(false), flush_thread_(nullptr), disk_manager_(disk_manager),
+      encoding_(encoding), encode_buffer_(nullptr), encode_scratch_(nullptr),
+      log_offset_(0) {
+  log_buffer_ = new char[LOG_BUFFER_SIZE];
+  flush_buffer_ = new char[LOG_BUFFER_SIZE];
+  if (encoding_ != LogEncoding::RAW) {
+    encode_buffer_ = new char[LOG_BUFFER_SIZE];
+    encode_scratch_ = new char[LOG_BUFFER_SIZE];
+  }
+}
+
+LogManager::~LogManager() {
+  StopFlushThread();
+  delete[] log_buffer_;
+  delete[] flush_buffer_;
+  delete[] encode_buffer_;
+  delete[] encode_scratch_;
+}
+
+/*
+ * set ENABLE_LOGGING = true
+ * Start a separate thread to execute flush to disk operation periodically
+ * The flush can be triggered when the log buffer is full or buffer pool
+ * manager wants to force flush (it only happens when the flushed page has a
+ * larger LSN than persistent LSN)
+ */
+void LogManager::RunFlushThread() {
+  if (ENABLE_LOGGING)
+    return;
+  ENABLE_LOGGING = true;
+  flush_thread_ = new std::thread(&LogManager::FlushLoop, this);
+}
+
+/*
+ * Stop and join the flush thread, set ENABLE_LOGGING = false
+ */
+void LogManager::StopFlushThread() {
+  if (!ENABLE_LOGGING || flush_thread_ == nullptr)
+    return;
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    ENABLE_LOGGING = false;
+  }
+  cv_.notify_all();
+  flush_thread_->join();
+  delete flush_thread_;
+  flush_thread_ = nullptr;
+  //把缓冲区中剩余的日志写完
+  std::unique_lock<std::mutex> lock(latch_);
+  Flush(lock);
+}
+
+/*
+ * While the buffer accepts records the next LSN is in reserve_. Once a
+ * reservation has failed (or the buffer is sealed) reserve_ also counts the
+ * failed ones, whose LSNs will be reused; the next LSN is then the one of the
+ * first failure (or of the seal), which is recorded right after its fetch-add
+ */
+lsn_t LogManager::GetNextLSN() {
+  for (;;) {
+    uint64_t word = reserve_.load();
+    if ((word & OFFSET_MASK) <= LOG_BUFFER_SIZE)
+      return static_cast<lsn_t>(word >> 32);
+    uint64_t straddle = straddle_.load();
+    if (straddle != NO_STRADDLE)
+      return static_cast<lsn_t>(straddle >> 32);
+    std::this_thread::yield();
+  }
+}
+
+/*
+ * Every reservation before the first failure fit, so the first failure
+ * starts inside the buffer and later ones start past its end. Only a word
+ * starting inside the buffer is recorded: a later failure recording late
+ * could otherwise leak into the next buffer
+ */
+void LogManager::RecordStraddle(uint64_t word) {
+  if ((word & OFFSET_MASK) > LOG_BUFFER_SIZE)
+    return;
+  uint64_t expected = straddle_.load();
+  while (word < expected && !straddle_.compare_exchange_weak(expected, word))
+    ;
+}
+
+void LogManager::RequestFlush() {
+  flush_request_ = true;
+  cv_.notify_one();
+}
+
+void LogManager::FlushLoop() {
+  std::unique_lock<std::mutex> lock(latch_);
+  while (ENABLE_LOGGING) {
+    cv_.wait_for(lock, LOG_TIMEOUT,
+                 [this] { return flush_request_ || !ENABLE_LOGGING; });
+    Flush(lock);
+  }
+}
+
+/*
+ * One group commit. Sealing (adding SEALED to the offset) makes every new reservation fail, so the
+ * records in the buffer are exactly those reserved before the seal; once
+ * they are all copied the buffers are swapped, appends resume on the fresh
+ * buffer, and the sealed one is written without holding latch_.
+ *
+ * reserve_ is republished before epoch_ is bumped: an appender that saw the
+ * sealed buffer read epoch_ before its fetch-add, so it always sees the bump
+ */
+void LogManager::Flush(std::unique_lock<std::mutex> &lock) {
+  flushed_cv_.wait(lock, [this] { return !flushing_; });
+  flush_request_ = false;
+  // 只加在偏移量上,保留LSN,封存本身也记作一次失败的预留
+  uint64_t word = reserve_.fetch_add(SEALED);
+  RecordStraddle(word);
+  size_t offset = word & OFFSET_MASK;
+  if (offset == 0) {
+    straddle_ = NO_STRADDLE;
+    reserve_.store(word & ~OFFSET_MASK);
+    epoch_++;
+    flushed_cv_.notify_all();
+    return;
+  }
+  flushing_ = true;
+  lock.unlock();
+  //等待第一个放不下的记录登记完成、已预留空间的线程全部拷贝完成
+  uint64_t straddle;
+  for (;;) {
+    straddle = straddle_.load();
+    if (straddle != NO_STRADDLE &&
+        committed_.load(std::memory_order_acquire) == (straddle & OFFSET_MASK))
+      break;
+    std::this_thread::yield();
+  }
+  size_t valid = straddle & OFFSET_MASK;
+  lock.lock();
+  std::swap(log_buffer_, flush_buffer_);
+  lsn_t first = base_lsn_;
+  lsn_t next = static_cast<lsn_t>(straddle >> 32);
+  lsn_t last = next - 1;
+  base_lsn_ = next;
+  committed_ = 0;
+  straddle_ = NO_STRADDLE;
+  reserve_.store(static_cast<uint64_t>(next) << 32);
+  epoch_++;
+  flushed_cv_.notify_all();
+  lock.unlock();
+  //编码在刷盘线程上进行,追加日志的线程不受影响
+  char *out = flush_buffer_;
+  size_t out_size = valid;
+  if (encoding_ != LogEncoding::RAW) {
+    size_t n = EncodeLogFrame(flush_buffer_, valid, encoding_, encode_buffer_,
+                              encode_scratch_);
+    if (n > 0) {
+      out = encode_buffer_;
+      out_size = n;
+    }
+  }
+  disk_manager_->WriteLog(out, out_size);
+  lock.lock();
+  //批次在文件中的偏移按写入的字节数计算
+  batch_offsets_.emplace_back(first, log_offset_);
+  log_offset_ += out_size;
+  stats_.batches++;
+  stats_.raw_bytes += valid;
+  stats_.written_bytes += out_size;
+  persistent_lsn_ = last;
+  flushing_ = false;
+  flushed_cv_.notify_all();
+}
+
+/*
+ * 序列化日志记录,格式:20字节头部 + 各类型的负载
+ */
+void LogManager::SerializeLogRecord(LogRecord &log_record, char *pos) {
+  memcpy(pos, &log_record, LogRecord::HEADER_SIZE);
+  pos += LogRecord::HEADER_SIZE;
+  switch (log_record.log_record_type_) {
+  case LogRecordType::INSERT:
+    memcpy(pos, &log_record.insert_rid_, sizeof(RID));
+    log_record.insert_tuple_.SerializeTo(pos + sizeof(RID));
+    break;
+  case LogRecordType::MARKDELETE:
+  case LogRecordType::APPLYDELETE:
+  case LogRecordType::ROLLBACKDELETE:
+    memcpy(pos, &log_record.delete_rid_, sizeof(RID));
+    log_record.delete_tuple_.SerializeTo(pos + sizeof(RID));
+    break;
+  case LogRecordType::UPDATE:
+    memcpy(pos, &log_record.update_rid_, sizeof(RID));
+    pos += sizeof(RID);
+    log_record.old_tuple_.SerializeTo(pos);
+    pos += sizeof(int32_t) + log_record.old_tuple_.GetLength();
+    log_record.new_tuple_.SerializeTo(pos);
+    break;
+  case LogRecordType::NEWPAGE:
+    memcpy(pos, &log_record.prev_page_id_, sizeof(page_id_t));
+    break;
+  default:
+    break;
+  }
+}
+
+/*
+ * append a log record into log buffer
+ * you MUST set the log record's lsn within this method
+ * @return: lsn that is assigned to this log record
+ *
+ * The LSN and the byte range come from the same fetch-add, so LSN order is
+ * log order. A record that doesn't fit wakes the flush thread and retries on
+ * the next buffer. A record larger than the whole buffer would never fit and
+ * is rejected with INVALID_LSN, before it reserves any space
+ */
+lsn_t LogManager::AppendLogRecord(LogRecord &log_record) {
+  size_t size = log_record.size_;
+  if (size > LOG_BUFFER_SIZE)
+    return INVALID_LSN;
+  for (;;) {
+    uint64_t epoch = epoch_.load();
+    uint64_t word = reserve_.fetch_add(COUNT_ONE | size);
+    size_t pos = word & OFFSET_MASK;
+    if (pos + size <= LOG_BUFFER_SIZE) {
+      log_record.lsn_ = static_cast<lsn_t>(word >> 32);
+      TrackTransaction(log_record);
+      SerializeLogRecord(log_record, log_buffer_ + pos);
+      committed_.fetch_add(size, std::memory_order_release);
+      //跨过缓冲区一半时触发一次组提交
+      if (pos < LOG_BUFFER_SIZE / 2 && pos + size >= LOG_BUFFER_SIZE / 2)
+        RequestFlush();
+      return log_record.lsn_;
+    }
+    //第一个放不下的记录决定本批有效数据的长度和下一批的起始LSN
+    if (pos < SEALED)
+      RecordStraddle(word);
+    std::unique_lock<std::mutex> lock(latch_);
+    if (flush_thread_ == nullptr) {
+      if (epoch_ == epoch)
+        Flush(lock);
+      continue;
+    }
+    RequestFlush();
+    flushed_cv_.wait(lock, [&] { return epoch_ != epoch; });
+  }
+}
+
+//维护活跃事务表,只有BEGIN/COMMIT/ABORT记录需要加锁
+void LogManager::TrackTransaction(const LogRecord &log_record) {
+  LogRecordType type = log_record.log_record_type_;
+  if (type != LogRecordType::BEGIN && type != LogRecordType::COMMIT &&
+      type != LogRecordType::ABORT)
+    return;
+  std::lock_guard<std::mutex> lck(txn_latch_);
+  if (type == LogRecordType::BEGIN)
+    active_txns_[log_record.txn_id_] = log_record.lsn_;
+  else
+    active_txns_.erase(log_record.txn_id_);
+}
+
+LogStats LogManager::GetStats() {
+  std::lock_guard<std::mutex> lck(latch_);
+  return stats_;
+}
+
+std::map<txn_id_t, lsn_t> LogManager::GetActiveTransactions() {
+  std::lock_guard<std::mutex> lck(txn_latch_);
+  return active_txns_;
+}
+
+/*
+ * Offset of the batch holding lsn. Records of the batch still in the log
+ * buffer will start at the current end of the log file
+ */
+size_t LogManager::GetLogOffset(lsn_t lsn) {
+  std::lock_guard<std::mutex> lck(latch_);
+  if (lsn >= base_lsn_)
+    return log_offset_;
+  auto it = std::upper_bound(
+      batch_offsets_.begin(), batch_offsets_.end(), lsn,
+      [](lsn_t l, const std::pair<lsn_t, size_t> &b) { return l < b.first; });
+  return it == batch_offsets_.begin() ? 0 : std::prev(it)->second;
+}
+
+void LogManager::DiscardLogOffsets(lsn_t lsn) {
+  std::lock_guard<std::mutex> lck(latch_);
+  auto it = std::upper_bound(
+      batch_offsets_.begin(), batch_offsets_.end(), lsn,
+      [](lsn_t l, const std::pair<lsn_t, size_t> &b) { return l < b.first; });
+  if (it - batch_offsets_.begin() > 1)
+    batch_offsets_.erase(batch_offsets_.begin(), std::prev(it));
+}
+
+/*
+ * Wait until persistent_lsn_ >= lsn. With the flush thread running the
+ * caller only signals it and waits, so a burst of commits or write-backs is
+ * served by a single log write; without it the caller flushes itself
+ */
+void LogManager::WaitForFlush(lsn_t lsn) {
+  if (lsn == INVALID_LSN || persistent_lsn_ >= lsn)
+    return;
+  std::unique_lock<std::mutex> lock(latch_);
+  while (persistent_lsn_ < lsn && lsn < GetNextLSN()) {
+    if (flush_thread_ == nullptr) {
+      Flush(lock);
+      continue;
+    }
+    RequestFlush();
+    flushed_cv_.wait(lock);
+  }
+}
+
+} // namespace scudb
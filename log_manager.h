@@ -0,0 +1,145 @@
+/**
+ * log_manager.h
+ * log manager maintain a separate thread that is awaken when the log buffer is
+ * full or time out(every X second) to write log buffer's content into disk log
+ * file.
+ *
+ * Appends don't take a lock: a thread reserves its LSN and its byte range in
+ * the log buffer with one atomic fetch-add on reserve_ (next LSN in the high
+ * 32 bits, byte offset in the low 32 bits) and copies its record in
+ * parallel with other threads. The flush thread seals the buffer with a
+ * fetch-add, waits until every reserved range has been copied, swaps buffers
+ * and writes the whole batch with one WriteLog, which returns once the log
+ * is synced: a group commit. It runs on a size trigger (buffer half full), a
+ * time trigger (LOG_TIMEOUT) or when someone waits for an LSN.
+ *
+ * Once one record doesn't fit, every later reservation on the buffer fails
+ * too. The LSNs those failed reservations took are handed out again on the
+ * next buffer, starting right after the last record that fit, so LSNs have
+ * no gaps.
+ *
+ * With a LogEncoding other than RAW the flush thread writes each batch as a
+ * compact, optionally LZ4 compressed, frame (see log_codec.h); appends and
+ * the in-memory record layout are unaffected.
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "disk/disk_manager.h"
+#include "logging/log_codec.h"
+#include "logging/log_record.h"
+
+namespace scudb {
+
+struct LogStats {
+  size_t batches = 0;       // WriteLog calls
+  size_t raw_bytes = 0;     // bytes of records in the fixed layout
+  size_t written_bytes = 0; // bytes written after encoding
+};
+
+class LogManager {
+public:
+  LogManager(DiskManager *disk_manager,
+             LogEncoding encoding = LogEncoding::RAW);
+
+  ~LogManager();
+
+  // spawn a separate thread to wake up periodically to flush
+  void RunFlushThread();
+  void StopFlushThread();
+
+  // append a log record into log buffer; INVALID_LSN if the record is larger
+  // than the log buffer
+  lsn_t AppendLogRecord(LogRecord &log_record);
+
+  // block until every record up to lsn is on disk. Wakes the flush thread
+  // and waits for it rather than writing the log itself, so concurrent
+  // callers (committers, buffer pool write-backs) share one write
+  void WaitForFlush(lsn_t lsn);
+
+  // transactions with a BEGIN but no COMMIT/ABORT record yet, mapped to the
+  // LSN of their BEGIN
+  std::map<txn_id_t, lsn_t> GetActiveTransactions();
+
+  // log file offset from which reading sees every record with LSN >= lsn
+  size_t GetLogOffset(lsn_t lsn);
+
+  // drop the offsets of flushed batches that end before lsn
+  void DiscardLogOffsets(lsn_t lsn);
+
+  LogStats GetStats();
+
+  // get/set helper functions
+  lsn_t GetNextLSN();
+  inline lsn_t GetPersistentLSN() { return persistent_lsn_; }
+  inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
+  inline char *GetLogBuffer() { return log_buffer_; }
+
+private:
+  static const uint64_t COUNT_ONE = uint64_t(1) << 32;
+  static const uint64_t OFFSET_MASK = COUNT_ONE - 1;
+  // added to the offset to seal the buffer; far above LOG_BUFFER_SIZE so
+  // every reservation fails, far below 2^32 so it can't carry into the count
+  static const uint64_t SEALED = uint64_t(1) << 31;
+  // straddle_ while no reservation has failed
+  static const uint64_t NO_STRADDLE = UINT64_MAX;
+
+  void FlushLoop();
+  // seal, drain and write the current buffer; called with latch_ held
+  void Flush(std::unique_lock<std::mutex> &lock);
+  void RequestFlush();
+  // remember word (a reservation that failed, or the seal) if it is the
+  // first one on the current buffer
+  void RecordStraddle(uint64_t word);
+  void TrackTransaction(const LogRecord &log_record);
+  static void SerializeLogRecord(LogRecord &log_record, char *pos);
+
+  // first lsn of the records in log_buffer_
+  std::atomic<lsn_t> base_lsn_;
+  // log records before & include persistent_lsn_ have been written to disk
+  std::atomic<lsn_t> persistent_lsn_;
+  // log buffer related
+  char *log_buffer_;
+  char *flush_buffer_;
+  std::atomic<uint64_t> reserve_;   // (next lsn << 32) | byte offset
+  std::atomic<size_t> committed_;   // bytes copied into log_buffer_
+  // reserve_ word of the first reservation that didn't fit, or of the seal
+  // when everything fit
+  std::atomic<uint64_t> straddle_;
+  std::atomic<uint64_t> epoch_;     // bumped whenever log_buffer_ is swapped
+  std::atomic<bool> flush_request_;
+  bool flushing_;
+  // latch to protect shared member variables
+  std::mutex latch_;
+  // flush thread
+  std::thread *flush_thread_;
+  // wakes the flush thread
+  std::condition_variable cv_;
+  // signalled after every buffer swap and every flush
+  std::condition_variable flushed_cv_;
+  DiskManager *disk_manager_;
+  // encoding of flushed batches; the buffers are only used by Flush
+  LogEncoding encoding_;
+  char *encode_buffer_;
+  char *encode_scratch_;
+  LogStats stats_; // protected by latch_
+  // (first lsn, file offset) of every flushed batch, protected by latch_
+  std::vector<std::pair<lsn_t, size_t>> batch_offsets_;
+  size_t log_offset_;
+  // active transaction table
+  std::mutex txn_latch_;
+  std::map<txn_id_t, lsn_t> active_txns_;
+};
+
+} // namespace scudb
@@ -0,0 +1,590 @@
+/**
+ * log_recovery.cpp
+ */
+
+#include "common/logger.h"
+#include "logging/log_recovery.h"
+#include "table/table_page.h"
+
+namespace scudb {
+
+const size_t LogRecovery::NOT_IN_FRAME;
+
+LogRecovery::LogRecovery(DiskManager *disk_manager,
+                         BufferPoolManager *buffer_pool_manager,
+                         size_t num_workers, size_t prefetch_threads,
+                         size_t queue_capacity)
+    : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager),
+      num_workers_(std::max<size_t>(num_workers, 1)),
+      num_prefetchers_(prefetch_threads),
+      queue_capacity_(std::max<size_t>(queue_capacity, 1)), redone_(0),
+      checkpoint_(nullptr), rebuilt_(0), prefetch_done_(false), unpins_(0),
+      frame_offset_(NOT_IN_FRAME) {
+  log_buffer_ = new char[LOG_BUFFER_SIZE];
+  frame_buffer_ = new char[LOG_BUFFER_SIZE];
+  frame_scratch_ = new char[LOG_BUFFER_SIZE];
+}
+
+LogRecovery::~LogRecovery() {
+  delete[] log_buffer_;
+  delete[] frame_buffer_;
+  delete[] frame_scratch_;
+}
+
+/*
+ * deserialize a log record from log buffer
+ * @return: true means deserialize succeed, otherwise can't deserialize cause
+ * incomplete log record
+ */
+bool LogRecovery::DeserializeLogRecord(const char *data,
+                                       LogRecord &log_record) {
+  int32_t type;
+  memcpy(&log_record.size_, data, sizeof(int32_t));
+  memcpy(&log_record.lsn_, data + 4, sizeof(lsn_t));
+  memcpy(&log_record.txn_id_, data + 8, sizeof(txn_id_t));
+  memcpy(&log_record.prev_lsn_, data + 12, sizeof(lsn_t));
+  memcpy(&type, data + 16, sizeof(int32_t));
+  if (log_record.size_ < LogRecord::HEADER_SIZE ||
+      log_record.lsn_ == INVALID_LSN ||
+      type <= static_cast<int32_t>(LogRecordType::INVALID) ||
+      type > static_cast<int32_t>(LogRecordType::NEWPAGE))
+    return false;
+  log_record.log_record_type_ = static_cast<LogRecordType>(type);
+  const char *pos = data + LogRecord::HEADER_SIZE;
+  switch (log_record.log_record_type_) {
+  case LogRecordType::INSERT:
+    memcpy(&log_record.insert_rid_, pos, sizeof(RID));
+    log_record.insert_tuple_.DeserializeFrom(pos + sizeof(RID));
+    break;
+  case LogRecordType::MARKDELETE:
+  case LogRecordType::APPLYDELETE:
+  case LogRecordType::ROLLBACKDELETE:
+    memcpy(&log_record.delete_rid_, pos, sizeof(RID));
+    log_record.delete_tuple_.DeserializeFrom(pos + sizeof(RID));
+    break;
+  case LogRecordType::UPDATE:
+    memcpy(&log_record.update_rid_, pos, sizeof(RID));
+    pos += sizeof(RID);
+    log_record.old_tuple_.DeserializeFrom(pos);
+    pos += sizeof(int32_t) + log_record.old_tuple_.GetLength();
+    log_record.new_tuple_.DeserializeFrom(pos);
+    break;
+  case LogRecordType::NEWPAGE:
+    memcpy(&log_record.prev_page_id_, pos, sizeof(page_id_t));
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+page_id_t LogRecovery::PageOf(LogRecord &log_record) {
+  switch (log_record.log_record_type_) {
+  case LogRecordType::INSERT:
+    return log_record.insert_rid_.GetPageId();
+  case LogRecordType::MARKDELETE:
+  case LogRecordType::APPLYDELETE:
+  case LogRecordType::ROLLBACKDELETE:
+    return log_record.delete_rid_.GetPageId();
+  case LogRecordType::UPDATE:
+    return log_record.update_rid_.GetPageId();
+  default:
+    return INVALID_PAGE_ID;
+  }
+}
+
+/*
+ * redo phase on TABLE PAGE level(table/table_page.h)
+ * read log file from the beginning to end (you must prefetch log records into
+ * log buffer to reduce unnecessary I/O operations), remember to compare
+ * page's LSN with log_record's sequence number, and also build active_txn_
+ * table & lsn_mapping_ table
+ *
+ * The scan itself is sequential and cheap; page work runs on the workers.
+ * With a checkpoint the scan starts at its scan_offset, and a record older
+ * than the checkpoint is skipped unless its page was in the dirty page table
+ * with a recLSN at or below the record's LSN. Corrupt pages that pass can't
+ * rebuild get a second pass over the whole log
+ */
+bool LogRecovery::Redo(const Checkpoint *checkpoint) {
+  redone_ = 0;
+  rebuilt_ = 0;
+  redo_pages_.clear();
+  checkpoint_ = checkpoint;
+  RedoPass(checkpoint != nullptr ? checkpoint->scan_offset : 0);
+  // 检查点之后的日志不含这些页的NEWPAGE记录,从日志开头再重做一遍这些页
+  if (checkpoint != nullptr && !corrupt_.empty()) {
+    LOG_DEBUG("redoing %zu corrupt pages from the start of the log",
+              corrupt_.size());
+    checkpoint_ = nullptr;
+    redo_pages_.swap(corrupt_);
+    RedoPass(0);
+    redo_pages_.clear();
+  }
+  checkpoint_ = nullptr;
+  stats_.redone = redone_;
+  stats_.rebuilt_pages = rebuilt_;
+  stats_.corrupt_pages = corrupt_.size();
+  for (page_id_t page_id : corrupt_)
+    LOG_DEBUG("page %d failed verification and can't be rebuilt", page_id);
+  return corrupt_.empty();
+}
+
+/*
+ * Scan the log from offset once, with fresh workers and prefetchers, and
+ * collect the pages the workers couldn't redo on into corrupt_
+ */
+void LogRecovery::RedoPass(size_t offset) {
+  active_txn_.clear();
+  lsn_mapping_.clear();
+  pending_new_page_.clear();
+  seen_pages_.clear();
+  corrupt_.clear();
+  prefetch_done_ = false;
+  workers_.clear();
+  for (size_t i = 0; i < num_workers_; i++) {
+    workers_.emplace_back(new Worker);
+    Worker *worker = workers_.back().get();
+    worker->thread = std::thread([this, worker] { RunWorker(*worker); });
+  }
+  std::vector<std::thread> prefetchers;
+  for (size_t i = 0; i < num_prefetchers_; i++)
+    prefetchers.emplace_back(&LogRecovery::RunPrefetcher, this);
+
+  ScanLog(offset, [this](LogRecord &log_record, const LogLocation &location) {
+    Analyze(log_record, location);
+  });
+
+  for (auto &worker : workers_) {
+    {
+      std::lock_guard<std::mutex> lck(worker->latch);
+      worker->done = true;
+    }
+    worker->not_empty.notify_all();
+    worker->thread.join();
+    corrupt_.insert(worker->corrupt.begin(), worker->corrupt.end());
+    rebuilt_ += worker->rebuilt;
+  }
+  workers_.clear();
+  {
+    std::lock_guard<std::mutex> lck(prefetch_latch_);
+    prefetch_done_ = true;
+  }
+  prefetch_cv_.notify_all();
+  for (auto &prefetcher : prefetchers)
+    prefetcher.join();
+  pending_new_page_.clear();
+  seen_pages_.clear();
+}
+
+/*
+ * Read the log in LOG_BUFFER_SIZE chunks. A record or frame cut by the end
+ * of the chunk is read again at the start of the next one; the log ends at
+ * the first record that doesn't deserialize, which also covers a record
+ * only half written before a crash
+ */
+void LogRecovery::ScanLog(
+    size_t offset,
+    const std::function<void(LogRecord &, const LogLocation &)> &visit) {
+  stats_ = RecoveryStats();
+  auto start = std::chrono::steady_clock::now();
+  bool end = false;
+  while (!end && disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE, offset)) {
+    size_t pos = 0;
+    while (!end && pos + LogRecord::HEADER_SIZE <= LOG_BUFFER_SIZE) {
+      const char *data = log_buffer_ + pos;
+      size_t size;
+      if (IsLogFrame(data)) {
+        size = LogFrameSize(data);
+        if (pos + size > LOG_BUFFER_SIZE)
+          break;
+        size_t len = DecodeLogFrame(data, size, frame_buffer_, LOG_BUFFER_SIZE,
+                                    frame_scratch_);
+        frame_offset_ = len > 0 ? offset + pos : NOT_IN_FRAME;
+        for (size_t inner = 0; !end && inner < len;) {
+          LogRecord log_record;
+          end = !DeserializeLogRecord(frame_buffer_ + inner, log_record);
+          if (end)
+            break;
+          Count(log_record);
+          visit(log_record, {offset + pos, inner});
+          inner += log_record.size_;
+        }
+        end = end || len == 0;
+      } else {
+        int32_t record_size;
+        memcpy(&record_size, data, sizeof(int32_t));
+        if (record_size > 0 && pos + record_size > LOG_BUFFER_SIZE)
+          break;
+        LogRecord log_record;
+        end = !DeserializeLogRecord(data, log_record);
+        if (end)
+          break;
+        size = record_size;
+        Count(log_record);
+        visit(log_record, {offset + pos, NOT_IN_FRAME});
+      }
+      if (!end)
+        pos += size;
+    }
+    stats_.log_bytes += pos;
+    if (pos == 0)
+      break; //单条记录比日志缓冲区还大,无法继续
+    offset += pos;
+  }
+  stats_.scan_seconds += std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+}
+
+RecoveryStats LogRecovery::GetStats() { return stats_; }
+
+void LogRecovery::Count(LogRecord &log_record) {
+  stats_.records++;
+  if (log_record.log_record_type_ == LogRecordType::COMMIT ||
+      log_record.log_record_type_ == LogRecordType::ABORT)
+    stats_.transactions++;
+}
+
+bool LogRecovery::NeedsRedo(lsn_t lsn, page_id_t page_id) {
+  if (!redo_pages_.empty() && redo_pages_.count(page_id) == 0)
+    return false;
+  if (checkpoint_ == nullptr || lsn >= checkpoint_->begin_lsn)
+    return true;
+  auto it = checkpoint_->dirty_pages.find(page_id);
+  return it != checkpoint_->dirty_pages.end() &&
+         (it->second == INVALID_LSN || lsn >= it->second);
+}
+
+/*
+ * Build active_txn_ and lsn_mapping_, and dispatch the page-level records
+ */
+void LogRecovery::Analyze(LogRecord &log_record, const LogLocation &location) {
+  lsn_t lsn = log_record.lsn_;
+  txn_id_t txn = log_record.txn_id_;
+  lsn_mapping_[lsn] = location;
+  LogRecordType type = log_record.log_record_type_;
+  if (type == LogRecordType::COMMIT || type == LogRecordType::ABORT) {
+    active_txn_.erase(txn);
+    pending_new_page_.erase(txn);
+    return;
+  }
+  active_txn_[txn] = lsn;
+  if (type == LogRecordType::BEGIN)
+    return;
+  if (type == LogRecordType::NEWPAGE) {
+    pending_new_page_[txn] = log_record;
+    return;
+  }
+  page_id_t page_id = PageOf(log_record);
+  // NEWPAGE只记录了前一页的id,新页的id由该事务的下一条插入记录给出
+  auto it = pending_new_page_.find(txn);
+  if (it != pending_new_page_.end() && type == LogRecordType::INSERT) {
+    LogRecord &new_page = it->second;
+    page_id_t prev = new_page.prev_page_id_;
+    if (page_id != prev) {
+      if (NeedsRedo(new_page.lsn_, page_id))
+        Dispatch({TaskType::INIT_PAGE, page_id, prev, new_page});
+      if (prev != INVALID_PAGE_ID && NeedsRedo(new_page.lsn_, prev))
+        Dispatch({TaskType::LINK_PAGE, prev, page_id, new_page});
+    }
+    pending_new_page_.erase(it);
+  }
+  if (page_id != INVALID_PAGE_ID && NeedsRedo(lsn, page_id))
+    Dispatch({TaskType::APPLY, page_id, INVALID_PAGE_ID, log_record});
+}
+
+/*
+ * Queue a task on the worker that owns its page, blocking while that queue
+ * is full so the scan never runs unboundedly ahead of the workers
+ */
+void LogRecovery::Dispatch(RedoTask &&task) {
+  Prefetch(task.page_id);
+  Worker &worker = *workers_[static_cast<uint32_t>(task.page_id) % num_workers_];
+  std::unique_lock<std::mutex> lock(worker.latch);
+  worker.not_full.wait(lock,
+                       [&] { return worker.tasks.size() < queue_capacity_; });
+  worker.tasks.push_back(std::move(task));
+  lock.unlock();
+  worker.not_empty.notify_one();
+}
+
+//只在扫描第一次遇到某页时发出预取提示;队列满时丢弃提示
+void LogRecovery::Prefetch(page_id_t page_id) {
+  if (num_prefetchers_ == 0 || !seen_pages_.insert(page_id).second)
+    return;
+  {
+    std::lock_guard<std::mutex> lck(prefetch_latch_);
+    if (prefetch_queue_.size() >= queue_capacity_)
+      return;
+    prefetch_queue_.push_back(page_id);
+  }
+  prefetch_cv_.notify_one();
+}
+
+void LogRecovery::RunPrefetcher() {
+  std::unique_lock<std::mutex> lock(prefetch_latch_);
+  for (;;) {
+    prefetch_cv_.wait(lock,
+                      [this] { return !prefetch_queue_.empty() || prefetch_done_; });
+    if (prefetch_queue_.empty())
+      return;
+    page_id_t page_id = prefetch_queue_.front();
+    prefetch_queue_.pop_front();
+    lock.unlock();
+    if (buffer_pool_manager_->FetchPage(page_id) != nullptr)
+      Unpin(page_id, false);
+    lock.lock();
+  }
+}
+
+void LogRecovery::RunWorker(Worker &worker) {
+  std::unique_lock<std::mutex> lock(worker.latch);
+  for (;;) {
+    worker.not_empty.wait(lock,
+                          [&] { return !worker.tasks.empty() || worker.done; });
+    if (worker.tasks.empty())
+      return;
+    RedoTask task = std::move(worker.tasks.front());
+    worker.tasks.pop_front();
+    lock.unlock();
+    worker.not_full.notify_one();
+    if (ApplyRedo(worker, task))
+      redone_++;
+    lock.lock();
+  }
+}
+
+/*
+ * Fetch a page for a worker. With every frame pinned, wait until a worker or
+ * prefetcher unpins one; pins held outside recovery are retried every
+ * millisecond. A page that fails verification comes back zeroed with rebuilt
+ * set if rebuild is true, else as nullptr
+ */
+Page *LogRecovery::FetchForRedo(page_id_t page_id, bool rebuild,
+                                bool &rebuilt) {
+  rebuilt = false;
+  for (;;) {
+    size_t unpins;
+    {
+      std::lock_guard<std::mutex> lck(unpin_latch_);
+      unpins = unpins_;
+    }
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    if (page != nullptr)
+      return page;
+    // 校验失败的页只能从NEWPAGE记录开始重建
+    if (buffer_pool_manager_->IsCorrupt(page_id)) {
+      if (!rebuild)
+        return nullptr;
+      page = buffer_pool_manager_->ResetPage(page_id);
+      if (page != nullptr) {
+        rebuilt = true;
+        return page;
+      }
+    }
+    std::unique_lock<std::mutex> lock(unpin_latch_);
+    unpin_cv_.wait_for(lock, std::chrono::milliseconds(1),
+                       [&] { return unpins_ != unpins; });
+  }
+}
+
+void LogRecovery::Unpin(page_id_t page_id, bool is_dirty) {
+  buffer_pool_manager_->UnpinPage(page_id, is_dirty);
+  {
+    std::lock_guard<std::mutex> lck(unpin_latch_);
+    unpins_++;
+  }
+  unpin_cv_.notify_all();
+}
+
+/*
+ * Redo an insert at the slot the log names, not wherever InsertTuple would
+ * put it now: slot numbers are RIDs that later records and indexes refer
+ * to. Uses the table page layout of table_page.h: free space pointer at 16,
+ * tuple count at 20, then (offset, size) slots; a size of 0 is an empty
+ * slot. False if the slot is taken or the tuple doesn't fit. Undo of an
+ * APPLYDELETE puts the tuple back the same way
+ */
+bool LogRecovery::RedoInsert(TablePage *page, const RID &rid,
+                             const Tuple &tuple) {
+  static const size_t FREE_SPACE_OFFSET = 16;
+  static const size_t TUPLE_COUNT_OFFSET = 20;
+  static const size_t SLOTS_OFFSET = 24;
+  char *data = page->GetData();
+  int32_t free_space, count, size;
+  memcpy(&free_space, data + FREE_SPACE_OFFSET, sizeof(int32_t));
+  memcpy(&count, data + TUPLE_COUNT_OFFSET, sizeof(int32_t));
+  int32_t slot = static_cast<int32_t>(rid.GetSlotNum());
+  char *slots = data + SLOTS_OFFSET;
+  if (slot < count) {
+    memcpy(&size, slots + slot * 8 + 4, sizeof(int32_t));
+    if (size != 0)
+      return false;
+  }
+  int32_t new_count = std::max(count, slot + 1);
+  int32_t length = tuple.GetLength();
+  if (free_space - length <
+      static_cast<int32_t>(SLOTS_OFFSET) + 8 * new_count)
+    return false;
+  //中间新增的槽位为空
+  if (new_count > count)
+    memset(slots + count * 8, 0, (new_count - count) * 8);
+  free_space -= length;
+  memcpy(data + free_space, tuple.GetData(), length);
+  memcpy(slots + slot * 8, &free_space, sizeof(int32_t));
+  memcpy(slots + slot * 8 + 4, &length, sizeof(int32_t));
+  memcpy(data + FREE_SPACE_OFFSET, &free_space, sizeof(int32_t));
+  memcpy(data + TUPLE_COUNT_OFFSET, &new_count, sizeof(int32_t));
+  return true;
+}
+
+/*
+ * Apply one task if the page hasn't seen it yet (page LSN < record LSN).
+ * A corrupt page is rebuilt by its INIT_PAGE task; until then the worker
+ * skips its tasks and remembers it. Returns whether the page changed
+ */
+bool LogRecovery::ApplyRedo(Worker &worker, RedoTask &task) {
+  bool rebuilt;
+  Page *page = FetchForRedo(task.page_id, task.type == TaskType::INIT_PAGE,
+                            rebuilt);
+  if (page == nullptr) {
+    worker.corrupt.insert(task.page_id);
+    return false;
+  }
+  //重新初始化的页不再依赖之前丢失的修改
+  if (rebuilt) {
+    worker.corrupt.erase(task.page_id);
+    worker.rebuilt++;
+  }
+  TablePage *table_page = reinterpret_cast<TablePage *>(page);
+  LogRecord &log_record = task.record;
+  bool changed = false;
+  page->WLatch();
+  if (task.type == TaskType::LINK_PAGE) {
+    //链接前一页不改变其LSN,重复执行也无妨
+    if (table_page->GetNextPageId() == INVALID_PAGE_ID) {
+      table_page->SetNextPageId(task.other_page);
+      changed = true;
+    }
+  } else if (rebuilt || page->GetLSN() < log_record.lsn_) {
+    Tuple old_tuple;
+    switch (task.type == TaskType::INIT_PAGE ? LogRecordType::NEWPAGE
+                                             : log_record.log_record_type_) {
+    case LogRecordType::NEWPAGE:
+      table_page->Init(task.page_id, PAGE_SIZE, task.other_page, nullptr,
+                       nullptr);
+      break;
+    case LogRecordType::INSERT:
+      if (!RedoInsert(table_page, log_record.insert_rid_,
+                      log_record.insert_tuple_))
+        LOG_DEBUG("redo of insert lsn %d doesn't fit slot %d of page %d",
+                  log_record.lsn_, log_record.insert_rid_.GetSlotNum(),
+                  task.page_id);
+      break;
+    case LogRecordType::MARKDELETE:
+      table_page->MarkDelete(log_record.delete_rid_, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::APPLYDELETE:
+      table_page->ApplyDelete(log_record.delete_rid_, nullptr, nullptr);
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      table_page->RollbackDelete(log_record.delete_rid_, nullptr, nullptr);
+      break;
+    case LogRecordType::UPDATE:
+      table_page->UpdateTuple(log_record.new_tuple_, old_tuple,
+                              log_record.update_rid_, nullptr, nullptr,
+                              nullptr);
+      break;
+    default:
+      break;
+    }
+    page->SetLSN(log_record.lsn_);
+    changed = true;
+  }
+  page->WUnlatch();
+  Unpin(task.page_id, changed);
+  return changed;
+}
+
+/*
+ * undo phase on TABLE PAGE level(table/table_page.h)
+ * iterate through active txn map and undo each operation
+ */
+void LogRecovery::Undo() {
+  for (auto &txn : active_txn_) {
+    lsn_t lsn = txn.second;
+    while (lsn != INVALID_LSN) {
+      auto it = lsn_mapping_.find(lsn);
+      LogRecord log_record;
+      if (it == lsn_mapping_.end() || !ReadLogRecord(it->second, log_record))
+        break;
+      ApplyUndo(log_record);
+      lsn = log_record.prev_lsn_;
+    }
+  }
+  active_txn_.clear();
+  lsn_mapping_.clear();
+}
+
+/*
+ * Read back one record. A frame is decoded once and kept while undo walks
+ * the records inside it
+ */
+bool LogRecovery::ReadLogRecord(const LogLocation &location,
+                                LogRecord &log_record) {
+  if (location.inner == NOT_IN_FRAME)
+    return disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE,
+                                  location.offset) &&
+           DeserializeLogRecord(log_buffer_, log_record);
+  if (frame_offset_ != location.offset) {
+    frame_offset_ = NOT_IN_FRAME;
+    if (!disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE, location.offset) ||
+        !IsLogFrame(log_buffer_) ||
+        DecodeLogFrame(log_buffer_, LogFrameSize(log_buffer_), frame_buffer_,
+                       LOG_BUFFER_SIZE, frame_scratch_) == 0)
+      return false;
+    frame_offset_ = location.offset;
+  }
+  return DeserializeLogRecord(frame_buffer_ + location.inner, log_record);
+}
+
+void LogRecovery::ApplyUndo(LogRecord &log_record) {
+  page_id_t page_id = PageOf(log_record);
+  if (page_id == INVALID_PAGE_ID)
+    return;
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  if (page == nullptr)
+    return;
+  TablePage *table_page = reinterpret_cast<TablePage *>(page);
+  Tuple old_tuple;
+  page->WLatch();
+  switch (log_record.log_record_type_) {
+  case LogRecordType::INSERT:
+    table_page->ApplyDelete(log_record.insert_rid_, nullptr, nullptr);
+    break;
+  case LogRecordType::MARKDELETE:
+    table_page->RollbackDelete(log_record.delete_rid_, nullptr, nullptr);
+    break;
+  case LogRecordType::APPLYDELETE:
+    //必须放回原来的RID,InsertTuple会另选空槽
+    if (!RedoInsert(table_page, log_record.delete_rid_,
+                    log_record.delete_tuple_))
+      LOG_DEBUG("undo of delete lsn %d doesn't fit slot %d of page %d",
+                log_record.lsn_, log_record.delete_rid_.GetSlotNum(), page_id);
+    break;
+  case LogRecordType::ROLLBACKDELETE:
+    table_page->MarkDelete(log_record.delete_rid_, nullptr, nullptr, nullptr);
+    break;
+  case LogRecordType::UPDATE:
+    table_page->UpdateTuple(log_record.old_tuple_, old_tuple,
+                            log_record.update_rid_, nullptr, nullptr, nullptr);
+    break;
+  default:
+    break;
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
+
+} // namespace scudb
@@ -0,0 +1,167 @@
+/**
+ * log_recovery.h
+ * read log file from disk, redo and undo
+ *
+ * Redo reads the log sequentially, once, and dispatches every page-level
+ * record to one of num_workers threads chosen by hash(page_id). All records
+ * of a page go to the same worker in log order, so per page they are applied
+ * in LSN order while different pages are redone in parallel. Workers fetch
+ * pages through the buffer pool; the first time the scan meets a page it
+ * hands it to a prefetch thread, which reads it into the pool before the
+ * page's worker gets to it. A worker that finds every frame pinned waits for
+ * another recovery thread to unpin one instead of spinning.
+ *
+ * A page that fails checksum verification, e.g. one torn between its data
+ * and trailer writes, is rebuilt from the log: its NEWPAGE record starts it
+ * over in a zeroed frame and every later record is redone on top. When the
+ * scan started at a checkpoint past that record, the pages still unrebuilt
+ * are redone once more from the start of the log.
+ *
+ * The log may mix plain records and encoded batch frames (log_codec.h);
+ * ScanLog decodes both.
+ */
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "logging/checkpoint_manager.h"
+#include "logging/log_codec.h"
+#include "logging/log_record.h"
+
+namespace scudb {
+
+class TablePage;
+
+struct RecoveryStats {
+  size_t log_bytes = 0;    // bytes of log scanned
+  size_t records = 0;      // records decoded
+  size_t transactions = 0; // COMMIT and ABORT records
+  double scan_seconds = 0; // time spent in ScanLog
+  size_t redone = 0;       // records Redo applied to a page
+  size_t rebuilt_pages = 0; // corrupt pages Redo rebuilt from the log
+  size_t corrupt_pages = 0; // corrupt pages Redo couldn't rebuild
+};
+
+class LogRecovery {
+public:
+  // where a record lives: the plain record at offset, or the record at inner
+  // in the decoded frame at offset
+  struct LogLocation {
+    size_t offset;
+    size_t inner;
+  };
+  static const size_t NOT_IN_FRAME = SIZE_MAX;
+
+  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager,
+              size_t num_workers = std::thread::hardware_concurrency(),
+              size_t prefetch_threads = 2, size_t queue_capacity = 4096);
+
+  ~LogRecovery();
+
+  // redo the whole log, or with a checkpoint only what it can't prove is on
+  // disk. ENABLE_LOGGING must be false. Returns false if a page failed
+  // verification and the log doesn't hold its NEWPAGE record, so its changes
+  // are lost (see RecoveryStats::corrupt_pages)
+  bool Redo(const Checkpoint *checkpoint = nullptr);
+
+  // roll back the transactions Redo found without a COMMIT/ABORT record
+  void Undo();
+
+  bool DeserializeLogRecord(const char *data, LogRecord &log_record);
+
+  // decode every record from offset to the end of the log, in log order
+  void ScanLog(size_t offset,
+               const std::function<void(LogRecord &, const LogLocation &)> &visit);
+
+  // stats of the last ScanLog, and of the last Redo's page work
+  RecoveryStats GetStats();
+
+private:
+  enum class TaskType { APPLY, INIT_PAGE, LINK_PAGE };
+  struct RedoTask {
+    TaskType type;
+    page_id_t page_id;    // page the task changes
+    page_id_t other_page; // INIT_PAGE: previous page, LINK_PAGE: next page
+    LogRecord record;
+  };
+  struct Worker {
+    std::mutex latch;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<RedoTask> tasks;
+    bool done = false;
+    std::thread thread;
+    // only touched by the worker until it is joined
+    std::unordered_set<page_id_t> corrupt; // pages it couldn't redo on
+    size_t rebuilt = 0;
+  };
+
+  void RedoPass(size_t offset);
+  void Count(LogRecord &log_record);
+  void Analyze(LogRecord &log_record, const LogLocation &location);
+  bool NeedsRedo(lsn_t lsn, page_id_t page_id);
+  bool ReadLogRecord(const LogLocation &location, LogRecord &log_record);
+  void Dispatch(RedoTask &&task);
+  void Prefetch(page_id_t page_id);
+  void RunWorker(Worker &worker);
+  void RunPrefetcher();
+  bool ApplyRedo(Worker &worker, RedoTask &task);
+  Page *FetchForRedo(page_id_t page_id, bool rebuild, bool &rebuilt);
+  void Unpin(page_id_t page_id, bool is_dirty);
+  static bool RedoInsert(TablePage *page, const RID &rid, const Tuple &tuple);
+  void ApplyUndo(LogRecord &log_record);
+  static page_id_t PageOf(LogRecord &log_record);
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  size_t num_workers_;
+  size_t num_prefetchers_;
+  size_t queue_capacity_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> redone_;
+  RecoveryStats stats_;
+  const Checkpoint *checkpoint_; // the one Redo is running from, if any
+  // when not empty, the only pages the running pass redoes
+  std::unordered_set<page_id_t> redo_pages_;
+  std::unordered_set<page_id_t> corrupt_; // pages the last pass couldn't redo
+  size_t rebuilt_;
+
+  // prefetch queue, hints are dropped when it is full
+  std::mutex prefetch_latch_;
+  std::condition_variable prefetch_cv_;
+  std::deque<page_id_t> prefetch_queue_;
+  bool prefetch_done_;
+  std::unordered_set<page_id_t> seen_pages_;
+
+  // pages unpinned by the workers and prefetchers, for a worker waiting for
+  // a frame of a full pool
+  std::mutex unpin_latch_;
+  std::condition_variable unpin_cv_;
+  size_t unpins_;
+
+  // for undo: transactions without COMMIT/ABORT -> last LSN, LSN -> offset
+  std::unordered_map<txn_id_t, lsn_t> active_txn_;
+  std::unordered_map<lsn_t, LogLocation> lsn_mapping_;
+  // NEWPAGE records waiting for their transaction's next insert, which
+  // names the new page: txn id -> NEWPAGE record
+  std::unordered_map<txn_id_t, LogRecord> pending_new_page_;
+  char *log_buffer_;
+  // decoded frame, and the offset it was read from
+  char *frame_buffer_;
+  char *frame_scratch_;
+  size_t frame_offset_;
+};
+
+} // namespace scudb
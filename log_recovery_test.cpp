@@ -0,0 +1,126 @@
+/**
+ * log_recovery_test.cpp
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "logging/checkpoint_manager.h"
+#include "logging/log_recovery.h"
+
+namespace scudb {
+
+static Tuple MakeTuple(int value) {
+  char buf[sizeof(int32_t) + 16];
+  int32_t len = 16;
+  memcpy(buf, &len, sizeof(len));
+  memset(buf + sizeof(int32_t), 'a' + value % 26, 16);
+  memcpy(buf + sizeof(int32_t), &value, sizeof(value));
+  Tuple tuple;
+  tuple.DeserializeFrom(buf);
+  return tuple;
+}
+
+// the table page holds count tuples, slot i being MakeTuple(i)
+static void CheckTablePage(BufferPoolManager &bpm, page_id_t page_id,
+                           int32_t count) {
+  Page *page = bpm.FetchPage(page_id);
+  ASSERT_NE(nullptr, page);
+  const char *data = page->GetData();
+  int32_t tuples;
+  memcpy(&tuples, data + 20, sizeof(int32_t));
+  EXPECT_EQ(count, tuples);
+  for (int32_t i = 0; i < std::min(count, tuples); i++) {
+    int32_t offset, size;
+    memcpy(&offset, data + 24 + i * 8, sizeof(int32_t));
+    memcpy(&size, data + 24 + i * 8 + 4, sizeof(int32_t));
+    Tuple tuple = MakeTuple(i);
+    ASSERT_EQ(tuple.GetLength(), size);
+    EXPECT_EQ(0, memcmp(tuple.GetData(), data + offset, size)) << i;
+  }
+  bpm.UnpinPage(page_id, false);
+}
+
+/*
+ * A page stays pinned while its changes are logged and a checkpoint is
+ * taken; it never reaches disk before the crash, so the checkpoint's redo
+ * point must not pass its first record
+ */
+TEST(LogRecoveryTest, CheckpointWithPinnedDirtyPage) {
+  std::string db = "log_recovery_test.db";
+  std::string log = "log_recovery_test.log";
+  std::string ckpt = "log_recovery_test.ckpt";
+  remove(db.c_str());
+  remove(log.c_str());
+  remove(ckpt.c_str());
+
+  page_id_t pinned_id, unpinned_id;
+  lsn_t first_lsn;
+  {
+    DiskManager disk_manager(db);
+    LogManager log_manager(&disk_manager);
+    log_manager.RunFlushThread();
+    BufferPoolManager bpm(16, &disk_manager, &log_manager);
+    CheckpointManager checkpoint_manager(ckpt, &log_manager, &bpm);
+
+    // pinned until the crash
+    ASSERT_NE(nullptr, bpm.NewPage(pinned_id));
+    LogRecord begin(0, INVALID_LSN, LogRecordType::BEGIN);
+    lsn_t prev = log_manager.AppendLogRecord(begin);
+    LogRecord new_page(0, prev, LogRecordType::NEWPAGE, INVALID_PAGE_ID);
+    prev = first_lsn = log_manager.AppendLogRecord(new_page);
+    for (int i = 0; i < 3; i++) {
+      LogRecord insert(0, prev, LogRecordType::INSERT, RID(pinned_id, i),
+                       MakeTuple(i));
+      prev = log_manager.AppendLogRecord(insert);
+    }
+
+    // dirty and unpinned, with a later recLSN
+    ASSERT_NE(nullptr, bpm.NewPage(unpinned_id));
+    LogRecord next_page(0, prev, LogRecordType::NEWPAGE, pinned_id);
+    prev = log_manager.AppendLogRecord(next_page);
+    LogRecord insert(0, prev, LogRecordType::INSERT, RID(unpinned_id, 0),
+                     MakeTuple(0));
+    prev = log_manager.AppendLogRecord(insert);
+    bpm.UnpinPage(unpinned_id, true);
+
+    Checkpoint checkpoint;
+    ASSERT_TRUE(checkpoint_manager.TakeCheckpoint(&checkpoint));
+    ASSERT_EQ(1, checkpoint.dirty_pages.count(pinned_id));
+    EXPECT_LE(checkpoint.dirty_pages[pinned_id], first_lsn);
+    EXPECT_EQ(1, checkpoint.dirty_pages.count(unpinned_id));
+    EXPECT_LE(checkpoint.redo_lsn, first_lsn);
+    EXPECT_EQ(1, checkpoint.active_txns.count(0));
+
+    LogRecord last(0, prev, LogRecordType::INSERT, RID(pinned_id, 3),
+                   MakeTuple(3));
+    prev = log_manager.AppendLogRecord(last);
+    LogRecord commit(0, prev, LogRecordType::COMMIT);
+    log_manager.WaitForFlush(log_manager.AppendLogRecord(commit));
+    log_manager.StopFlushThread();
+    // crash: neither page is written back
+  }
+
+  {
+    DiskManager disk_manager(db);
+    Checkpoint checkpoint;
+    ASSERT_TRUE(CheckpointManager::Load(ckpt, checkpoint));
+    EXPECT_EQ(1, checkpoint.dirty_pages.count(pinned_id));
+    BufferPoolManager bpm(16, &disk_manager);
+    LogRecovery recovery(&disk_manager, &bpm);
+    ASSERT_TRUE(recovery.Redo(&checkpoint));
+    // both NEWPAGEs, the link from the first page and all five inserts
+    EXPECT_EQ(8, recovery.GetStats().redone);
+    CheckTablePage(bpm, pinned_id, 4);
+    CheckTablePage(bpm, unpinned_id, 1);
+  }
+  remove(db.c_str());
+  remove(log.c_str());
+  remove(ckpt.c_str());
+}
+
+} // namespace scudb
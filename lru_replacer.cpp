@@ -59,6 +59,39 @@ template <typename T> bool LRUReplacer<T>::Victim(T &value) {
   return true;
 }
 
+/*
+ * Walk from the tail towards the head and evict the first of the scan_limit
+ * coldest values that satisfies pred. Skipped values stay where they are
+ */
+template <typename T>
+bool LRUReplacer<T>::Victim(T &value, const function<bool(const T &)> &pred,
+                            size_t scan_limit) {
+  lock_guard<mutex> lck(latch);
+  shared_ptr<Node> cur = tail->prev;
+  for (size_t i = 0; i < scan_limit && cur != head; i++, cur = cur->prev) {
+    if (!pred(cur->val))
+      continue;
+    cur->prev->next = cur->next;
+    cur->next->prev = cur->prev;
+    value = cur->val;
+    map.erase(cur->val);
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Copy up to n values from the tail of LRU, coldest first
+ */
+template <typename T> size_t LRUReplacer<T>::Peek(vector<T> &values, size_t n) {
+  lock_guard<mutex> lck(latch);
+  values.clear();
+  for (shared_ptr<Node> cur = tail->prev; values.size() < n && cur != head;
+       cur = cur->prev)
+    values.push_back(cur->val);
+  return values.size();
+}
+
 /*
  * Remove value from LRU. If removal is successful, return true, otherwise
  * return false
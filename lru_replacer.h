@@ -13,12 +13,12 @@
 #include <memory>
 #include <unordered_map>
 #include <mutex>
-#include "buffer/replacer.h"
+#include "buffer/scan_replacer.h"
 
 using namespace std;
 namespace scudb {
 
-template <typename T> class LRUReplacer : public Replacer<T> {
+template <typename T> class LRUReplacer : public ScanReplacer<T> {
   struct Node {
     Node() {};
     Node(T val) : val(val) {};
@@ -27,7 +27,8 @@ template <typename T> class LRUReplacer : public Replacer<T> {
     shared_ptr<Node> next;//指向下一个节点
   };
 public:
-  // do not change public interface
+  // the Replacer interface, plus the ScanReplacer scan (Victim with a
+  // predicate, Peek) the buffer pool uses
   LRUReplacer();
 
   ~LRUReplacer();
@@ -36,6 +37,11 @@ public:
 
   bool Victim(T &value);
 
+  bool Victim(T &value, const function<bool(const T &)> &pred,
+              size_t scan_limit);
+
+  size_t Peek(vector<T> &values, size_t n);
+
   bool Erase(const T &value);
 
   size_t Size();
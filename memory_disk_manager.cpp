@@ -0,0 +1,239 @@
+/**
+ * memory_disk_manager.cpp
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#include "disk/memory_disk_manager.h"
+
+namespace scudb {
+
+const size_t MemoryDiskManager::CHUNK_SLOTS;
+const size_t MemoryDiskManager::SLOT_LATCHES;
+const int64_t MemoryDiskManager::LOG_SLOT;
+const int64_t MemoryDiskManager::FLUSH_SLOT;
+
+DeviceProfile DeviceProfile::Ram() {
+  DeviceProfile profile;
+  profile.name = "ram";
+  return profile;
+}
+
+DeviceProfile DeviceProfile::Nvme() {
+  DeviceProfile profile;
+  profile.name = "nvme";
+  profile.read_us = 80;
+  profile.write_us = 15;
+  profile.sigma = 0.25;
+  profile.bandwidth_mb_s = 3000;
+  profile.channels = 32;
+  return profile;
+}
+
+DeviceProfile DeviceProfile::SataSsd() {
+  DeviceProfile profile;
+  profile.name = "ssd";
+  profile.read_us = 120;
+  profile.write_us = 60;
+  profile.sigma = 0.35;
+  profile.bandwidth_mb_s = 520;
+  profile.channels = 8;
+  return profile;
+}
+
+DeviceProfile DeviceProfile::Hdd() {
+  DeviceProfile profile;
+  profile.name = "hdd";
+  profile.read_us = 50;
+  profile.write_us = 50;
+  profile.sigma = 0.1;
+  profile.bandwidth_mb_s = 160;
+  profile.channels = 1;
+  profile.seek_us = 16000;
+  profile.rotation_us = 8333;
+  return profile;
+}
+
+DeviceProfile DeviceProfile::ByName(const std::string &name) {
+  if (name == "nvme")
+    return Nvme();
+  if (name == "ssd")
+    return SataSsd();
+  if (name == "hdd")
+    return Hdd();
+  return Ram();
+}
+
+MemoryDiskManager::MemoryDiskManager(const DeviceProfile &profile,
+                                     uint64_t seed, size_t queue_depth)
+    : DiskManager("memory:" + profile.name, queue_depth), profile_(profile),
+      rng_(seed), channels_(std::max<size_t>(profile.channels, 1)),
+      bus_(Clock::now()), head_(LOG_SLOT) {}
+
+// the I/O workers of the base class call the hooks below, so they have to
+// be stopped while the storage still exists
+MemoryDiskManager::~MemoryDiskManager() { StopWorkers(); }
+
+DeviceStats MemoryDiskManager::GetDeviceStats() {
+  std::lock_guard<std::mutex> lock(device_latch_);
+  return stats_;
+}
+
+bool MemoryDiskManager::ReadRaw(int64_t slot, char *data, char *trailer) {
+  Emulate(false, slot, PAGE_SIZE + TRAILER_SIZE);
+  storage_latch_.RLock();
+  if (static_cast<size_t>(slot / CHUNK_SLOTS) < chunks_.size()) {
+    std::lock_guard<std::mutex> lock(slot_latches_[slot % SLOT_LATCHES]);
+    memcpy(data, Slot(slot), PAGE_SIZE);
+    memcpy(trailer, Trailer(slot), TRAILER_SIZE);
+  } else {
+    memset(data, 0, PAGE_SIZE);
+    memset(trailer, 0, TRAILER_SIZE);
+  }
+  storage_latch_.RUnlock();
+  return true;
+}
+
+/*
+ * The shared storage latch only keeps the chunks in place. Nothing above
+ * keeps accesses to one slot apart: a migration reads a page while it is
+ * written back, and ReadPage/WritePage callers outside the buffer pool can
+ * hit the same page at once. So the copy itself holds the slot's latch
+ */
+bool MemoryDiskManager::WriteRaw(int64_t slot, const char *data,
+                                 const char *trailer) {
+  Emulate(true, slot, PAGE_SIZE + TRAILER_SIZE);
+  storage_latch_.RLock();
+  bool ok = static_cast<size_t>(slot / CHUNK_SLOTS) < chunks_.size();
+  if (ok) {
+    std::lock_guard<std::mutex> lock(slot_latches_[slot % SLOT_LATCHES]);
+    memcpy(Slot(slot), data, PAGE_SIZE);
+    memcpy(Trailer(slot), trailer, TRAILER_SIZE);
+  }
+  storage_latch_.RUnlock();
+  return ok;
+}
+
+/*
+ * Growing is free on the emulated device, like a preallocation
+ */
+bool MemoryDiskManager::GrowRaw(int64_t, int64_t pages) {
+  storage_latch_.WLock();
+  while (static_cast<int64_t>(chunks_.size() * CHUNK_SLOTS) < pages)
+    chunks_.emplace_back(new char[CHUNK_SLOTS * (PAGE_SIZE + TRAILER_SIZE)]());
+  storage_latch_.WUnlock();
+  return true;
+}
+
+// the write, then the sync that makes it durable
+bool MemoryDiskManager::AppendLog(const char *log_data, size_t size) {
+  Emulate(true, LOG_SLOT, size);
+  {
+    std::lock_guard<std::mutex> lock(log_latch_);
+    log_.insert(log_.end(), log_data, log_data + size);
+  }
+  Emulate(true, FLUSH_SLOT, 0);
+  return true;
+}
+
+int64_t MemoryDiskManager::LogSize() {
+  std::lock_guard<std::mutex> lock(log_latch_);
+  return log_.size();
+}
+
+ssize_t MemoryDiskManager::ReadLogAt(char *log_data, size_t size,
+                                     off_t offset) {
+  Emulate(false, LOG_SLOT, size);
+  std::lock_guard<std::mutex> lock(log_latch_);
+  if (offset >= static_cast<off_t>(log_.size()))
+    return 0;
+  size_t n = std::min(size, log_.size() - offset);
+  memcpy(log_data, log_.data() + offset, n);
+  return n;
+}
+
+/*
+ * The storage is always "durable"; a sync only costs its flush, and starting
+ * writeback costs nothing
+ */
+bool MemoryDiskManager::SyncFile(size_t, bool wait) {
+  if (wait)
+    Emulate(true, FLUSH_SLOT, 0);
+  return true;
+}
+
+/*
+ * Charge one request to the device model and wait until it would have
+ * completed. The request takes the channel that frees up first and, once
+ * served, has to get its bytes through the shared bandwidth; it completes
+ * when both are done. Only the delay computation is serialized: the waiting
+ * happens outside the latch, so up to channels requests are in flight
+ */
+void MemoryDiskManager::Emulate(bool write, int64_t slot, size_t bytes) {
+  if (profile_.read_us == 0 && profile_.write_us == 0 &&
+      profile_.bandwidth_mb_s == 0 && profile_.seek_us == 0)
+    return;
+  Clock::time_point finish;
+  {
+    std::lock_guard<std::mutex> lock(device_latch_);
+    Clock::time_point now = Clock::now();
+    double median = write ? profile_.write_us : profile_.read_us;
+    double service = median;
+    if (profile_.sigma > 0) {
+      std::normal_distribution<double> normal(0, profile_.sigma);
+      service = median * std::exp(normal(rng_));
+    }
+    // 顺序访问(包括日志追加)不寻道
+    if (profile_.seek_us > 0 && slot >= 0 && slot != head_ + 1) {
+      int64_t distance = head_ == LOG_SLOT ? profile_.seek_span_pages
+                                           : std::abs(slot - head_);
+      double fraction = std::min(
+          1.0, static_cast<double>(distance) / profile_.seek_span_pages);
+      std::uniform_real_distribution<double> angle(0, 1);
+      double seek = profile_.seek_us * std::sqrt(fraction) +
+                    profile_.rotation_us * angle(rng_);
+      service += seek;
+      stats_.seek_us += seek;
+    }
+    if (slot != FLUSH_SLOT)
+      head_ = slot;
+
+    auto channel = std::min_element(channels_.begin(), channels_.end());
+    Clock::time_point start = std::max(now, *channel);
+    finish = start + std::chrono::nanoseconds(
+                         static_cast<int64_t>(service * 1000));
+    if (profile_.bandwidth_mb_s > 0) {
+      // MB/s 即每微秒的字节数
+      bus_ = std::max(bus_, start) +
+             std::chrono::nanoseconds(static_cast<int64_t>(
+                 bytes * 1000 / profile_.bandwidth_mb_s));
+      finish = std::max(finish, bus_);
+    }
+    if (profile_.channels > 0)
+      *channel = finish;
+
+    if (slot == FLUSH_SLOT)
+      stats_.flushes++;
+    else if (slot == LOG_SLOT && write)
+      stats_.log_writes++;
+    else if (write)
+      stats_.writes++;
+    else
+      stats_.reads++;
+    stats_.service_us += service;
+    stats_.queue_us +=
+        std::chrono::duration<double, std::micro>(finish - now).count() -
+        service;
+  }
+  // 长等待先睡,最后一小段自旋以保证微秒级精度
+  const auto spin = std::chrono::microseconds(50);
+  Clock::time_point now = Clock::now();
+  if (finish - now > spin)
+    std::this_thread::sleep_for(finish - now - spin);
+  while (Clock::now() < finish)
+    std::this_thread::yield();
+}
+
+} // namespace scudb
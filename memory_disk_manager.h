@@ -0,0 +1,124 @@
+/**
+ * memory_disk_manager.h
+ *
+ * Functionality: A DiskManager that keeps the database and the log in
+ * memory and makes every access take as long as it would on an emulated
+ * device, so buffer pool, prefetch and log flusher benchmarks show I/O-bound
+ * behavior without a real disk.
+ *
+ * The device model (DeviceProfile) has:
+ *  - a service time per read and per write, drawn from a lognormal
+ *    distribution around a median;
+ *  - channels: how many requests the device serves at once. A request that
+ *    finds every channel busy waits for the first one to free up, so delays
+ *    grow with the queue depth the caller drives;
+ *  - a bandwidth cap shared by all channels;
+ *  - for rotating disks, a seek that grows with the square root of the
+ *    distance from the previous request, plus a random part of a rotation.
+ *    Sequential accesses skip both.
+ * Service times come from a seeded generator, so the same sequence of
+ * requests sees the same delays in every run. The log is modeled as a
+ * sequential stream on the same device, and a sync (see
+ * DiskManager::SyncUpTo) as one write-sized cache flush.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/rwmutex.h"
+#include "disk/disk_manager.h"
+
+namespace scudb {
+
+struct DeviceProfile {
+  std::string name;
+  double read_us = 0;        // median service time of a page read
+  double write_us = 0;       // median service time of a page write
+  double sigma = 0;          // lognormal shape of service times, 0: fixed
+  double bandwidth_mb_s = 0; // transfer cap, 0: unlimited
+  size_t channels = 0;       // requests served in parallel, 0: unlimited
+  double seek_us = 0;        // seek across seek_span_pages, 0: no seeks
+  double rotation_us = 0;    // one revolution
+  int64_t seek_span_pages = 1 << 22;
+
+  // no delays at all
+  static DeviceProfile Ram();
+  static DeviceProfile Nvme();
+  static DeviceProfile SataSsd();
+  static DeviceProfile Hdd();
+  // one of "ram", "nvme", "ssd", "hdd"; Ram() for anything else
+  static DeviceProfile ByName(const std::string &name);
+};
+
+struct DeviceStats {
+  size_t reads = 0;
+  size_t writes = 0;
+  size_t log_writes = 0;
+  size_t flushes = 0;    // syncs of the page storage and of the log
+  double service_us = 0; // emulated service time of all requests
+  double queue_us = 0;   // time requests waited for a channel or bandwidth
+  double seek_us = 0;    // part of service_us spent seeking
+};
+
+class MemoryDiskManager : public DiskManager {
+public:
+  explicit MemoryDiskManager(const DeviceProfile &profile = DeviceProfile::Ram(),
+                             uint64_t seed = 42, size_t queue_depth = 32);
+  ~MemoryDiskManager();
+
+  DeviceStats GetDeviceStats();
+
+protected:
+  bool ReadRaw(int64_t slot, char *data, char *trailer) override;
+  bool WriteRaw(int64_t slot, const char *data, const char *trailer) override;
+  bool GrowRaw(int64_t slot, int64_t pages) override;
+  bool AppendLog(const char *log_data, size_t size) override;
+  int64_t LogSize() override;
+  ssize_t ReadLogAt(char *log_data, size_t size, off_t offset) override;
+  bool SyncFile(size_t file, bool wait) override;
+
+private:
+  typedef std::chrono::steady_clock Clock;
+  static const size_t CHUNK_SLOTS = 1024;
+  // latches serializing the copies of a slot, striped by slot number
+  static const size_t SLOT_LATCHES = 64;
+  // log position in the device model, never sought to
+  static const int64_t LOG_SLOT = -1;
+  // cache flush in the device model, leaves the head where it is
+  static const int64_t FLUSH_SLOT = -2;
+
+  void Emulate(bool write, int64_t slot, size_t bytes);
+  // a chunk holds CHUNK_SLOTS pages, then their trailers
+  inline char *Slot(int64_t slot) {
+    return chunks_[slot / CHUNK_SLOTS].get() + slot % CHUNK_SLOTS * PAGE_SIZE;
+  }
+  inline char *Trailer(int64_t slot) {
+    return chunks_[slot / CHUNK_SLOTS].get() + CHUNK_SLOTS * PAGE_SIZE +
+           slot % CHUNK_SLOTS * TRAILER_SIZE;
+  }
+
+  DeviceProfile profile_;
+  // page slots in chunks that never move; growing takes the write lock
+  RWMutex storage_latch_;
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  // a read or write of a slot copies it under slot_latches_[slot %
+  // SLOT_LATCHES], so a page is never seen half written
+  std::mutex slot_latches_[SLOT_LATCHES];
+  std::mutex log_latch_;
+  std::vector<char> log_;
+  // device model, protected by device_latch_
+  std::mutex device_latch_;
+  std::mt19937_64 rng_;
+  std::vector<Clock::time_point> channels_; // when each channel frees up
+  Clock::time_point bus_;                   // when the transfer cap allows more
+  int64_t head_;                            // slot of the previous access
+  DeviceStats stats_;
+};
+
+} // namespace scudb
@@ -0,0 +1,83 @@
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "buffer/memory_pressure.h"
+
+namespace scudb {
+
+MemoryPressureMonitor::MemoryPressureMonitor(const std::string &path,
+                                             std::chrono::milliseconds interval,
+                                             std::function<void(bool)> callback,
+                                             double psi_threshold)
+    : path_(path), interval_(interval), callback_(callback), psi_threshold_(psi_threshold),
+      last_events_(0), has_events_(false), running_(false) {}
+
+MemoryPressureMonitor::~MemoryPressureMonitor() { Stop(); }
+
+bool MemoryPressureMonitor::Poll() {
+    std::ifstream in(path_);
+    if (!in)
+        return false;
+    std::string line;
+    bool psi = false, pressure = false;
+    uint64_t events = 0;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "some") {
+            // PSI格式:只看最近10秒的some平均值,格式不对的字段当作没有压力
+            std::string field;
+            while (fields >> field) {
+                if (field.compare(0, 6, "avg10=") != 0)
+                    continue;
+                const char* begin = field.c_str() + 6;
+                char* end = nullptr;
+                double avg10 = std::strtod(begin, &end);
+                pressure = end != begin && *end == '\0' && avg10 >= psi_threshold_;
+            }
+            psi = true;
+        } else if (key == "high" || key == "max" || key == "oom") {
+            uint64_t count = 0;
+            fields >> count;
+            events += count;
+        }
+    }
+    if (psi)
+        return pressure;
+    //memory.events格式:计数器自上次读取后增长即视为有压力
+    pressure = has_events_ && events > last_events_;
+    last_events_ = events;
+    has_events_ = true;
+    return pressure;
+}
+
+void MemoryPressureMonitor::Start() {
+    std::lock_guard<std::mutex> lck(latch_);
+    if (running_)
+        return;
+    running_ = true;
+    thread_ = std::thread([this] {
+        std::unique_lock<std::mutex> lock(latch_);
+        while (running_) {
+            lock.unlock();
+            callback_(Poll());
+            lock.lock();
+            cv_.wait_for(lock, interval_, [this] { return !running_; });
+        }
+    });
+}
+
+void MemoryPressureMonitor::Stop() {
+    {
+        std::lock_guard<std::mutex> lck(latch_);
+        if (!running_)
+            return;
+        running_ = false;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+}  // namespace scudb
@@ -0,0 +1,55 @@
+/**
+ * memory_pressure.h
+ *
+ * Functionality: Polls a Linux memory pressure source and reports whether
+ * the process is under pressure. Two formats are understood:
+ *  - PSI (/proc/pressure/memory or a cgroup's memory.pressure):
+ *      some avg10=1.23 avg60=0.50 avg300=0.10 total=12345
+ *    pressure when "some avg10" is at least psi_threshold percent;
+ *  - cgroup v2 memory.events:
+ *      low 0 / high 12 / max 0 / oom 0 / oom_kill 0
+ *    pressure when the high, max or oom counter grew since the last poll.
+ * Any local file in one of these formats can stand in for the kernel's, which
+ * is how tests simulate pressure.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace scudb {
+
+class MemoryPressureMonitor {
+public:
+    // callback is called from the monitor thread after every poll
+    MemoryPressureMonitor(const std::string &path, std::chrono::milliseconds interval,
+                          std::function<void(bool)> callback, double psi_threshold = 10.0);
+    ~MemoryPressureMonitor();
+
+    void Start();
+    void Stop();
+
+    // read the source once; true if under pressure
+    bool Poll();
+
+private:
+    std::string path_;
+    std::chrono::milliseconds interval_;
+    std::function<void(bool)> callback_;
+    double psi_threshold_;
+    uint64_t last_events_;  // memory.events中high+max+oom的上次读数
+    bool has_events_;
+
+    bool running_;
+    std::mutex latch_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
+
+}  // namespace scudb
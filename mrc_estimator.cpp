@@ -0,0 +1,128 @@
+#include <algorithm>
+
+#include "buffer/mrc_estimator.h"
+
+namespace scudb {
+
+MrcEstimator::MrcEstimator(double sample_rate, size_t max_tracked, size_t max_cache_pages,
+                           size_t buckets)
+    : max_tracked_(max_tracked == 0 ? 1 : max_tracked), clock_(0), total_(0),
+      expected_(0) {
+    sample_rate = std::min(std::max(sample_rate, 1.0 / MODULUS), 1.0);
+    threshold_ = static_cast<uint64_t>(sample_rate * MODULUS);
+    if (buckets == 0)
+        buckets = 1;
+    bucket_width_ = std::max<size_t>(1, (max_cache_pages + buckets - 1) / buckets);
+    hist_.assign(buckets + 1, 0);
+    bit_.assign(4 * max_tracked_ + 1, 0);
+}
+
+/*
+ * splitmix64,保证页号连续时采样依然均匀
+ */
+uint64_t MrcEstimator::Hash(page_id_t page_id) {
+    uint64_t x = static_cast<uint64_t>(page_id) + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return (x ^ (x >> 31)) % MODULUS;
+}
+
+void MrcEstimator::BitAdd(size_t pos, int delta) {
+    for (; pos < bit_.size(); pos += pos & (~pos + 1))
+        bit_[pos] += delta;
+}
+
+int MrcEstimator::BitSum(size_t pos) const {
+    int sum = 0;
+    for (; pos > 0; pos -= pos & (~pos + 1))
+        sum += bit_[pos];
+    return sum;
+}
+
+/*
+ * Record one access. Only sampled pages do any work beyond the hash
+ */
+void MrcEstimator::Access(page_id_t page_id) {
+    uint64_t h = Hash(page_id);
+    expected_ += GetSampleRate();
+    if (h >= threshold_)
+        return;
+    if (clock_ + 1 >= bit_.size())
+        Compact();
+    uint64_t now = ++clock_;
+    double rate = GetSampleRate();
+    total_ += 1;
+    auto it = last_.find(page_id);
+    if (it == last_.end()) {
+        last_[page_id] = now;
+        by_hash_.emplace(h, page_id);
+        BitAdd(now, 1);
+        if (last_.size() > max_tracked_)
+            Evict();
+        return;
+    }
+    //重用距离:上次访问之后被访问过的不同采样页面数,按采样率放大
+    uint64_t prev = it->second;
+    double distance = (BitSum(now - 1) - BitSum(prev)) / rate;
+    size_t bucket = std::min<size_t>(distance / bucket_width_, hist_.size() - 1);
+    hist_[bucket] += 1;
+    BitAdd(prev, -1);
+    BitAdd(now, 1);
+    it->second = now;
+}
+
+/*
+ * Drop the sampled pages with the largest hash and lower the threshold to
+ * it. Counts gathered at the old rate are rescaled to the new one
+ */
+void MrcEstimator::Evict() {
+    uint64_t old_threshold = threshold_;
+    threshold_ = by_hash_.rbegin()->first;
+    while (!by_hash_.empty() && by_hash_.rbegin()->first >= threshold_) {
+        page_id_t victim = by_hash_.rbegin()->second;
+        by_hash_.erase(std::prev(by_hash_.end()));
+        BitAdd(last_[victim], -1);
+        last_.erase(victim);
+    }
+    double scale = double(threshold_) / old_threshold;
+    for (auto &count : hist_)
+        count *= scale;
+    total_ *= scale;
+    expected_ *= scale;
+}
+
+/*
+ * 访问时间用完时重新编号:存活页面按原先的先后顺序映射到1..n
+ */
+void MrcEstimator::Compact() {
+    std::vector<std::pair<uint64_t, page_id_t>> live;
+    live.reserve(last_.size());
+    for (auto &entry : last_)
+        live.emplace_back(entry.second, entry.first);
+    std::sort(live.begin(), live.end());
+    std::fill(bit_.begin(), bit_.end(), 0);
+    clock_ = 0;
+    for (auto &entry : live) {
+        last_[entry.second] = ++clock_;
+        BitAdd(clock_, 1);
+    }
+}
+
+std::vector<std::pair<size_t, double>> MrcEstimator::GetCurve() const {
+    std::vector<std::pair<size_t, double>> curve;
+    if (total_ <= 0 || expected_ <= 0)
+        return curve;
+    //容量为(i+1)*bucket_width_时,距离落在第i格之后的访问都是miss;
+    //期望与实际采样数之差计入第0格
+    double misses = expected_;
+    for (size_t i = 0; i + 1 < hist_.size(); i++) {
+        misses -= hist_[i];
+        if (i == 0)
+            misses -= expected_ - total_;
+        curve.emplace_back((i + 1) * bucket_width_,
+                           std::min(1.0, std::max(0.0, misses / expected_)));
+    }
+    return curve;
+}
+
+}  // namespace scudb
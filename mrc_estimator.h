@@ -0,0 +1,71 @@
+/**
+ * mrc_estimator.h
+ *
+ * Functionality: Online miss-ratio-curve estimation with spatial sampling
+ * (fixed-size SHARDS). A page is tracked only if hash(page_id) falls under a
+ * threshold, so the sampled pages are a uniform fraction R of all pages. For
+ * every access to a sampled page the reuse distance (distinct sampled pages
+ * touched since its previous access) is measured with a Fenwick tree over
+ * access times, scaled by 1/R and added to a histogram. When more than
+ * max_tracked pages are sampled, the page with the largest hash is dropped
+ * and the threshold lowered to it, which keeps memory bounded; histogram
+ * counts are rescaled to the new rate. As in SHARDS_adj, the difference
+ * between the expected (accesses * R) and actual number of sampled accesses
+ * is credited to the first bucket, which corrects for very hot pages falling
+ * in or out of the sample.
+ *
+ * Not thread-safe; the buffer pool calls it under its latch.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/config.h"
+
+namespace scudb {
+
+class MrcEstimator {
+public:
+    // sample_rate: initial fraction of pages sampled
+    // max_tracked: upper bound on sampled pages kept at any time
+    // max_cache_pages: largest pool size the curve covers
+    // buckets: histogram resolution
+    MrcEstimator(double sample_rate, size_t max_tracked, size_t max_cache_pages,
+                 size_t buckets = 256);
+
+    void Access(page_id_t page_id);
+
+    // (pool size in pages, estimated miss ratio), one point per bucket
+    std::vector<std::pair<size_t, double>> GetCurve() const;
+
+    double GetSampleRate() const { return double(threshold_) / MODULUS; }
+
+private:
+    static const uint64_t MODULUS = 1 << 24;
+
+    static uint64_t Hash(page_id_t page_id);
+    void Evict();
+    void Compact();
+    void BitAdd(size_t pos, int delta);
+    int BitSum(size_t pos) const;  // 时间1..pos中仍存活的页面数
+
+    uint64_t threshold_;  // hash < threshold_的页面被采样
+    size_t max_tracked_;
+    size_t bucket_width_;
+
+    uint64_t clock_;                                    // 采样访问的逻辑时间,从1开始
+    std::unordered_map<page_id_t, uint64_t> last_;      // 页面 -> 最近一次访问时间
+    std::set<std::pair<uint64_t, page_id_t>> by_hash_;  // 按hash排序,用于淘汰
+    std::vector<int> bit_;                              // Fenwick树,下标为访问时间
+
+    std::vector<double> hist_;  // 重用距离直方图,最后一格为超出范围的距离
+    double total_;              // 实际采样的访问数,首次访问计为miss
+    double expected_;  // 所有访问按当时采样率累加的期望采样数
+};
+
+}  // namespace scudb
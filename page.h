@@ -0,0 +1,60 @@
+/**
+ * page.h
+ *
+ * Wrapper around actual data page in main memory and also contains bookkeeping
+ * information used by buffer pool manager like pin_count/dirty_flag/page_id.
+ * Use page as a basic unit within the database system
+ *
+ * The page content is not part of the object: the buffer pool points data_ at
+ * its frame in one page-aligned arena, so the memory of a frame can be handed
+ * back to the kernel (madvise) without touching the bookkeeping fields. A
+ * page of a larger size class holds GetSize() bytes, a whole block of
+ * consecutive page ids.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <iostream>
+
+#include "common/config.h"
+#include "common/rwmutex.h"
+
+namespace scudb {
+
+class Page {
+  friend class BufferPoolManager;
+
+public:
+  Page() : data_(nullptr), size_(PAGE_SIZE) {}
+  ~Page(){};
+  // get actual data page content
+  inline char *GetData() { return data_; }
+  // bytes of GetData(): PAGE_SIZE, or the block size of a larger size class
+  inline size_t GetSize() { return size_; }
+  // get page id
+  inline page_id_t GetPageId() { return page_id_; }
+  // get page pin count
+  inline int GetPinCount() { return pin_count_; }
+  // method use to latch/unlatch page content
+  inline void WUnlatch() { rwlatch_.WUnlock(); }
+  inline void WLatch() { rwlatch_.WLock(); }
+  inline void RUnlatch() { rwlatch_.RUnlock(); }
+  inline void RLatch() { rwlatch_.RLock(); }
+
+  inline lsn_t GetLSN() { return *reinterpret_cast<lsn_t *>(GetData() + 4); }
+  inline void SetLSN(lsn_t lsn) { memcpy(GetData() + 4, &lsn, 4); }
+
+private:
+  // method used by buffer pool manager
+  inline void ResetMemory() { memset(data_, 0, size_); }
+  // members
+  char *data_; // actual data, size_ bytes owned by the buffer pool
+  size_t size_;
+  page_id_t page_id_ = INVALID_PAGE_ID;
+  int pin_count_ = 0;
+  bool is_dirty_ = false;
+  RWMutex rwlatch_;
+};
+
+} // namespace scudb
@@ -0,0 +1,338 @@
+/**
+ * replacer_benchmark.cpp
+ *
+ * Microbenchmarks for every Replacer<T> implementation in replacer_factory.h.
+ * Built as a standalone binary against the replacer sources. The includes
+ * follow the scudb source layout (headers in src/include/buffer, sources in
+ * src/buffer); with the files in place there and this one at the root of the
+ * checkout:
+ *
+ *   g++ -O2 -std=c++17 -Isrc/include -pthread replacer_benchmark.cpp \
+ *       src/buffer/lru_replacer.cpp src/buffer/frame_lru_replacer.cpp \
+ *       src/buffer/sharded_lru_replacer.cpp src/buffer/buffered_replacer.cpp \
+ *       src/buffer/clock_replacer.cpp -o replacer_benchmark
+ *
+ * For each policy it reports, as CSV (metric,policy,param,threads,value):
+ *  - ns/op of Insert, re-Insert (touch), Erase, Victim and Size at sizes from
+ *    1K up to --max-size entries (10M with --max-size 10000000)
+ *  - heap allocations per entry and bytes per entry after filling
+ *  - Insert/Erase throughput scaling from 1 thread up to --threads
+ *  - hit ratio of a simulated pool on zipf, uniform and loop traces, and the
+ *    loss versus exact LRU
+ *
+ * Regression check: --write-baseline FILE stores the ns/op results,
+ * --baseline FILE compares against them and exits with 1 if any result is
+ * slower than the baseline by more than --tolerance (default 0.25).
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "buffer/replacer_factory.h"
+
+using namespace std;
+using namespace scudb;
+
+/*
+ * 统计堆分配次数与字节数
+ */
+static atomic<size_t> allocCount(0);
+static atomic<size_t> allocBytes(0);
+
+void *operator new(size_t n) {
+  allocCount.fetch_add(1, memory_order_relaxed);
+  allocBytes.fetch_add(n, memory_order_relaxed);
+  void *p = malloc(n == 0 ? 1 : n);
+  if (p == nullptr)
+    throw bad_alloc();
+  return p;
+}
+
+void *operator new(size_t n, align_val_t align) {
+  allocCount.fetch_add(1, memory_order_relaxed);
+  allocBytes.fetch_add(n, memory_order_relaxed);
+  size_t a = static_cast<size_t>(align);
+  void *p = aligned_alloc(a, (n + a - 1) / a * a);
+  if (p == nullptr)
+    throw bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, align_val_t) noexcept { free(p); }
+void operator delete(void *p, size_t, align_val_t) noexcept { free(p); }
+
+namespace {
+
+struct Options {
+  size_t maxSize = 1000000;
+  size_t maxThreads = max(1u, thread::hardware_concurrency());
+  size_t traceOps = 1000000;
+  string baseline;
+  string writeBaseline;
+  double tolerance = 0.25;
+};
+
+const vector<pair<ReplacerPolicy, const char *>> POLICIES = {
+    {ReplacerPolicy::LRU, "lru"},
+    {ReplacerPolicy::FRAME_LRU, "frame_lru"},
+    {ReplacerPolicy::SHARDED_LRU, "sharded_lru"},
+    {ReplacerPolicy::BUFFERED_LRU, "buffered_lru"},
+    {ReplacerPolicy::CLOCK, "clock"}};
+
+// 回归检查用:"metric/policy/param/threads" -> ns/op
+map<string, double> results;
+
+inline double Now() {
+  return chrono::duration<double, nano>(
+             chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Report(const string &metric, const char *policy, size_t param,
+            size_t threads, double value, bool regression_checked = false) {
+  printf("%s,%s,%zu,%zu,%.3f\n", metric.c_str(), policy, param, threads, value);
+  if (regression_checked)
+    results[metric + "/" + policy + "/" + to_string(param) + "/" +
+            to_string(threads)] = value;
+}
+
+/*
+ * Single-threaded ns/op and memory for one policy at one size
+ */
+void BenchOps(ReplacerPolicy policy, const char *name, size_t n) {
+  vector<int> order(n);
+  for (size_t i = 0; i < n; i++)
+    order[i] = i;
+  shuffle(order.begin(), order.end(), mt19937(42));
+
+  size_t count0 = allocCount.load(), bytes0 = allocBytes.load();
+  ScanReplacer<int> *r = MakeReplacer<int>(policy, n, 0);
+  double t0 = Now();
+  for (size_t i = 0; i < n; i++)
+    r->Insert(order[i]);
+  double t1 = Now();
+  r->Size(); // 对buffered策略而言,这一步把积压事件全部回放
+  size_t count1 = allocCount.load(), bytes1 = allocBytes.load();
+  Report("insert_ns", name, n, 1, (t1 - t0) / n, true);
+  Report("allocs_per_entry", name, n, 1, double(count1 - count0) / n);
+  Report("bytes_per_entry", name, n, 1, double(bytes1 - bytes0) / n);
+
+  t0 = Now();
+  for (size_t i = 0; i < n; i++)
+    r->Insert(order[n - 1 - i]);
+  t1 = Now();
+  Report("touch_ns", name, n, 1, (t1 - t0) / n, true);
+
+  const size_t sizeCalls = 100000;
+  volatile size_t sink = 0;
+  t0 = Now();
+  for (size_t i = 0; i < sizeCalls; i++)
+    sink = sink + r->Size();
+  t1 = Now();
+  Report("size_ns", name, n, 1, (t1 - t0) / sizeCalls, true);
+
+  t0 = Now();
+  for (size_t i = 0; i < n / 2; i++)
+    r->Erase(order[i]);
+  t1 = Now();
+  Report("erase_ns", name, n, 1, (t1 - t0) / (n / 2), true);
+
+  size_t victims = 0;
+  int v;
+  t0 = Now();
+  while (r->Victim(v))
+    victims++;
+  t1 = Now();
+  Report("victim_ns", name, n, 1, victims ? (t1 - t0) / victims : 0, true);
+  delete r;
+}
+
+/*
+ * Every thread owns a disjoint range of values and alternates Insert and
+ * Erase on it. Reports aggregate throughput in Mops/s
+ */
+void BenchScaling(ReplacerPolicy policy, const char *name, size_t n,
+                  size_t threads) {
+  ScanReplacer<int> *r = MakeReplacer<int>(policy, n, 0);
+  size_t chunk = n / threads;
+  const size_t rounds = max<size_t>(1, 2000000 / n);
+  vector<thread> workers;
+  double t0 = Now();
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([r, t, chunk, rounds] {
+      int lo = t * chunk;
+      for (size_t k = 0; k < rounds; k++) {
+        for (size_t i = 0; i < chunk; i++)
+          r->Insert(lo + i);
+        for (size_t i = 0; i < chunk; i++)
+          r->Erase(lo + i);
+      }
+    });
+  }
+  for (auto &w : workers)
+    w.join();
+  double t1 = Now();
+  double ops = 2.0 * rounds * chunk * threads;
+  Report("scaling_mops", name, n, threads, ops / (t1 - t0) * 1000.0);
+  Report("scaling_ns", name, n, threads, (t1 - t0) / ops * threads, true);
+  delete r;
+}
+
+/*
+ * 访问序列生成:zipf(0.99)、均匀分布、循环扫描
+ */
+vector<int> MakeTrace(const string &kind, size_t keys, size_t ops) {
+  vector<int> trace(ops);
+  mt19937 rng(7);
+  if (kind == "uniform") {
+    uniform_int_distribution<int> dist(0, keys - 1);
+    for (auto &k : trace)
+      k = dist(rng);
+  } else if (kind == "loop") {
+    for (size_t i = 0; i < ops; i++)
+      trace[i] = i % keys;
+  } else {
+    vector<double> cdf(keys);
+    double sum = 0;
+    for (size_t i = 0; i < keys; i++)
+      cdf[i] = (sum += 1.0 / pow(i + 1, 0.99));
+    uniform_real_distribution<double> dist(0, sum);
+    for (auto &k : trace)
+      k = lower_bound(cdf.begin(), cdf.end(), dist(rng)) - cdf.begin();
+  }
+  return trace;
+}
+
+/*
+ * Replay a trace against a pool of frames: a hit pins and unpins its frame
+ * (Erase + Insert), a miss takes a free frame or a victim
+ */
+double HitRatio(ReplacerPolicy policy, size_t frames, const vector<int> &trace) {
+  ScanReplacer<int> *r = MakeReplacer<int>(policy, frames, 0);
+  unordered_map<int, int> table;
+  vector<int> owner(frames, -1);
+  size_t used = 0, hits = 0;
+  for (int key : trace) {
+    auto it = table.find(key);
+    int frame;
+    if (it != table.end()) {
+      hits++;
+      frame = it->second;
+      r->Erase(frame);
+    } else {
+      if (used < frames) {
+        frame = used++;
+      } else if (r->Victim(frame)) {
+        table.erase(owner[frame]);
+      } else {
+        continue; // 没有可换出的frame,本次访问不缓存
+      }
+      owner[frame] = key;
+      table[key] = frame;
+    }
+    r->Insert(frame);
+  }
+  delete r;
+  return double(hits) / trace.size();
+}
+
+void BenchHitRatio(const Options &opt) {
+  for (size_t frames : {1000, 10000}) {
+    for (string kind : {"zipf", "uniform", "loop"}) {
+      size_t keys = kind == "loop" ? frames + frames / 5 : frames * 10;
+      vector<int> trace = MakeTrace(kind, keys, opt.traceOps);
+      double exact = 0;
+      for (auto &p : POLICIES) {
+        double ratio = HitRatio(p.first, frames, trace);
+        if (p.first == ReplacerPolicy::LRU)
+          exact = ratio;
+        Report("hit_ratio_" + kind, p.second, frames, 1, ratio);
+        Report("hit_loss_vs_lru_" + kind, p.second, frames, 1, exact - ratio);
+      }
+    }
+  }
+}
+
+bool CheckBaseline(const Options &opt) {
+  ifstream in(opt.baseline);
+  if (!in) {
+    fprintf(stderr, "cannot open baseline %s\n", opt.baseline.c_str());
+    return false;
+  }
+  bool ok = true;
+  string key;
+  double base;
+  while (in >> key >> base) {
+    auto it = results.find(key);
+    if (it == results.end())
+      continue;
+    if (it->second > base * (1 + opt.tolerance)) {
+      fprintf(stderr, "REGRESSION %s: %.3f ns vs baseline %.3f ns\n",
+              key.c_str(), it->second, base);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    const char *val = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--max-size")
+      opt.maxSize = strtoull(val, nullptr, 10), i++;
+    else if (arg == "--threads")
+      opt.maxThreads = strtoull(val, nullptr, 10), i++;
+    else if (arg == "--trace-ops")
+      opt.traceOps = strtoull(val, nullptr, 10), i++;
+    else if (arg == "--baseline")
+      opt.baseline = val, i++;
+    else if (arg == "--write-baseline")
+      opt.writeBaseline = val, i++;
+    else if (arg == "--tolerance")
+      opt.tolerance = strtod(val, nullptr), i++;
+    else {
+      fprintf(stderr,
+              "usage: %s [--max-size N] [--threads N] [--trace-ops N] "
+              "[--baseline FILE] [--write-baseline FILE] [--tolerance F]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  printf("metric,policy,param,threads,value\n");
+  for (auto &p : POLICIES)
+    for (size_t n = 1000; n <= opt.maxSize; n *= 10)
+      BenchOps(p.first, p.second, n);
+  for (auto &p : POLICIES)
+    for (size_t t = 1; t <= opt.maxThreads; t *= 2)
+      BenchScaling(p.first, p.second, 100000, t);
+  BenchHitRatio(opt);
+
+  if (!opt.writeBaseline.empty()) {
+    ofstream out(opt.writeBaseline);
+    for (auto &r : results)
+      out << r.first << " " << r.second << "\n";
+  }
+  if (!opt.baseline.empty() && !CheckBaseline(opt))
+    return 1;
+  return 0;
+}
@@ -0,0 +1,50 @@
+/**
+ * replacer_factory.h
+ *
+ * Functionality: Names every Replacer<T> implementation so callers (the
+ * buffer pool, benchmarks, simulators) can pick a replacement policy at
+ * construction time.
+ */
+
+#pragma once
+
+#include "buffer/buffered_replacer.h"
+#include "buffer/clock_replacer.h"
+#include "buffer/frame_lru_replacer.h"
+#include "buffer/lru_replacer.h"
+#include "buffer/sharded_lru_replacer.h"
+
+namespace scudb {
+
+enum class ReplacerPolicy {
+  LRU,          // LRUReplacer: exact LRU, hashed by value
+  FRAME_LRU,    // FrameLRUReplacer: exact LRU, indexed by frame
+  SHARDED_LRU,  // ShardedLRUReplacer: approximate LRU, per-shard latches
+  BUFFERED_LRU, // BufferedReplacer over FrameLRUReplacer
+  CLOCK         // ClockReplacer: lock-free CLOCK
+};
+
+/*
+ * Create a replacer for values in [base, base + num_frames). Frame-indexed
+ * policies require every value to be in that range
+ */
+template <typename T>
+ScanReplacer<T> *MakeReplacer(ReplacerPolicy policy, size_t num_frames,
+                          T base = T()) {
+  switch (policy) {
+  case ReplacerPolicy::LRU:
+    return new LRUReplacer<T>;
+  case ReplacerPolicy::SHARDED_LRU:
+    return new ShardedLRUReplacer<T>;
+  case ReplacerPolicy::BUFFERED_LRU:
+    return new BufferedReplacer<T>(
+        new FrameLRUReplacer<T>(num_frames, base));
+  case ReplacerPolicy::CLOCK:
+    return new ClockReplacer<T>(num_frames, base);
+  case ReplacerPolicy::FRAME_LRU:
+  default:
+    return new FrameLRUReplacer<T>(num_frames, base);
+  }
+}
+
+}
@@ -0,0 +1,103 @@
+/**
+ * replacer_test.cpp
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "buffer/replacer_factory.h"
+#include "gtest/gtest.h"
+
+namespace scudb {
+
+static const ReplacerPolicy ALL_POLICIES[] = {
+    ReplacerPolicy::LRU, ReplacerPolicy::FRAME_LRU, ReplacerPolicy::SHARDED_LRU,
+    ReplacerPolicy::BUFFERED_LRU, ReplacerPolicy::CLOCK};
+
+// exact LRU: victims come out in the order of their last Insert
+TEST(ReplacerTest, ExactLRUOrder) {
+  for (ReplacerPolicy policy : {ReplacerPolicy::LRU, ReplacerPolicy::FRAME_LRU,
+                                ReplacerPolicy::BUFFERED_LRU}) {
+    ScanReplacer<int> *replacer = MakeReplacer<int>(policy, 8);
+    for (int i = 1; i <= 6; i++)
+      replacer->Insert(i);
+    replacer->Insert(1); // touch
+    EXPECT_EQ(6, replacer->Size());
+
+    int value;
+    replacer->Victim(value);
+    EXPECT_EQ(2, value);
+    replacer->Victim(value);
+    EXPECT_EQ(3, value);
+
+    replacer->Erase(4);
+    EXPECT_EQ(3, replacer->Size());
+    replacer->Victim(value);
+    EXPECT_EQ(5, value);
+    replacer->Victim(value);
+    EXPECT_EQ(6, value);
+    replacer->Victim(value);
+    EXPECT_EQ(1, value);
+    EXPECT_FALSE(replacer->Victim(value));
+    delete replacer;
+  }
+}
+
+// every policy hands out each unpinned value exactly once
+TEST(ReplacerTest, VictimsAreUnpinnedValues) {
+  for (ReplacerPolicy policy : ALL_POLICIES) {
+    ScanReplacer<int> *replacer = MakeReplacer<int>(policy, 32);
+    for (int i = 0; i < 32; i++)
+      replacer->Insert(i);
+    for (int i = 0; i < 32; i += 4)
+      replacer->Erase(i);
+    EXPECT_EQ(24, replacer->Size());
+
+    std::vector<int> victims;
+    int value;
+    while (replacer->Victim(value))
+      victims.push_back(value);
+    std::sort(victims.begin(), victims.end());
+    ASSERT_EQ(24, victims.size());
+    EXPECT_EQ(victims.end(), std::unique(victims.begin(), victims.end()));
+    for (int v : victims)
+      EXPECT_NE(0, v % 4);
+    EXPECT_EQ(0, replacer->Size());
+    delete replacer;
+  }
+}
+
+// skipped candidates stay in the replacer
+TEST(ReplacerTest, PredicateVictim) {
+  for (ReplacerPolicy policy : ALL_POLICIES) {
+    ScanReplacer<int> *replacer = MakeReplacer<int>(policy, 16);
+    for (int i = 0; i < 16; i++)
+      replacer->Insert(i);
+    auto odd = [](const int &v) { return v % 2 == 1; };
+    int value;
+    ASSERT_TRUE(replacer->Victim(value, odd, 16));
+    EXPECT_EQ(1, value % 2);
+    EXPECT_EQ(15, replacer->Size());
+    EXPECT_FALSE(replacer->Victim(value, [](const int &) { return false; }, 16));
+    EXPECT_EQ(15, replacer->Size());
+    delete replacer;
+  }
+}
+
+TEST(ReplacerTest, PeekDoesNotRemove) {
+  for (ReplacerPolicy policy : ALL_POLICIES) {
+    ScanReplacer<int> *replacer = MakeReplacer<int>(policy, 16);
+    for (int i = 0; i < 10; i++)
+      replacer->Insert(i);
+    replacer->Erase(3);
+    std::vector<int> values;
+    EXPECT_EQ(4, replacer->Peek(values, 4));
+    EXPECT_EQ(4, values.size());
+    EXPECT_EQ(9, replacer->Peek(values, 16));
+    EXPECT_EQ(values.end(), std::find(values.begin(), values.end(), 3));
+    EXPECT_EQ(9, replacer->Size());
+    delete replacer;
+  }
+}
+
+} // namespace scudb
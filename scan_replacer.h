@@ -0,0 +1,37 @@
+/**
+ * scan_replacer.h
+ *
+ * Functionality: Extends the Replacer interface with candidate scanning, so
+ * the buffer pool can layer eviction heuristics ("skip frames with I/O in
+ * progress", "prefer clean frames", "only evict from this group") on top of
+ * any replacement policy without pulling entries out and re-inserting them,
+ * which would reorder the list.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "buffer/replacer.h"
+
+using namespace std;
+namespace scudb {
+
+template <typename T> class ScanReplacer : public Replacer<T> {
+public:
+  using Replacer<T>::Victim;
+
+  // Look at up to scan_limit candidates, coldest first, and evict the first
+  // one for which pred returns true. Candidates that are skipped keep their
+  // position. pred may be called with a replacer latch held and must not
+  // call back into the replacer.
+  virtual bool Victim(T &value, const function<bool(const T &)> &pred,
+                      size_t scan_limit) = 0;
+
+  // Copy up to n candidates into values, coldest first, without removing
+  // them. Returns the number copied.
+  virtual size_t Peek(vector<T> &values, size_t n) = 0;
+};
+
+}
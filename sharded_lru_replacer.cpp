@@ -0,0 +1,214 @@
+/**
+ * Sharded approximate LRU implementation
+ */
+#include <algorithm>
+#include <chrono>
+
+#include "buffer/sharded_lru_replacer.h"
+#include "page/page.h"
+
+namespace scudb {
+
+/*
+ * 时间戳取自单调时钟,而不是一个全局计数器:全局计数器的fetch_add会让所有核
+ * 重新争用同一条cache line
+ */
+static inline uint64_t AccessStamp() {
+  return chrono::duration_cast<chrono::nanoseconds>(
+             chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+template <typename T>
+ShardedLRUReplacer<T>::ShardedLRUReplacer(size_t num_shards, size_t sample_size)
+    : sampleSize(sample_size), cursor(0), size(0) {
+  if (num_shards == 0)
+    num_shards = 1;
+  if (sampleSize == 0 || sampleSize > num_shards)
+    sampleSize = num_shards;
+  for (size_t i = 0; i < num_shards; i++)
+    shards.emplace_back(new Shard);
+}
+
+template <typename T> ShardedLRUReplacer<T>::~ShardedLRUReplacer() {}
+
+/*
+ * std::hash of a pointer or an integer is the value itself, and Page* of
+ * consecutive frames differ by sizeof(Page), so the modulo alone would put
+ * every frame in the same few shards. Mix the bits first (splitmix64 finalizer)
+ */
+template <typename T>
+typename ShardedLRUReplacer<T>::Shard &
+ShardedLRUReplacer<T>::GetShard(const T &value) {
+  uint64_t h = hash<T>{}(value);
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return *shards[h % shards.size()];
+}
+
+/*
+ * Insert value into its shard. If value is already there, only refresh its
+ * position and access stamp
+ */
+template <typename T> void ShardedLRUReplacer<T>::Insert(const T &value) {
+  Shard &shard = GetShard(value);
+  lock_guard<mutex> lck(shard.latch);
+  auto it = shard.map.find(value);
+  if (it != shard.map.end()) {
+    //已存在则移到队首
+    it->second->second = AccessStamp();
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return;
+  }
+  shard.lru.emplace_front(value, AccessStamp());
+  shard.map[value] = shard.lru.begin();
+  size++;
+}
+
+/*
+ * 弹出shard队尾元素,调用者不持有shard.latch
+ */
+template <typename T>
+bool ShardedLRUReplacer<T>::PopTail(Shard &shard, T &value) {
+  lock_guard<mutex> lck(shard.latch);
+  if (shard.lru.empty())
+    return false;
+  value = shard.lru.back().first;
+  shard.map.erase(value);
+  shard.lru.pop_back();
+  size--;
+  return true;
+}
+
+/*
+ * Sample the tails of sampleSize shards and evict the one with the oldest
+ * access stamp. The choice is approximate: the chosen shard's tail may have
+ * changed between sampling and popping, in which case its new tail is taken.
+ * Falls back to scanning every shard so that Victim only fails when the
+ * replacer is really empty.
+ */
+template <typename T> bool ShardedLRUReplacer<T>::Victim(T &value) {
+  if (size.load() == 0)
+    return false;
+  size_t n = shards.size();
+  size_t start = cursor.fetch_add(1) % n;
+  Shard *oldest = nullptr;
+  uint64_t oldestStamp = 0;
+  for (size_t i = 0; i < sampleSize; i++) {
+    Shard &shard = *shards[(start + i) % n];
+    lock_guard<mutex> lck(shard.latch);
+    if (shard.lru.empty())
+      continue;
+    uint64_t stamp = shard.lru.back().second;
+    if (oldest == nullptr || stamp < oldestStamp) {
+      oldest = &shard;
+      oldestStamp = stamp;
+    }
+  }
+  if (oldest != nullptr && PopTail(*oldest, value))
+    return true;
+  //采样的shard都为空(或已被其他线程取空),依次检查剩余shard
+  for (size_t i = 0; i < n; i++) {
+    if (PopTail(*shards[(start + i) % n], value))
+      return true;
+  }
+  return false;
+}
+
+/*
+ * Gather the n coldest entries across all shards, ordered by access stamp
+ */
+template <typename T>
+void ShardedLRUReplacer<T>::Collect(vector<Candidate> &candidates, size_t n) {
+  candidates.clear();
+  for (auto &shard : shards) {
+    lock_guard<mutex> lck(shard->latch);
+    size_t taken = 0;
+    for (auto it = shard->lru.rbegin(); taken < n && it != shard->lru.rend();
+         ++it, ++taken)
+      candidates.push_back({it->first, it->second, shard.get()});
+  }
+  sort(candidates.begin(), candidates.end(),
+       [](const Candidate &a, const Candidate &b) { return a.stamp < b.stamp; });
+  if (candidates.size() > n)
+    candidates.resize(n);
+}
+
+/*
+ * Visit the shards from the oldest tail to the newest and test each shard's
+ * entries from its tail under its latch, scan_limit entries in all. Within a
+ * shard the order is exact, across shards it is approximate like Victim; no
+ * candidates are copied or sorted, so the cost is O(scan_limit) plus sorting
+ * the shard tails
+ */
+template <typename T>
+bool ShardedLRUReplacer<T>::Victim(T &value,
+                                   const function<bool(const T &)> &pred,
+                                   size_t scan_limit) {
+  if (size.load() == 0)
+    return false;
+  vector<pair<uint64_t, Shard *>> tails;
+  for (auto &shard : shards) {
+    lock_guard<mutex> lck(shard->latch);
+    if (!shard->lru.empty())
+      tails.emplace_back(shard->lru.back().second, shard.get());
+  }
+  sort(tails.begin(), tails.end(),
+       [](const pair<uint64_t, Shard *> &a, const pair<uint64_t, Shard *> &b) {
+         return a.first < b.first;
+       });
+  for (auto &tail : tails) {
+    Shard &shard = *tail.second;
+    lock_guard<mutex> lck(shard.latch);
+    for (auto it = shard.lru.rbegin(); scan_limit > 0 && it != shard.lru.rend();
+         ++it, --scan_limit) {
+      if (!pred(it->first))
+        continue;
+      value = it->first;
+      shard.map.erase(value);
+      shard.lru.erase(next(it).base());
+      size--;
+      return true;
+    }
+    if (scan_limit == 0)
+      break;
+  }
+  return false;
+}
+
+template <typename T>
+size_t ShardedLRUReplacer<T>::Peek(vector<T> &values, size_t n) {
+  vector<Candidate> candidates;
+  Collect(candidates, n);
+  values.clear();
+  for (auto &c : candidates)
+    values.push_back(c.value);
+  return values.size();
+}
+
+/*
+ * Remove value from its shard. If removal is successful, return true,
+ * otherwise return false
+ */
+template <typename T> bool ShardedLRUReplacer<T>::Erase(const T &value) {
+  Shard &shard = GetShard(value);
+  lock_guard<mutex> lck(shard.latch);
+  auto it = shard.map.find(value);
+  if (it == shard.map.end())
+    return false;
+  shard.lru.erase(it->second);
+  shard.map.erase(it);
+  size--;
+  return true;
+}
+
+template <typename T> size_t ShardedLRUReplacer<T>::Size() {
+  return size.load();
+}
+
+template class ShardedLRUReplacer<Page *>;
+// test only
+template class ShardedLRUReplacer<int>;
+
+}
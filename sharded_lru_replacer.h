@@ -0,0 +1,71 @@
+/**
+ * sharded_lru_replacer.h
+ *
+ * Functionality: An approximate LRU replacer for multi-core hosts. Values are
+ * hashed into independent LRU shards, each protected by its own latch, so
+ * Insert/Erase from different cores rarely touch the same lock. Victim samples
+ * the tails of a few shards and evicts the oldest one it sees, which
+ * approximates the global LRU order of LRUReplacer.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "buffer/scan_replacer.h"
+
+using namespace std;
+namespace scudb {
+
+template <typename T> class ShardedLRUReplacer : public ScanReplacer<T> {
+  // 队列元素:(value, 最近一次访问的时间戳)
+  typedef list<pair<T, uint64_t>> List;
+  // 每个shard独占一条cache line,避免相邻shard的latch互相干扰
+  struct alignas(64) Shard {
+    List lru; // 队首为最近访问,队尾为最久未访问
+    unordered_map<T, typename List::iterator> map;
+    mutex latch;
+  };
+
+public:
+  // num_shards: shard数量; sample_size: Victim每次比较多少个shard的队尾
+  explicit ShardedLRUReplacer(size_t num_shards = 16, size_t sample_size = 4);
+
+  ~ShardedLRUReplacer();
+
+  void Insert(const T &value);
+
+  bool Victim(T &value);
+
+  bool Victim(T &value, const function<bool(const T &)> &pred,
+              size_t scan_limit);
+
+  size_t Peek(vector<T> &values, size_t n);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+private:
+  // 一个候选:shard队尾附近的元素及其时间戳
+  struct Candidate {
+    T value;
+    uint64_t stamp;
+    Shard *shard;
+  };
+  void Collect(vector<Candidate> &candidates, size_t n);
+  Shard &GetShard(const T &value);
+  bool PopTail(Shard &shard, T &value);
+
+  vector<unique_ptr<Shard>> shards;
+  size_t sampleSize;
+  atomic<size_t> cursor; // Victim采样的起始shard,轮转以分散负载
+  atomic<size_t> size;
+};
+
+}
@@ -0,0 +1,181 @@
+/**
+ * space_map.cpp
+ */
+#include <cstring>
+
+#include "disk/space_map.h"
+
+namespace scudb {
+
+const size_t SpaceMap::PAGES_PER_EXTENT;
+const uint32_t SpaceMap::MAP_MAGIC;
+const size_t SpaceMap::MAP_HEADER_SIZE;
+const size_t SpaceMap::EXTENTS_PER_MAP;
+const size_t SpaceMap::PAGES_PER_MAP;
+
+SpaceMap::SpaceMap() : allocated_(0), reused_(0) {}
+
+/*
+ * Append the extents described by map page map_no and rebuild the in-memory
+ * indexes from them. Trailing free extents are dropped, so a file that was
+ * preallocated but never filled doesn't count them as used
+ */
+void SpaceMap::Load(size_t map_no, const char *data) {
+  size_t base = map_no * EXTENTS_PER_MAP;
+  while (bits_.size() < base) {
+    free_extents_.insert(bits_.size());
+    bits_.push_back(0);
+    owner_.push_back(0);
+  }
+  uint32_t magic;
+  memcpy(&magic, data, sizeof(magic));
+  for (size_t i = 0; i < EXTENTS_PER_MAP; i++) {
+    uint64_t bits = 0;
+    int32_t owner = 0;
+    if (magic == MAP_MAGIC) {
+      memcpy(&bits, data + MAP_HEADER_SIZE + i * sizeof(bits), sizeof(bits));
+      memcpy(&owner,
+             data + MAP_HEADER_SIZE + EXTENTS_PER_MAP * sizeof(bits) +
+                 i * sizeof(owner),
+             sizeof(owner));
+    }
+    size_t extent = base + i;
+    bits_.push_back(bits);
+    owner_.push_back(owner);
+    if (bits == 0) {
+      free_extents_.insert(extent);
+      continue;
+    }
+    allocated_ += __builtin_popcountll(bits);
+    if (~bits != 0)
+      partial_[owner].insert(extent);
+    last_extent_[owner] = extent;
+  }
+  while (!bits_.empty() && bits_.back() == 0) {
+    free_extents_.erase(bits_.size() - 1);
+    bits_.pop_back();
+    owner_.pop_back();
+  }
+}
+
+void SpaceMap::Store(size_t map_no, char *data) const {
+  memset(data, 0, PAGE_SIZE);
+  uint32_t magic = MAP_MAGIC;
+  memcpy(data, &magic, sizeof(magic));
+  size_t base = map_no * EXTENTS_PER_MAP;
+  for (size_t i = 0; i < EXTENTS_PER_MAP && base + i < bits_.size(); i++) {
+    memcpy(data + MAP_HEADER_SIZE + i * sizeof(uint64_t), &bits_[base + i],
+           sizeof(uint64_t));
+    memcpy(data + MAP_HEADER_SIZE + EXTENTS_PER_MAP * sizeof(uint64_t) +
+               i * sizeof(int32_t),
+           &owner_[base + i], sizeof(int32_t));
+  }
+}
+
+/*
+ * Give group a fresh extent: the one right after the group's last extent if
+ * it is free (so the group's pages stay contiguous), otherwise the lowest
+ * free extent, otherwise a new one at the end of the file
+ */
+size_t SpaceMap::NewExtent(int32_t group, bool &recycled) {
+  size_t extent = bits_.size();
+  auto last = last_extent_.find(group);
+  if (last != last_extent_.end() && free_extents_.count(last->second + 1))
+    extent = last->second + 1;
+  else if (!free_extents_.empty())
+    extent = *free_extents_.begin();
+  recycled = extent < bits_.size();
+  if (recycled) {
+    free_extents_.erase(extent);
+    owner_[extent] = group;
+  } else {
+    bits_.push_back(0);
+    owner_.push_back(group);
+  }
+  last_extent_[group] = extent;
+  partial_[group].insert(extent);
+  return extent;
+}
+
+/*
+ * Take the lowest free page of the group's lowest partially used extent,
+ * opening a new extent when the group has none
+ */
+page_id_t SpaceMap::Allocate(int32_t group, size_t &map_no) {
+  return AllocateRun(group, 1, map_no);
+}
+
+/*
+ * The lowest free aligned run of the group's partially used extents, in
+ * extent order; a new extent when none has one
+ */
+page_id_t SpaceMap::AllocateRun(int32_t group, size_t count, size_t &map_no) {
+  uint64_t run = count >= PAGES_PER_EXTENT ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+  std::set<size_t> &partial = partial_[group];
+  bool reused = false;
+  size_t extent = 0, slot = PAGES_PER_EXTENT;
+  for (auto it = partial.begin(); it != partial.end() && slot == PAGES_PER_EXTENT; ++it) {
+    for (size_t s = 0; s < PAGES_PER_EXTENT; s += count) {
+      if (((bits_[*it] >> s) & run) == 0) {
+        extent = *it;
+        slot = s;
+        break;
+      }
+    }
+  }
+  if (slot == PAGES_PER_EXTENT) {
+    extent = NewExtent(group, reused);
+    slot = 0;
+  }
+  uint64_t &bits = bits_[extent];
+  // 更高位已被占用,说明这些页是释放后空出来的
+  if ((bits >> slot) != 0)
+    reused = true;
+  if (reused)
+    reused_ += count;
+  bits |= run << slot;
+  if (~bits == 0)
+    partial.erase(extent);
+  allocated_ += count;
+  map_no = extent / EXTENTS_PER_MAP;
+  return static_cast<page_id_t>(extent * PAGES_PER_EXTENT + slot);
+}
+
+bool SpaceMap::Free(page_id_t page_id, size_t &map_no) {
+  if (!IsAllocated(page_id))
+    return false;
+  size_t extent = page_id / PAGES_PER_EXTENT;
+  uint64_t &bits = bits_[extent];
+  bits &= ~(uint64_t(1) << (page_id % PAGES_PER_EXTENT));
+  allocated_--;
+  std::set<size_t> &partial = partial_[owner_[extent]];
+  if (bits == 0) {
+    partial.erase(extent);
+    free_extents_.insert(extent);
+  } else {
+    partial.insert(extent);
+  }
+  map_no = extent / EXTENTS_PER_MAP;
+  return true;
+}
+
+bool SpaceMap::IsAllocated(page_id_t page_id) const {
+  if (page_id < 0 || static_cast<size_t>(page_id) / PAGES_PER_EXTENT >= bits_.size())
+    return false;
+  return (bits_[page_id / PAGES_PER_EXTENT] >> (page_id % PAGES_PER_EXTENT)) & 1;
+}
+
+size_t SpaceMap::NumMaps() const {
+  return (bits_.size() + EXTENTS_PER_MAP - 1) / EXTENTS_PER_MAP;
+}
+
+SpaceStats SpaceMap::GetStats() const {
+  SpaceStats stats;
+  stats.extents = bits_.size();
+  stats.free_extents = free_extents_.size();
+  stats.allocated_pages = allocated_;
+  stats.reused_pages = reused_;
+  return stats;
+}
+
+} // namespace scudb
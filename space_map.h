@@ -0,0 +1,107 @@
+/**
+ * space_map.h
+ *
+ * Functionality: Free-space bitmap and extent allocator of the database
+ * file. Pages are handed out in extents of PAGES_PER_EXTENT contiguous
+ * pages. Every extent belongs to one allocation group (a table, an index,
+ * ...), and a group only takes pages from its own extents, so one object's
+ * pages stay physically clustered and scans over it stay sequential. A
+ * freed page is reused by its extent's group; an extent whose pages are all
+ * free goes back to the shared pool of free extents.
+ *
+ * The allocation state is persisted in space map pages interleaved with
+ * the data pages: map page m sits right in front of the PAGES_PER_MAP data
+ * pages it describes, so the file looks like
+ *
+ *   [map 0][data 0 .. PAGES_PER_MAP-1][map 1][data PAGES_PER_MAP ..] ...
+ *
+ * and page ids stay dense and start at 0. A map page holds, per extent, a
+ * 64-bit allocation bitmap and the owning group.
+ *
+ * SpaceMap does no I/O and no locking; DiskManager reads and writes its map
+ * pages and serializes calls.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "common/config.h"
+
+namespace scudb {
+
+struct SpaceStats {
+  size_t extents = 0;         // extents ever used, free ones included
+  size_t free_extents = 0;    // extents with no allocated page
+  size_t allocated_pages = 0; // pages currently allocated
+  size_t reused_pages = 0;    // allocations that took a freed page
+  size_t file_pages = 0;      // preallocated file size, in pages
+};
+
+class SpaceMap {
+public:
+  static const size_t PAGES_PER_EXTENT = 64;
+  static const uint32_t MAP_MAGIC = 0x50414D53; // "SMAP"
+  static const size_t MAP_HEADER_SIZE = 8;
+  // per extent: 8 bytes of bitmap and 4 bytes of owner
+  static const size_t EXTENTS_PER_MAP = (PAGE_SIZE - MAP_HEADER_SIZE) / 12;
+  static const size_t PAGES_PER_MAP = EXTENTS_PER_MAP * PAGES_PER_EXTENT;
+
+  // position of data page page_id / of map page map_no in the file, in pages
+  static inline int64_t PageSlot(page_id_t page_id) {
+    return static_cast<int64_t>(page_id / PAGES_PER_MAP) * (PAGES_PER_MAP + 1) +
+           1 + page_id % PAGES_PER_MAP;
+  }
+  static inline int64_t MapSlot(size_t map_no) {
+    return static_cast<int64_t>(map_no) * (PAGES_PER_MAP + 1);
+  }
+  static inline size_t MapOf(page_id_t page_id) {
+    return page_id / PAGES_PER_MAP;
+  }
+
+  SpaceMap();
+
+  // restore map page map_no from its on-disk image. Pages must be loaded in
+  // order; an image without the magic (a preallocated, never written page)
+  // describes free extents
+  void Load(size_t map_no, const char *data);
+
+  // serialize map page map_no into a PAGE_SIZE buffer
+  void Store(size_t map_no, char *data) const;
+
+  // allocate a page for group. Returns the page id and sets map_no to the
+  // map page that changed
+  page_id_t Allocate(int32_t group, size_t &map_no);
+
+  // allocate count consecutive pages for group, starting at a multiple of
+  // count, and return the first. count must divide PAGES_PER_EXTENT
+  page_id_t AllocateRun(int32_t group, size_t count, size_t &map_no);
+
+  // free an allocated page. Returns false if page_id isn't allocated
+  bool Free(page_id_t page_id, size_t &map_no);
+
+  bool IsAllocated(page_id_t page_id) const;
+
+  // number of map pages needed to describe every used extent
+  size_t NumMaps() const;
+
+  SpaceStats GetStats() const;
+
+private:
+  size_t NewExtent(int32_t group, bool &recycled);
+
+  std::vector<uint64_t> bits_;  // per extent, bit i set: page i allocated
+  std::vector<int32_t> owner_;  // per extent, meaningful while bits_ != 0
+  std::set<size_t> free_extents_;
+  // extents of each group that still have a free page, and the extent the
+  // group took last (to extend it contiguously)
+  std::map<int32_t, std::set<size_t>> partial_;
+  std::map<int32_t, size_t> last_extent_;
+  size_t allocated_;
+  size_t reused_;
+};
+
+} // namespace scudb
@@ -0,0 +1,100 @@
+/**
+ * space_map_test.cpp
+ */
+
+#include <vector>
+
+#include "disk/space_map.h"
+#include "gtest/gtest.h"
+
+namespace scudb {
+
+// each group fills its own extents, page by page
+TEST(SpaceMapTest, GroupsGetTheirOwnExtents) {
+  SpaceMap map;
+  size_t map_no;
+  page_id_t a0 = map.Allocate(1, map_no);
+  page_id_t b0 = map.Allocate(2, map_no);
+  page_id_t a1 = map.Allocate(1, map_no);
+  EXPECT_EQ(0, a0);
+  EXPECT_EQ(1, a1);
+  EXPECT_EQ(static_cast<page_id_t>(SpaceMap::PAGES_PER_EXTENT), b0);
+  EXPECT_EQ(0, map_no);
+
+  // a full extent is extended by the next one
+  for (size_t i = 2; i < SpaceMap::PAGES_PER_EXTENT; i++)
+    map.Allocate(1, map_no);
+  EXPECT_EQ(static_cast<page_id_t>(2 * SpaceMap::PAGES_PER_EXTENT),
+            map.Allocate(1, map_no));
+  EXPECT_EQ(3, map.GetStats().extents);
+}
+
+TEST(SpaceMapTest, FreedPagesAndExtentsAreReused) {
+  SpaceMap map;
+  size_t map_no;
+  std::vector<page_id_t> pages;
+  for (int i = 0; i < 4; i++)
+    pages.push_back(map.Allocate(1, map_no));
+  EXPECT_TRUE(map.Free(pages[1], map_no));
+  EXPECT_FALSE(map.Free(pages[1], map_no));
+  EXPECT_FALSE(map.IsAllocated(pages[1]));
+  EXPECT_EQ(pages[1], map.Allocate(1, map_no));
+  EXPECT_EQ(1, map.GetStats().reused_pages);
+
+  // an extent with no page left goes back to the shared pool
+  for (page_id_t page : pages)
+    map.Free(page, map_no);
+  EXPECT_EQ(1, map.GetStats().free_extents);
+  EXPECT_EQ(0, map.Allocate(2, map_no));
+  EXPECT_EQ(0, map.GetStats().free_extents);
+}
+
+TEST(SpaceMapTest, AlignedRuns) {
+  SpaceMap map;
+  size_t map_no;
+  map.Allocate(1, map_no);
+  page_id_t run = map.AllocateRun(1, 16, map_no);
+  EXPECT_EQ(16, run);
+  for (page_id_t page = run; page < run + 16; page++)
+    EXPECT_TRUE(map.IsAllocated(page));
+  EXPECT_FALSE(map.IsAllocated(run + 16));
+  EXPECT_EQ(17, map.GetStats().allocated_pages);
+}
+
+TEST(SpaceMapTest, StoreAndLoad) {
+  SpaceMap map;
+  size_t map_no;
+  std::vector<page_id_t> pages;
+  for (int i = 0; i < 5; i++)
+    pages.push_back(map.Allocate(i % 2, map_no));
+  map.Free(pages[2], map_no);
+
+  char data[PAGE_SIZE];
+  map.Store(0, data);
+  SpaceMap loaded;
+  loaded.Load(0, data);
+  EXPECT_EQ(map.GetStats().allocated_pages, loaded.GetStats().allocated_pages);
+  EXPECT_EQ(map.GetStats().extents, loaded.GetStats().extents);
+  for (int i = 0; i < 5; i++)
+    EXPECT_EQ(i != 2, loaded.IsAllocated(pages[i]));
+  // the freed page goes back to its extent's group
+  EXPECT_EQ(pages[2], loaded.Allocate(0, map_no));
+
+  // a never written map page describes free extents only
+  char zero[PAGE_SIZE] = {};
+  SpaceMap empty;
+  empty.Load(0, zero);
+  EXPECT_EQ(0, empty.GetStats().extents);
+  EXPECT_EQ(0, empty.Allocate(1, map_no));
+}
+
+TEST(SpaceMapTest, MapPagesInterleaveWithData) {
+  EXPECT_EQ(0, SpaceMap::MapSlot(0));
+  EXPECT_EQ(1, SpaceMap::PageSlot(0));
+  page_id_t last = static_cast<page_id_t>(SpaceMap::PAGES_PER_MAP) - 1;
+  EXPECT_EQ(static_cast<int64_t>(SpaceMap::PAGES_PER_MAP), SpaceMap::PageSlot(last));
+  EXPECT_EQ(SpaceMap::MapSlot(1) + 1, SpaceMap::PageSlot(last + 1));
+  EXPECT_EQ(1, SpaceMap::MapOf(last + 1));
+}
+
+} // namespace scudb
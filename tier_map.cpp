@@ -0,0 +1,171 @@
+/**
+ * tier_map.cpp
+ */
+#include <algorithm>
+#include <functional>
+
+#include "disk/tier_map.h"
+
+namespace scudb {
+
+const uint32_t TierMap::MIN_HEAT;
+const uint32_t TierMap::DISPLACE_FACTOR;
+
+TierMap::TierMap(size_t num_slots) : slots_(num_slots, INVALID_PAGE_ID) {
+  for (size_t slot = 0; slot < num_slots; slot++)
+    free_slots_.insert(free_slots_.end(), slot);
+}
+
+void TierMap::Load(size_t slot, page_id_t page_id) {
+  if (slot >= slots_.size() || page_id == INVALID_PAGE_ID ||
+      fast_.count(page_id))
+    return;
+  slots_[slot] = page_id;
+  fast_[page_id] = slot;
+  free_slots_.erase(slot);
+}
+
+int64_t TierMap::FastSlot(page_id_t page_id) const {
+  auto it = fast_.find(page_id);
+  return it == fast_.end() ? -1 : static_cast<int64_t>(it->second);
+}
+
+void TierMap::RecordAccess(page_id_t page_id) { counts_[page_id]++; }
+
+uint32_t TierMap::Heat(page_id_t page_id) const {
+  auto it = counts_.find(page_id);
+  return it == counts_.end() ? 0 : it->second;
+}
+
+/*
+ * Walk the hottest slow pages in order: each takes a free slot while there
+ * is one, otherwise it demotes the coldest fast page it is DISPLACE_FACTOR
+ * times hotter than. The factor keeps pages of similar heat from swapping
+ * back and forth
+ */
+std::vector<TierMove> TierMap::PlanMoves(size_t max_moves) {
+  std::vector<std::pair<uint32_t, page_id_t>> hot;
+  for (auto &entry : counts_)
+    if (entry.second >= MIN_HEAT && !fast_.count(entry.first) &&
+        !moving_.count(entry.first))
+      hot.emplace_back(entry.second, entry.first);
+  size_t n = std::min(hot.size(), max_moves);
+  std::partial_sort(hot.begin(), hot.begin() + n, hot.end(),
+                    std::greater<std::pair<uint32_t, page_id_t>>());
+  hot.resize(n);
+
+  std::vector<std::pair<uint32_t, page_id_t>> cold;
+  if (free_slots_.size() < hot.size()) {
+    for (auto &entry : fast_)
+      if (!moving_.count(entry.first))
+        cold.emplace_back(Heat(entry.first), entry.first);
+    n = std::min(cold.size(), max_moves);
+    std::partial_sort(cold.begin(), cold.begin() + n, cold.end());
+    cold.resize(n);
+  }
+
+  std::vector<TierMove> moves;
+  size_t next_cold = 0;
+  for (auto &candidate : hot) {
+    if (!free_slots_.empty()) {
+      size_t slot = *free_slots_.begin();
+      free_slots_.erase(free_slots_.begin());
+      moves.push_back({candidate.second, slot, true});
+    } else if (next_cold < cold.size() &&
+               candidate.first >=
+                   DISPLACE_FACTOR * std::max<uint32_t>(cold[next_cold].first, 1)) {
+      page_id_t victim = cold[next_cold++].second;
+      moves.push_back({victim, fast_[victim], false});
+    } else {
+      break;
+    }
+  }
+  for (auto &move : moves)
+    moving_[move.page_id] = false;
+  return moves;
+}
+
+void TierMap::NoteWrite(page_id_t page_id) {
+  auto it = moving_.find(page_id);
+  if (it != moving_.end())
+    it->second = true;
+}
+
+bool TierMap::Commit(const TierMove &move) {
+  auto it = moving_.find(move.page_id);
+  bool written = it == moving_.end() || it->second;
+  if (written) {
+    Abort(move);
+    return false;
+  }
+  moving_.erase(it);
+  if (move.promote) {
+    slots_[move.slot] = move.page_id;
+    fast_[move.page_id] = move.slot;
+  } else {
+    slots_[move.slot] = INVALID_PAGE_ID;
+    fast_.erase(move.page_id);
+    pending_.push_back(move.slot);
+  }
+  return true;
+}
+
+void TierMap::Abort(const TierMove &move) {
+  moving_.erase(move.page_id);
+  // 提升目标slot从未被引用,可以立即重用
+  if (move.promote)
+    free_slots_.insert(move.slot);
+}
+
+void TierMap::Revert(const TierMove &move) {
+  if (move.promote) {
+    slots_[move.slot] = INVALID_PAGE_ID;
+    fast_.erase(move.page_id);
+    // 映射项可能已部分写入磁盘,同步之后才能重用该slot
+    pending_.push_back(move.slot);
+  } else {
+    slots_[move.slot] = move.page_id;
+    fast_[move.page_id] = move.slot;
+    auto it = std::find(pending_.begin(), pending_.end(), move.slot);
+    if (it != pending_.end())
+      pending_.erase(it);
+  }
+}
+
+int64_t TierMap::Drop(page_id_t page_id) {
+  NoteWrite(page_id);
+  counts_.erase(page_id);
+  auto it = fast_.find(page_id);
+  if (it == fast_.end())
+    return -1;
+  size_t slot = it->second;
+  fast_.erase(it);
+  slots_[slot] = INVALID_PAGE_ID;
+  pending_.push_back(slot);
+  return slot;
+}
+
+std::vector<size_t> TierMap::TakePending() {
+  std::vector<size_t> slots;
+  slots.swap(pending_);
+  return slots;
+}
+
+void TierMap::Release(const std::vector<size_t> &slots, bool synced) {
+  if (synced)
+    free_slots_.insert(slots.begin(), slots.end());
+  else
+    pending_.insert(pending_.end(), slots.begin(), slots.end());
+}
+
+void TierMap::Decay() {
+  for (auto it = counts_.begin(); it != counts_.end();) {
+    it->second >>= 1;
+    if (it->second == 0)
+      it = counts_.erase(it);
+    else
+      ++it;
+  }
+}
+
+} // namespace scudb
@@ -0,0 +1,113 @@
+/**
+ * tier_map.h
+ *
+ * Functionality: Page placement over two storage tiers. The slow tier is
+ * the database file itself, where every page has its home slot; the fast
+ * tier is a smaller file of num_slots page slots on a faster device. The
+ * map tells which pages live in which fast slot, keeps an access count per
+ * page, and plans migrations: the hottest pages of the slow tier are
+ * promoted into free fast slots, and when there are none, fast pages much
+ * colder than them are demoted to make room. Counts are halved after every
+ * migration round, so the placement follows the recent access pattern.
+ *
+ * A move is copy-then-commit. PlanMoves registers the pages it moves; the
+ * caller copies each while it stays readable and writable at its old
+ * location; Commit switches the location only if the page wasn't written
+ * meanwhile (NoteWrite), otherwise the move is dropped and retried in a
+ * later round.
+ * A fast slot freed by a demotion stays pending until the caller has
+ * synced the map (TakePending/Release), so a crash can't leave a durable
+ * map entry pointing at a reused slot.
+ *
+ * TierMap does no I/O and no locking; DiskManager persists its entries,
+ * copies the pages and serializes calls.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+
+namespace scudb {
+
+struct TierStats {
+  size_t fast_slots = 0;
+  size_t fast_pages = 0;    // pages currently in the fast tier
+  size_t fast_reads = 0;
+  size_t slow_reads = 0;
+  size_t fast_writes = 0;
+  size_t slow_writes = 0;
+  size_t promotions = 0;
+  size_t demotions = 0;
+  size_t aborted_moves = 0; // moves dropped because the page was written
+};
+
+struct TierMove {
+  page_id_t page_id;
+  size_t slot;  // fast slot the page moves into / out of
+  bool promote; // slow -> fast, else fast -> slow
+};
+
+class TierMap {
+public:
+  // a slow page needs this many accesses in a round to be promoted
+  static const uint32_t MIN_HEAT = 2;
+  // and this many times the count of a fast page to displace it
+  static const uint32_t DISPLACE_FACTOR = 2;
+
+  explicit TierMap(size_t num_slots);
+
+  // restore fast slot slot from its persisted entry (INVALID_PAGE_ID: free)
+  void Load(size_t slot, page_id_t page_id);
+
+  // fast slot of page_id, or -1 if it is in the slow tier
+  int64_t FastSlot(page_id_t page_id) const;
+
+  void RecordAccess(page_id_t page_id);
+
+  // plan up to max_moves moves and register them as moving. Promotions only
+  // take slots that are free now; demotions free slots for a later round
+  std::vector<TierMove> PlanMoves(size_t max_moves);
+
+  void NoteWrite(page_id_t page_id);
+
+  // switch the page's location; false if it was written since PlanMoves
+  // (the move is dropped then)
+  bool Commit(const TierMove &move);
+  void Abort(const TierMove &move);
+
+  // undo a committed move whose map entry couldn't be persisted
+  void Revert(const TierMove &move);
+
+  // take page_id out of the fast tier without moving it (it was
+  // deallocated). Returns its former slot or -1
+  int64_t Drop(page_id_t page_id);
+
+  // slots freed so far, to release once the map is synced; if the sync
+  // failed they go back to pending
+  std::vector<size_t> TakePending();
+  void Release(const std::vector<size_t> &slots, bool synced);
+
+  // halve every access count
+  void Decay();
+
+  size_t NumSlots() const { return slots_.size(); }
+  size_t NumFastPages() const { return fast_.size(); }
+
+private:
+  uint32_t Heat(page_id_t page_id) const;
+
+  std::vector<page_id_t> slots_;                // slot -> page
+  std::unordered_map<page_id_t, size_t> fast_;  // page -> slot
+  std::set<size_t> free_slots_;
+  std::vector<size_t> pending_;                 // freed, not yet synced
+  std::unordered_map<page_id_t, uint32_t> counts_;
+  // pages being moved -> written since PlanMoves
+  std::unordered_map<page_id_t, bool> moving_;
+};
+
+} // namespace scudb
@@ -0,0 +1,158 @@
+/**
+ * tier_map_test.cpp
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "disk/disk_manager.h"
+#include "disk/tier_map.h"
+#include "gtest/gtest.h"
+
+namespace scudb {
+
+static void Access(TierMap &map, page_id_t page_id, int times) {
+  for (int i = 0; i < times; i++)
+    map.RecordAccess(page_id);
+}
+
+TEST(TierMapTest, PromoteHottest) {
+  TierMap map(2);
+  Access(map, 1, 5);
+  Access(map, 2, 9);
+  Access(map, 3, 3);
+  Access(map, 4, 1); // below MIN_HEAT
+  std::vector<TierMove> moves = map.PlanMoves(8);
+  ASSERT_EQ(2, moves.size());
+  EXPECT_EQ(2, moves[0].page_id);
+  EXPECT_EQ(1, moves[1].page_id);
+  for (auto &move : moves) {
+    EXPECT_TRUE(move.promote);
+    EXPECT_EQ(-1, map.FastSlot(move.page_id)); // not before the commit
+    EXPECT_TRUE(map.Commit(move));
+    EXPECT_EQ(static_cast<int64_t>(move.slot), map.FastSlot(move.page_id));
+  }
+  EXPECT_EQ(2, map.NumFastPages());
+}
+
+TEST(TierMapTest, WriteDuringMoveAborts) {
+  TierMap map(1);
+  Access(map, 7, 4);
+  std::vector<TierMove> moves = map.PlanMoves(1);
+  ASSERT_EQ(1, moves.size());
+  map.NoteWrite(7);
+  EXPECT_FALSE(map.Commit(moves[0]));
+  EXPECT_EQ(-1, map.FastSlot(7));
+  // the slot is free again, and the page is retried
+  moves = map.PlanMoves(1);
+  ASSERT_EQ(1, moves.size());
+  EXPECT_TRUE(map.Commit(moves[0]));
+  EXPECT_EQ(0, map.FastSlot(7));
+}
+
+// a demoted page's slot is reusable only once the map is synced
+TEST(TierMapTest, DemoteWhenFull) {
+  TierMap map(1);
+  map.Load(0, 1);
+  Access(map, 1, 2);
+  Access(map, 2, 3);
+  EXPECT_TRUE(map.PlanMoves(4).empty()); // not hot enough to displace
+  Access(map, 2, 1);
+  std::vector<TierMove> moves = map.PlanMoves(4);
+  ASSERT_EQ(1, moves.size());
+  EXPECT_EQ(1, moves[0].page_id);
+  EXPECT_FALSE(moves[0].promote);
+  EXPECT_TRUE(map.Commit(moves[0]));
+  EXPECT_EQ(-1, map.FastSlot(1));
+
+  EXPECT_TRUE(map.PlanMoves(4).empty()); // slot still pending
+  std::vector<size_t> pending = map.TakePending();
+  ASSERT_EQ(1, pending.size());
+  map.Release(pending, false);
+  EXPECT_TRUE(map.PlanMoves(4).empty());
+  map.Release(map.TakePending(), true);
+  moves = map.PlanMoves(4);
+  ASSERT_EQ(1, moves.size());
+  EXPECT_EQ(2, moves[0].page_id);
+  EXPECT_TRUE(moves[0].promote);
+}
+
+TEST(TierMapTest, RevertAndDrop) {
+  TierMap map(2);
+  Access(map, 5, 2);
+  std::vector<TierMove> moves = map.PlanMoves(1);
+  ASSERT_EQ(1, moves.size());
+  ASSERT_TRUE(map.Commit(moves[0]));
+  map.Revert(moves[0]);
+  EXPECT_EQ(-1, map.FastSlot(5));
+  EXPECT_EQ(1, map.TakePending().size());
+
+  map.Load(1, 6);
+  EXPECT_EQ(1, map.Drop(6));
+  EXPECT_EQ(-1, map.Drop(6));
+  EXPECT_EQ(0, map.NumFastPages());
+}
+
+TEST(TierMapTest, Decay) {
+  TierMap map(1);
+  Access(map, 3, 3);
+  map.Decay();
+  EXPECT_TRUE(map.PlanMoves(1).empty()); // 1 access left
+  Access(map, 3, 1);
+  EXPECT_EQ(1, map.PlanMoves(1).size());
+}
+
+// pages keep their contents across a migration round and a reopen
+TEST(TierMapTest, DiskManagerMigration) {
+  std::string db = "tier_map_test.db";
+  std::string fast = "tier_map_test.fast";
+  auto cleanup = [&] {
+    remove(db.c_str());
+    remove("tier_map_test.log");
+    remove((fast + "/" + db + ".fast").c_str());
+    remove((fast + "/" + db + ".fast.map").c_str());
+    rmdir(fast.c_str());
+  };
+  cleanup();
+  mkdir(fast.c_str(), 0755);
+  std::vector<page_id_t> pages;
+  char data[PAGE_SIZE], read[PAGE_SIZE];
+  {
+    DiskManager disk_manager(db);
+    ASSERT_TRUE(disk_manager.SetFastTier(fast, 4));
+    for (int i = 0; i < 8; i++) {
+      pages.push_back(disk_manager.AllocatePage());
+      memset(data, 'a' + i, PAGE_SIZE);
+      ASSERT_TRUE(disk_manager.WritePage(pages[i], data));
+    }
+    for (int round = 0; round < 3; round++)
+      for (int i = 0; i < 2; i++)
+        disk_manager.ReadPage(pages[i], read);
+    EXPECT_EQ(2, disk_manager.MigratePages(8));
+    EXPECT_EQ(2, disk_manager.GetTierStats().fast_pages);
+    for (int i = 0; i < 8; i++) {
+      ASSERT_TRUE(disk_manager.ReadPage(pages[i], read));
+      memset(data, 'a' + i, PAGE_SIZE);
+      EXPECT_EQ(0, memcmp(data, read, PAGE_SIZE));
+    }
+    ASSERT_TRUE(disk_manager.SyncUpTo(disk_manager.WriteMark()));
+  }
+  {
+    DiskManager disk_manager(db);
+    ASSERT_TRUE(disk_manager.SetFastTier(fast, 4));
+    EXPECT_EQ(2, disk_manager.GetTierStats().fast_pages);
+    for (int i = 0; i < 8; i++) {
+      ASSERT_TRUE(disk_manager.ReadPage(pages[i], read));
+      memset(data, 'a' + i, PAGE_SIZE);
+      EXPECT_EQ(0, memcmp(data, read, PAGE_SIZE));
+    }
+  }
+  cleanup();
+}
+
+} // namespace scudb
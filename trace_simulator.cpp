@@ -0,0 +1,268 @@
+/**
+ * trace_simulator.cpp
+ *
+ * Offline replacement-policy simulator. Replays an access trace recorded by
+ * BufferPoolManager::StartTrace (see access_trace.h) against every policy in
+ * replacer_factory.h and against Belady's optimal policy at a range of pool
+ * sizes, and prints miss-ratio curves as CSV:
+ *
+ *   policy,pool_size,fetches,misses,miss_ratio,failed
+ *
+ * The replay honors pins exactly like the buffer pool: a pinned page can't be
+ * evicted, and a fetch that finds every frame pinned is counted as failed.
+ * Where the recorder dropped records (a GAP record) the pins are unknown, so
+ * the replay unpins every page there; the number of dropped records is
+ * reported on stderr.
+ *
+ * usage: trace_simulator TRACE [--sizes N,N,...] [--min N] [--max N]
+ *                              [--steps N]
+ * Without --sizes, pool sizes grow geometrically from --min (default 16) to
+ * --max (default: number of distinct pages) in --steps steps (default 16).
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "buffer/access_trace.h"
+#include "buffer/replacer_factory.h"
+
+using namespace std;
+using namespace scudb;
+
+namespace {
+
+struct Result {
+    size_t fetches = 0;
+    size_t misses = 0;
+    size_t failed = 0;
+};
+
+/*
+ * 模拟缓冲池的公共部分:页表、pin计数、空闲frame。
+ * 具体的换出策略由Policy决定
+ */
+template <typename Policy>
+Result Replay(const vector<TraceRecord> &trace, size_t frames, Policy &policy) {
+    Result result;
+    unordered_map<page_id_t, int> table;
+    vector<page_id_t> owner(frames, INVALID_PAGE_ID);
+    vector<int> pins(frames, 0);
+    vector<size_t> last_use(frames, 0); // 该frame上的页最近一次FETCH/NEW的位置
+    vector<int> free_frames;
+    for (int i = frames - 1; i >= 0; i--)
+        free_frames.push_back(i);
+
+    for (size_t i = 0; i < trace.size(); i++) {
+        const TraceRecord &rec = trace[i];
+        TraceOp op = static_cast<TraceOp>(rec.op);
+        //丢弃的记录里可能有unpin,缺口处的pin计数不可信,全部清零
+        if (op == TraceOp::GAP) {
+            for (size_t f = 0; f < frames; f++) {
+                if (pins[f] > 0) {
+                    pins[f] = 0;
+                    policy.Unpin(f, owner[f], last_use[f]);
+                }
+            }
+            continue;
+        }
+        auto it = table.find(rec.page_id);
+        if (op == TraceOp::UNPIN) {
+            if (it != table.end() && pins[it->second] > 0 && --pins[it->second] == 0)
+                policy.Unpin(it->second, rec.page_id, i);
+            continue;
+        }
+        if (op == TraceOp::DELETE) {
+            if (it != table.end() && pins[it->second] == 0) {
+                policy.Remove(it->second);
+                owner[it->second] = INVALID_PAGE_ID;
+                free_frames.push_back(it->second);
+                table.erase(it);
+            }
+            continue;
+        }
+        if (op == TraceOp::FETCH)
+            result.fetches++;
+        if (it != table.end()) {
+            if (pins[it->second]++ == 0)
+                policy.Pin(it->second);
+            last_use[it->second] = i;
+            continue;
+        }
+        if (op == TraceOp::FETCH)
+            result.misses++;
+        int frame;
+        if (!free_frames.empty()) {
+            frame = free_frames.back();
+            free_frames.pop_back();
+        } else if (!policy.Victim(frame)) {
+            result.failed++;
+            continue;
+        } else {
+            table.erase(owner[frame]);
+        }
+        owner[frame] = rec.page_id;
+        table[rec.page_id] = frame;
+        pins[frame] = 1;
+        last_use[frame] = i;
+    }
+    return result;
+}
+
+/*
+ * Adapter from a Replacer<int> over frame numbers
+ */
+struct ReplacerPolicyAdapter {
+    explicit ReplacerPolicyAdapter(ScanReplacer<int> *r) : replacer(r) {}
+    ~ReplacerPolicyAdapter() { delete replacer; }
+    void Pin(int frame) { replacer->Erase(frame); }
+    void Unpin(int frame, page_id_t, size_t) { replacer->Insert(frame); }
+    void Remove(int frame) { replacer->Erase(frame); }
+    bool Victim(int &frame) { return replacer->Victim(frame); }
+    ScanReplacer<int> *replacer;
+};
+
+/*
+ * Belady's OPT: evict the unpinned page whose next fetch is farthest in the
+ * future. next_use[i] is the index of the next FETCH/NEW of the page after
+ * record i (trace.size() if none). Unpinning at a GAP passes the page's last
+ * FETCH/NEW: no FETCH/NEW of the page lies between it and the GAP
+ */
+struct BeladyPolicy {
+    BeladyPolicy(const vector<size_t> &next_use, size_t frames)
+        : next_use(next_use), key(frames) {}
+    void Pin(int frame) { candidates.erase(key[frame]); }
+    void Unpin(int frame, page_id_t, size_t i) {
+        key[frame] = make_pair(next_use[i], frame);
+        candidates.insert(key[frame]);
+    }
+    void Remove(int frame) { candidates.erase(key[frame]); }
+    bool Victim(int &frame) {
+        if (candidates.empty())
+            return false;
+        auto last = prev(candidates.end());
+        frame = last->second;
+        candidates.erase(last);
+        return true;
+    }
+    const vector<size_t> &next_use;
+    vector<pair<size_t, int>> key;
+    set<pair<size_t, int>> candidates;
+};
+
+vector<size_t> ComputeNextUse(const vector<TraceRecord> &trace) {
+    vector<size_t> next_use(trace.size());
+    unordered_map<page_id_t, size_t> upcoming;
+    for (size_t i = trace.size(); i-- > 0;) {
+        TraceOp op = static_cast<TraceOp>(trace[i].op);
+        if (op == TraceOp::GAP) {
+            next_use[i] = trace.size();
+            continue;
+        }
+        auto it = upcoming.find(trace[i].page_id);
+        next_use[i] = it == upcoming.end() ? trace.size() : it->second;
+        if (op == TraceOp::FETCH || op == TraceOp::NEW)
+            upcoming[trace[i].page_id] = i;
+        else if (op == TraceOp::DELETE)
+            upcoming.erase(trace[i].page_id);
+    }
+    return next_use;
+}
+
+void Print(const char *policy, size_t frames, const Result &r) {
+    printf("%s,%zu,%zu,%zu,%.6f,%zu\n", policy, frames, r.fetches, r.misses,
+           r.fetches ? double(r.misses) / r.fetches : 0.0, r.failed);
+}
+
+vector<size_t> ParseSizes(const string &list) {
+    vector<size_t> sizes;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == string::npos)
+            comma = list.size();
+        sizes.push_back(strtoull(list.substr(pos, comma - pos).c_str(), nullptr, 10));
+        pos = comma + 1;
+    }
+    return sizes;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s TRACE [--sizes N,N,...] [--min N] [--max N] [--steps N]\n",
+                argv[0]);
+        return 2;
+    }
+    vector<TraceRecord> trace;
+    if (!TraceReader::ReadAll(argv[1], trace)) {
+        fprintf(stderr, "cannot read trace %s\n", argv[1]);
+        return 1;
+    }
+    size_t gaps = 0, dropped = 0;
+    for (auto &rec : trace) {
+        if (static_cast<TraceOp>(rec.op) == TraceOp::GAP) {
+            gaps++;
+            dropped += rec.page_id;
+        }
+    }
+    if (gaps > 0)
+        fprintf(stderr, "%s: %zu records dropped in %zu gaps, pins reset at each gap\n",
+                argv[1], dropped, gaps);
+    vector<size_t> sizes;
+    size_t min_size = 16, max_size = 0, steps = 16;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        string arg = argv[i];
+        if (arg == "--sizes")
+            sizes = ParseSizes(argv[i + 1]);
+        else if (arg == "--min")
+            min_size = strtoull(argv[i + 1], nullptr, 10);
+        else if (arg == "--max")
+            max_size = strtoull(argv[i + 1], nullptr, 10);
+        else if (arg == "--steps")
+            steps = strtoull(argv[i + 1], nullptr, 10);
+    }
+    if (sizes.empty()) {
+        if (max_size == 0) {
+            set<page_id_t> distinct;
+            for (auto &rec : trace) {
+                if (static_cast<TraceOp>(rec.op) != TraceOp::GAP)
+                    distinct.insert(rec.page_id);
+            }
+            max_size = max<size_t>(distinct.size(), min_size);
+        }
+        double ratio = steps > 1 ? pow(double(max_size) / min_size, 1.0 / (steps - 1)) : 1;
+        for (size_t i = 0; i < steps; i++) {
+            size_t n = llround(min_size * pow(ratio, i));
+            if (sizes.empty() || n != sizes.back())
+                sizes.push_back(n);
+        }
+    }
+
+    const vector<pair<ReplacerPolicy, const char *>> policies = {
+        {ReplacerPolicy::LRU, "lru"},
+        {ReplacerPolicy::FRAME_LRU, "frame_lru"},
+        {ReplacerPolicy::SHARDED_LRU, "sharded_lru"},
+        {ReplacerPolicy::BUFFERED_LRU, "buffered_lru"},
+        {ReplacerPolicy::CLOCK, "clock"}};
+    vector<size_t> next_use = ComputeNextUse(trace);
+
+    printf("policy,pool_size,fetches,misses,miss_ratio,failed\n");
+    for (size_t frames : sizes) {
+        if (frames == 0)
+            continue;
+        for (auto &p : policies) {
+            ReplacerPolicyAdapter policy(MakeReplacer<int>(p.first, frames, 0));
+            Print(p.second, frames, Replay(trace, frames, policy));
+        }
+        BeladyPolicy opt(next_use, frames);
+        Print("belady", frames, Replay(trace, frames, opt));
+    }
+    return 0;
+}